@@ -46,5 +46,6 @@ struct CPUKernelData
     RH_ALIGN(64) U64             m_isSolo;
     RH_ALIGN(64) U64             m_packageID = 0;
     RH_ALIGN(64) U32             m_id;               //id in the array of cpu kernels
+    U32                          m_node;             //numa node the thread runs on
     std::thread*                 m_thread;    
 };
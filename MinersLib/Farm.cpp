@@ -305,6 +305,7 @@ void Farm::submitProof(SolutionSptr sol)
     auto t = new std::thread(([&] (SolutionSptr solLocal, uint32_t idlocal)
     {
         RH_SetThreadPriority(RH_ThreadPrio_RT);
+        GpuManager::PinServiceThread(); //spawned from a miner thread, get off its core
 
         try
         {
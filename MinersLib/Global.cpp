@@ -36,9 +36,16 @@ RHMINER_COMMAND_LINE_DEFINE_GLOBAL_BOOL(g_useCPU, false);
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_BOOL(g_restared, false);
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_testPerformance, 0);
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_testPerformanceThreads, 0);
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_BOOL(g_testKernels, false);
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_testLatency, 0);
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_setProcessPrio, 3);
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_memoryBoostLevel, RH_OPT_UNSET);
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_sseOptimization, 0); 
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_smallHashTables, 0);
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_hugePages, 0);
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_lockPages, 0);
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_cpuAbandon, 0);
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_STRING(g_cpuAffinity, "");
 
 bool g_useGPU = false;
 U32  g_cpuMinerThreads = 1;
@@ -524,23 +531,47 @@ void GlobalMiningPreset::DoPerformanceTest()
         g_testPerformanceThreads = GpuManager::CpuInfos.numberOfProcessors;
         
     const size_t ThreadCount = g_testPerformanceThreads;
-    RandomHash_State* g_threadsData = new RandomHash_State[ThreadCount];
-    RandomHash_CreateMany(&g_threadsData, ThreadCount);
+    GpuManager::LoadCpuPlacement((U32)ThreadCount);
+    GpuManager::PinServiceThread();
+    const U32 LaneCount = (U32)g_cpuLanes;
+    //each thread creates its lanes states on its numa node, like the cpu miner
+    std::vector<RandomHash_State*> threadStates(ThreadCount, (RandomHash_State*)0);
     U32 nonce2 = 0;
     
     PrintOut("CPU: %s\n", GpuManager::CpuInfos.cpuBrandName.c_str());
     PrintOut("Testing raw cpu performance for %d sec on %d threads\n", g_testPerformance, ThreadCount);
+    if (LaneCount > 1)
+        PrintOut("Using %d interleaved lanes per thread\n", LaneCount);
     
     U64 timeout[] = { 10 * 1000, (U64)g_testPerformance * 1000 };
+    U64 energyStart = 0;
+    U64 energyEnd = 0;
+    bool hasEnergy = false;
     std::vector<U64> hashes;
     hashes.resize(ThreadCount);
 
     auto kernelFunc = [&](RandomHash_State* allStates, U32 startNonce, U64 to)
     {
-        while (TimeGetMilliSec() < to)
+        if (LaneCount == 1)
         {
-            RandomHash_Search(allStates, out_hash, startNonce);
-            hashes[startNonce]++;
+            while (TimeGetMilliSec() < to)
+            {
+                RandomHash_Search(allStates, out_hash, startNonce);
+                hashes[startNonce]++;
+            }
+        }
+        else
+        {
+            U8 laneHashes[RH_CPU_MAX_LANES * 32];
+            U32 laneNonces[RH_CPU_MAX_LANES];
+            for (U32 l = 0; l < LaneCount; l++)
+                laneNonces[l] = startNonce + l * (U32_Max / RH_CPU_MAX_LANES);
+
+            while (TimeGetMilliSec() < to)
+            {
+                RandomHash_SearchLanes(allStates, LaneCount, laneHashes, laneNonces);
+                hashes[startNonce] += LaneCount;
+            }
         }
     };
 
@@ -552,12 +583,8 @@ void GlobalMiningPreset::DoPerformanceTest()
 
         input[PascalHeaderNoncePosV4(PascalHeaderSize) / 4] = 0;
 
-        //NOTE: the header must allready be in device mem (via SetWork)
-        for(int i=0; i < ThreadCount; i++)
-        {
-            CUDA_SYM(RandomHash_SetHeader)(&g_threadsData[i], (U8*)input, nonce2);
-        }
-
+        if (timeoutID == 1)
+            hasEnergy = RH_GetCpuEnergy(energyStart);
         {
             std::vector<std::thread> threads(ThreadCount);
             U32 gid=0;
@@ -567,17 +594,25 @@ void GlobalMiningPreset::DoPerformanceTest()
                 {
                     U32 _gid = AtomicIncrement(gid);
                     RH_SetThreadPriority(RH_ThreadPrio_High);
-                    kernelFunc(&g_threadsData[_gid-1], _gid-1, TimeGetMilliSec() + timeout[timeoutID]); 
+                    GpuManager::PinMinerThread(_gid-1, (U32)ThreadCount);
+                    if (!threadStates[_gid-1])
+                        RandomHash_CreateMany(&threadStates[_gid-1], LaneCount);
+                    for (U32 l = 0; l < LaneCount; l++)
+                        CUDA_SYM(RandomHash_SetHeader)(&threadStates[_gid-1][l], (U8*)input, nonce2);
+                    kernelFunc(threadStates[_gid-1], _gid-1, TimeGetMilliSec() + timeout[timeoutID]); 
                 }
                 );
             }
             for(std::thread & thread : threads) 
                 thread.join();
         }
+        if (timeoutID == 1)
+            hasEnergy = hasEnergy && RH_GetCpuEnergy(energyEnd) && energyEnd > energyStart;
         
         CpuSleep(20);
         if (timeoutID == 0)
         {
+            RandomHash_LogStrideBanks(&threadStates[0], (U32)ThreadCount, LaneCount);
             for (auto& h : hashes)
                 h = 0;
         }
@@ -587,7 +622,128 @@ void GlobalMiningPreset::DoPerformanceTest()
     for (auto h : hashes)
         hashCnt += h;
     PrintOut("RandomHash speed is %.2f H/S\n", hashCnt / (float)g_testPerformance);
+    //whole package energy, so it includes the other processes and the idle cores
+    if (hasEnergy)
+        PrintOut("RandomHash efficiency is %.3f H/J (%.1f W)\n", hashCnt / ((energyEnd - energyStart) / 1e6), (energyEnd - energyStart) / 1e6 / g_testPerformance);
+    else
+        PrintOut("RandomHash efficiency is not available, no readable cpu energy counters\n");
+
+    if (GpuManager::CpuInfos.numaNodes.size() > 1)
+    {
+        std::vector<U64> nodeHashes(GpuManager::CpuInfos.numaNodes.size(), 0);
+        std::vector<U32> nodeThreads(GpuManager::CpuInfos.numaNodes.size(), 0);
+        for (U32 t = 0; t < ThreadCount; t++)
+        {
+            U32 node = GpuManager::GetMinerThreadNode(t, (U32)ThreadCount);
+            nodeHashes[node] += hashes[t];
+            nodeThreads[node]++;
+        }
+        for (U32 n = 0; n < nodeHashes.size(); n++)
+            PrintOut("Numa node %u : %.2f H/S on %u threads\n", n, nodeHashes[n] / (float)g_testPerformance, nodeThreads[n]);
+    }
+
+    U64 midStateHits = 0;
+    U64 fullTreeCount = 0;
+    for (U32 i = 0; i < ThreadCount * LaneCount; i++)
+    {
+        midStateHits += threadStates[i / LaneCount][i % LaneCount].m_midStateHits;
+        fullTreeCount += threadStates[i / LaneCount][i % LaneCount].m_fullTreeCount;
+    }
+    if (midStateHits + fullTreeCount)
+        PrintOut("Midstate reuse %.2f%% (%llu full tree searches)\n", 100.0f * midStateHits / (float)(midStateHits + fullTreeCount), fullTreeCount);
+
+    if (g_cpuAbandon)
+    {
+        U64 abandoned = 0;
+        for (U32 i = 0; i < ThreadCount * LaneCount; i++)
+            abandoned += threadStates[i / LaneCount][i % LaneCount].m_abandonedCount;
+        PrintOut("Abandoned %llu nonces over the %u%% percentile cost of a checkpoint (%.2f%% of the searches)\n", abandoned, g_cpuAbandon, 
+                 midStateHits + fullTreeCount ? 100.0f * abandoned / (float)(midStateHits + fullTreeCount) : 0.0f);
+    }
 
+    U32 bankPeak = 0;
+    U32 roundPeak[RH_N + 1] = { 0 };
+    for (U32 i = 0; i < ThreadCount * LaneCount; i++)
+    {
+        RandomHash_State& st = threadStates[i / LaneCount][i % LaneCount];
+        bankPeak = RH_Max(bankPeak, st.m_stridesAllocPeak);
+        for (U32 r = 1; r <= RH_N; r++)
+            roundPeak[r] = RH_Max(roundPeak[r], st.m_roundBytesPeak[r]);
+    }
+    PrintOut("Stride bank peak %u KB of %u KB. Round 1 to 5 strides peak %u, %u, %u, %u, %u KB\n", bankPeak / 1024, RH_STRIDE_BANK_SIZE / 1024, 
+             roundPeak[1] / 1024, roundPeak[2] / 1024, roundPeak[3] / 1024, roundPeak[4] / 1024, roundPeak[5] / 1024);
+
+    exit(0);
+}
+
+void GlobalMiningPreset::DoKernelTest()
+{
+    PrintOut("CPU: %s\n", GpuManager::CpuInfos.cpuBrandName.c_str());
+    RandomHash_TestKernels();
+    exit(0);
+}
+
+//NOTE: One hash cannot be spread on many cores. The nonce of each phase 2 is drawn from the round's generator, seeded with the
+//      outputs of its phase 1, so the whole tree is one chain of dependencies. The other cores run the same test at the same time, 
+//      to show the latency of a verifier that hashes on many cores.
+void GlobalMiningPreset::DoLatencyTest()
+{
+    const U32 CoreCounts[] = { 1, 2, 4, 8 };
+    const U32 WarmupCount = 8;
+
+    PrintOut("CPU: %s\n", GpuManager::CpuInfos.cpuBrandName.c_str());
+    PrintOut("Testing the latency of %d hashes without midstate\n", g_testLatency);
+    //placed for the largest core count, the smaller ones use the start of the same list
+    GpuManager::LoadCpuPlacement(RH_Min(CoreCounts[RHMINER_ARRAY_COUNT(CoreCounts) - 1], (U32)GpuManager::CpuInfos.numberOfProcessors));
+    GpuManager::PinServiceThread();
+    for (U32 coreCount : CoreCounts)
+    {
+        if (coreCount > GpuManager::CpuInfos.numberOfProcessors)
+            break;
+
+        std::vector<std::vector<U64>> latencies(coreCount);
+        std::vector<std::thread> threads(coreCount);
+        for (U32 t = 0; t < coreCount; t++)
+        {
+            threads[t] = std::thread([&, t]
+            {
+                RH_SetThreadPriority(RH_ThreadPrio_High);
+                GpuManager::PinMinerThread(t, coreCount);
+                RandomHash_State* state = 0;
+                RandomHash_CreateMany(&state, 1);
+
+                mersenne_twister_state rnd;
+                _CM(merssen_twister_seed)(0xF923A401 + t, &rnd);
+                U32 input[PascalHeaderSize / 4];
+                for (int i = 0; i < PascalHeaderSize / 4; i++)
+                    input[i] = _CM(merssen_twister_rand)(&rnd);
+
+                //a new header for each hash, so none of them reuse the midstate of the last one
+                for (U32 i = 0; i < WarmupCount + (U32)g_testLatency; i++)
+                {
+                    U8 out_hash[32];
+                    input[0] = i;
+                    CUDA_SYM(RandomHash_SetHeader)(state, (U8*)input, 0);
+                    U64 start = TimeGetMicroSec();
+                    RandomHash_Search(state, out_hash, _CM(merssen_twister_rand)(&rnd));
+                    if (i >= WarmupCount)
+                        latencies[t].push_back(TimeGetMicroSec() - start);
+                }
+                RandomHash_DestroyMany(state, 1);
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        std::vector<U64> all;
+        for (auto& l : latencies)
+            all.insert(all.end(), l.begin(), l.end());
+        std::sort(all.begin(), all.end());
+        if (all.empty())
+            continue;
+        PrintOut("%u core%s : p50 %.3f ms, p99 %.3f ms\n", coreCount, coreCount > 1 ? "s" : " ", 
+                 all[all.size() / 2] / 1000.0, all[RH_Min(all.size() - 1, all.size() * 99 / 100)] / 1000.0);
+    }
     exit(0);
 }
 
@@ -29,9 +29,16 @@ RHMINER_COMMAND_LINE_DECLARE_GLOBAL_STRING("configfile", g_configFileNameDummy,
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_BOOL("cpu", g_useCPU, "Gpu", "Enable the use of CPU to mine.\nex '-cpu -cputhreads 4' will enable mining on cpu while gpu mining.");
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("testperformance", g_testPerformance, "Debug", "Run performance test for an amount of seconds", 0, 120)
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("testperformancethreads", g_testPerformanceThreads, "Debug", "Amount of threads to use for performance test", 0, 256)
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_BOOL("testkernels", g_testKernels, "Debug", "Check the simd hash kernels against the scalar ones and print their throughput");
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("testlatency", g_testLatency, "Debug", "Time an amount of single hashes that start without a midstate, like a verifier does, and print their p50 and p99 latency.\nThe test is run with 1, 2, 4 and 8 cores hashing at the same time", 0, 100000)
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("processpriority", g_setProcessPrio, "General", "On windows only. Set miner's process priority.\n0=Background Process, 1=Low Priority, 2=Normal Priority, 3=High Priority.\nDefault is 3.\nNOTE:Background Proces mode will make the console disapear from the desktop and taskbar. WARNING: Changing this value will affect GPU mining.", 0, 10);
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("memoryboost", g_memoryBoostLevel, "Optimizations", "This option will enable some memory optimizations that could make the miner slower on some cpu.\nTest it with -testperformance before using it.\n1 to enable boost. 0 to disable boost.\nEnabled, by default, on cpu with hyperthreading.", 0, RH_OPT_UNSET+1);
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("sseboost", g_sseOptimization, "Optimizations", "This option will enable some sse4 optimizations.\nIt could make the miner slower on some cpu.\nTest it with -testperformance before using it.\n1 to enable SSe4.1 optimizations. 0 to disable.\nDisabled by default. ", 0, 2);
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("smalltables", g_smallHashTables, "Optimizations", "Use smaller lookup tables in the table driven hashes (Whirlpool: 2 KB instead of 16 KB).\nThis leaves more of the cpu cache to the other threads, at the cost of a few more instructions per hash.\nTest it with -testperformance before using it.\n1 to enable. 0 to disable.\nDisabled by default.", 0, 1);
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("hugepages", g_hugePages, "Optimizations", "Put the memory of the cpu miner threads on 2 MB pages.\nThis cuts the TLB misses of the random reads in the 5 MB of each thread.\nOn linux, the hugetlb pages reserved in /proc/sys/vm/nr_hugepages are used first, then the transparent huge pages.\nOn windows, it needs the 'Lock pages in memory' privilege.\nThe pages obtained are printed at startup.\n1 to enable. 0 to disable.\nDisabled by default.", 0, 1);
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("lockpages", g_lockPages, "Optimizations", "Lock the memory of the cpu miner threads in ram so it is never swapped out.\nOn linux, the memlock limit (ulimit -l) must allow 5 MB per thread.\n1 to enable. 0 to disable.\nDisabled by default.", 0, 1);
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("abandon", g_cpuAbandon, "Optimizations", "Abandon the nonces that cost more cpu time than this percentile of the recent ones, and start a fresh nonce instead.\nA search is checked after each of its round 2 hashes, against the cpu time the recent searches had at the same point.\nSo a search can be abandoned at any of these checkpoints, and more nonces than the percentile suggests are abandoned.\n-testperformance prints the real rate.\nThe budgets are learned separately for the searches that reuse the last midstate and the ones that build the full tree.\nAbandoning a midstate search also drops the midstate, so this only pays off when a few nonces are much slower than the others.\nOnly with -lanes 1. Test it with -testperformance before using it.\nEx. -abandon 95. Disabled by default.", 0, 99);
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_STRING("affinity", g_cpuAffinity, "Optimizations", "Pin each cpu miner thread on one logical core.\n'physical' uses one logical core per physical core first, then the hyperthreads.\n'l2' uses one logical core per L2 cache first, then the others like 'physical'.\nA core list, ex: 0,2,4-7, pins the threads on those cores in that order.\nThe stratum and submit threads are pinned on the cores left free by the miner threads.\nTest it with -testperformance before using it.\nDisabled by default.");
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_BOOL("restarted", g_restared, "*", "");
 
 extern U32 g_cpuMinerThreads;
@@ -102,6 +109,8 @@ class GlobalMiningPreset
         //  Stats
         U32 GetUpTimeMS();
         void DoPerformanceTest();
+        void DoKernelTest();
+        void DoLatencyTest();
 
         ///////////////////////////////////////////////////
         //  
@@ -50,6 +50,11 @@ CPUInfo                            GpuManager::CpuInfos;
 bool                               g_isSSE3Supported = false;
 bool                               g_isSSE4Supported = false;
 bool                               g_isAVX2Supported = false;
+bool                               g_isSHASupported = false;
+bool                               g_isAVX512Supported = false;
+
+extern void RandomHash_InitKernelTable(bool logKernels);
+extern int  g_cpuLanes;
 
 
 GpuManager::GpuManager()
@@ -309,11 +314,6 @@ void GpuManager::SetPostCommandLineOptions()
     if (g_sseOptimization > 2)
         g_sseOptimization = 2;
 
-#if defined(RHMINER_COND_SSE4)
-    g_sseOptimization = 0;
-#endif
-
-
     if (g_sseOptimization == 2)
     {
 #if defined(RH_ENABLE_AVX)
@@ -337,6 +337,24 @@ void GpuManager::SetPostCommandLineOptions()
     PrintOut("Detecting old-gen cpu.\n");
 
 #endif //#ifdef RHMINER_ENABLE_SSE4
+
+    //rebuilt now that -sseboost is known
+    RandomHash_InitKernelTable(true);
+
+    //the lane program has no abandon checkpoints
+    if (g_cpuAbandon && g_cpuLanes > 1)
+    {
+        PrintOut("WARNING. -abandon only works with -lanes 1. -abandon ignored.\n");
+        g_cpuAbandon = 0;
+    }
+
+    //the threads created from now on inherit the main thread's affinity.
+    //The performance and latency tests place their own thread counts
+    if (!g_testPerformance && !g_testLatency)
+    {
+        LoadCpuPlacement(g_cpuMinerThreads);
+        PinServiceThread();
+    }
 }
 
 void GpuManager::LoadGPUMap() 
@@ -614,6 +632,9 @@ bool GpuManager::SetupGPU()
     if (g_memoryBoostLevel)
         PrintOutCritical("Enabling Memory boost.\n");
 
+    if (g_smallHashTables)
+        PrintOutCritical("Using small hash tables.\n");
+
     if (g_sseOptimization)
     {
         const char* ss[] = {"", "SSE4.1", "AVX2"};
@@ -684,6 +705,17 @@ void __cpuid(int* cpuinfo, int info)
 	);
 }
 
+void __cpuidex(int* cpuinfo, int info, int subinfo)
+{
+	__asm__ __volatile__(
+		"xchg %%ebx, %%edi;"
+		"cpuid;"
+		"xchg %%ebx, %%edi;"
+		:"=a" (cpuinfo[0]), "=D" (cpuinfo[1]), "=c" (cpuinfo[2]), "=d" (cpuinfo[3])
+		:"0" (info), "2" (subinfo)
+	);
+}
+
 unsigned long long _xgetbv(unsigned int index)
 {
 	unsigned int eax, edx;
@@ -768,13 +800,31 @@ void GpuManager::TestExtraInstructions()
 	// http://insufficientlycomplicated.wordpress.com/2011/11/07/detecting-intel-advanced-vector-extensions-avx-in-visual-studio/	
 	CpuInfos.avxSupportted = cpuinfo[2] & (1 << 28) || false;
 	bool osxsaveSupported = cpuinfo[2] & (1 << 27) || false;
+	unsigned long long xcrFeatureMask = 0;
 	if (osxsaveSupported && CpuInfos.avxSupportted)
 	{
 		// _XCR_XFEATURE_ENABLED_MASK = 0
-		unsigned long long xcrFeatureMask = _xgetbv(0);
+		xcrFeatureMask = _xgetbv(0);
 		CpuInfos.avxSupportted = (xcrFeatureMask & 0x6) == 0x6;
 	}
 
+	// ----------------------------------------------------------------------
+	// Check AVX2 and SHA extensions support. Structured extended feature flags, leaf 7 sub-leaf 0
+	__cpuid(cpuinfo, 0);
+	if (cpuinfo[0] >= 7)
+	{
+		__cpuidex(cpuinfo, 7, 0);
+		CpuInfos.avx2Supportted = CpuInfos.avxSupportted && (cpuinfo[1] & (1 << 5));
+		CpuInfos.shaSupportted = CpuInfos.sse4_1Supportted && (cpuinfo[1] & (1 << 29));
+
+		// AVX-512 F, BW and VL. The os must also save the opmask and zmm registers (xcr0 bits 5 to 7)
+		CpuInfos.avx512Supportted = CpuInfos.avx2Supportted && 
+		                            (xcrFeatureMask & 0xE0) == 0xE0 &&
+		                            (cpuinfo[1] & (1 << 16)) && 
+		                            (cpuinfo[1] & (1 << 30)) && 
+		                            (cpuinfo[1] & (1u << 31));
+	}
+
 	// ----------------------------------------------------------------------
 	// Check SSE4a and SSE5 support
 	// Get the number of valid extended IDs
@@ -789,18 +839,272 @@ void GpuManager::TestExtraInstructions()
     
     g_isSSE3Supported = CpuInfos.sse3Supportted;
     g_isSSE4Supported = CpuInfos.sse4_1Supportted;
-    g_isAVX2Supported = CpuInfos.avxSupportted;
+    g_isAVX2Supported = CpuInfos.avx2Supportted;
+    g_isSHASupported = CpuInfos.shaSupportted;
+    g_isAVX512Supported = CpuInfos.avx512Supportted;
     PrintOutSilent("SSe3   supported : %s\n", CpuInfos.sse3Supportted ? "Yes" : "No");
     PrintOutSilent("SSe4.1 supported : %s\n", CpuInfos.sse4_1Supportted ? "Yes" : "No");
     PrintOutSilent("avx    supported : %s\n", CpuInfos.avxSupportted ? "Yes" : "No");	
+    PrintOutSilent("avx2   supported : %s\n", CpuInfos.avx2Supportted ? "Yes" : "No");
+    PrintOutSilent("sha    supported : %s\n", CpuInfos.shaSupportted ? "Yes" : "No");
+    PrintOutSilent("avx512 supported : %s\n", CpuInfos.avx512Supportted ? "Yes" : "No");
+
 
-#if defined(RHMINER_ENABLE_SSE4) && !defined(RHMINER_COND_SSE4)
-    if (!CpuInfos.sse4_1Supportted)
+    RandomHash_InitKernelTable(false);
+}
+
+//Numa topology from sysfs on linux. Nodes without processors (memory only) are skipped
+void GpuManager::LoadNumaNodes()
+{
+    CpuInfos.numaNodes.clear();
+#if defined(_WIN32_WINNT)
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode))
+    {
+        for (ULONG n = 0; n <= highestNode; n++)
+        {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask((UCHAR)n, &mask) || !mask)
+                continue;
+            std::vector<U32> cpus;
+            for (U32 c = 0; c < 64; c++)
+                if (mask & (1ULL << c))
+                    cpus.push_back(c);
+            CpuInfos.numaNodes.push_back(cpus);
+        }
+    }
+#elif defined(__linux__)
+    //node ids can have holes, the online file lists them in the cpu list format
+    string line;
+    ifstream fonline("/sys/devices/system/node/online");
+    if (getline(fonline, line))
     {
-        PrintOutCritical("SSE4 is not supported by this CPU. Please use rhminer for oldgen cpu\n");
-        exit( 1);
+        for (U32 n : RH_ParseCpuList(TrimString(line)))
+        {
+            ifstream f(string(FormatString("/sys/devices/system/node/node%u/cpulist", n)));
+            if (!getline(f, line))
+                continue;
+            std::vector<U32> cpus = RH_ParseCpuList(TrimString(line));
+            if (cpus.size())
+                CpuInfos.numaNodes.push_back(cpus);
+        }
     }
 #endif
+
+    if (CpuInfos.numaNodes.empty())
+    {
+        std::vector<U32> cpus;
+        for (U32 c = 0; c < CpuInfos.numberOfProcessors; c++)
+            cpus.push_back(c);
+        CpuInfos.numaNodes.push_back(cpus);
+    }
+
+    for (U32 n = 0; n < CpuInfos.numaNodes.size(); n++)
+        PrintOutSilent("Numa node %u : %u logical cores\n", n, (U32)CpuInfos.numaNodes[n].size());
+}
+
+//Threads are grouped on numa nodes in contiguous blocks, proportionaly to the node's processor count
+U32 GpuManager::GetThreadNumaNode(U32 threadIndex, U32 threadCount)
+{
+    U32 total = 0;
+    for (auto& n : CpuInfos.numaNodes)
+        total += (U32)n.size();
+    if (!threadCount || CpuInfos.numaNodes.size() <= 1)
+        return 0;
+
+    U32 slot = (U32)(((U64)threadIndex * total) / threadCount);
+    for (U32 n = 0; n < CpuInfos.numaNodes.size(); n++)
+    {
+        if (slot < CpuInfos.numaNodes[n].size())
+            return n;
+        slot -= (U32)CpuInfos.numaNodes[n].size();
+    }
+    return (U32)CpuInfos.numaNodes.size() - 1;
+}
+
+//Pin the calling thread on the processors of a numa node. 
+//Memory the thread touches first after this is then allocated on that node by the os
+bool GpuManager::SetThreadNumaNode(U32 node)
+{
+    if (CpuInfos.numaNodes.size() <= 1 || node >= CpuInfos.numaNodes.size())
+        return false;
+
+    return RH_SetThreadAffinity(CpuInfos.numaNodes[node]);
+}
+
+//Logical processor order of the -affinity policies.
+//smtRank is the index of a processor among the hyperthreads of its physical core, l2Group the first processor sharing its L2
+void GpuManager::LoadCpuPlacement(U32 threadCount)
+{
+    CpuInfos.threadCpus.clear();
+    CpuInfos.serviceCpus.clear();
+    string mode = TrimString(g_cpuAffinity);
+    if (mode.empty())
+        return;
+
+    std::vector<U32> online;
+    for (auto& n : CpuInfos.numaNodes)
+        online.insert(online.end(), n.begin(), n.end());
+    std::sort(online.begin(), online.end());
+    const U32 maxCpu = online.back() + 1;
+    std::vector<U32> smtRank(maxCpu, 0);
+    std::vector<U32> l2Group(maxCpu, 0);
+    for (U32 c : online)
+        l2Group[c] = c;
+
+#if defined(_WIN32_WINNT)
+    DWORD returnLength = 0;
+    GetLogicalProcessorInformation(NULL, &returnLength);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(returnLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+    if (returnLength && GetLogicalProcessorInformation(&infos[0], &returnLength))
+    {
+        for (U32 i = 0; i < returnLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); i++)
+        {
+            const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& inf = infos[i];
+            bool isCore = inf.Relationship == RelationProcessorCore;
+            bool isL2 = inf.Relationship == RelationCache && inf.Cache.Level == 2;
+            if (!isCore && !isL2)
+                continue;
+            U32 rank = 0;
+            U32 first = U32_Max;
+            for (U32 c = 0; c < maxCpu && c < sizeof(ULONG_PTR) * 8; c++)
+            {
+                if (!(inf.ProcessorMask & ((ULONG_PTR)1 << c)))
+                    continue;
+                if (first == U32_Max)
+                    first = c;
+                if (isCore)
+                    smtRank[c] = rank++;
+                else
+                    l2Group[c] = first;
+            }
+        }
+    }
+#elif defined(__linux__)
+    for (U32 c : online)
+    {
+        string line;
+        ifstream fsib(string(FormatString("/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", c)));
+        if (getline(fsib, line))
+        {
+            std::vector<U32> siblings = RH_ParseCpuList(TrimString(line));
+            for (U32 i = 0; i < siblings.size(); i++)
+                if (siblings[i] == c)
+                    smtRank[c] = i;
+            if (siblings.size())
+                l2Group[c] = siblings[0];
+        }
+
+        for (U32 k = 0; k < 8; k++)
+        {
+            ifstream flevel(string(FormatString("/sys/devices/system/cpu/cpu%u/cache/index%u/level", c, k)));
+            if (!getline(flevel, line))
+                break;
+            if (ToUInt(TrimString(line)) != 2)
+                continue;
+            ifstream fshared(string(FormatString("/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", c, k)));
+            if (getline(fshared, line))
+            {
+                std::vector<U32> shared = RH_ParseCpuList(TrimString(line));
+                if (shared.size())
+                    l2Group[c] = shared[0];
+            }
+            break;
+        }
+    }
+#endif
+
+    if (mode == "physical" || mode == "l2")
+    {
+        std::vector<U32> order = online;
+        std::stable_sort(order.begin(), order.end(), [&](U32 a, U32 b) { return smtRank[a] < smtRank[b]; });
+        if (mode == "l2")
+        {
+            std::vector<U32> rest;
+            std::vector<bool> l2Used(maxCpu, false);
+            for (U32 c : order)
+            {
+                if (l2Used[l2Group[c]])
+                    rest.push_back(c);
+                else
+                {
+                    l2Used[l2Group[c]] = true;
+                    CpuInfos.threadCpus.push_back(c);
+                }
+            }
+            CpuInfos.threadCpus.insert(CpuInfos.threadCpus.end(), rest.begin(), rest.end());
+        }
+        else
+            CpuInfos.threadCpus = order;
+    }
+    else
+    {
+        for (U32 c : RH_ParseCpuList(mode))
+        {
+            if (std::find(online.begin(), online.end(), c) != online.end())
+                CpuInfos.threadCpus.push_back(c);
+            else
+                PrintOut("Warning: -affinity logical core %u does not exist\n", c);
+        }
+        if (CpuInfos.threadCpus.empty())
+        {
+            PrintOutCritical("Error. Invalid -affinity value '%s'. Cpu miner threads will not be pinned\n", mode.c_str());
+            return;
+        }
+    }
+
+    const U32 used = RH_Min((U32)CpuInfos.threadCpus.size(), threadCount);
+    string str;
+    for (U32 i = 0; i < used; i++)
+        str += FormatString("%s%u", i ? "," : "", CpuInfos.threadCpus[i]);
+    PrintOut("Cpu miner threads pinned on logical cores %s\n", str.c_str());
+    if (threadCount > CpuInfos.threadCpus.size())
+        PrintOut("Warning: %u cpu miner threads on %u logical cores. Some cores are shared\n", threadCount, (U32)CpuInfos.threadCpus.size());
+
+    for (U32 c : online)
+        if (std::find(CpuInfos.threadCpus.begin(), CpuInfos.threadCpus.begin() + used, c) == CpuInfos.threadCpus.begin() + used)
+            CpuInfos.serviceCpus.push_back(c);
+    if (CpuInfos.serviceCpus.empty())
+        PrintOut("No free logical core left for the stratum and submit threads\n");
+}
+
+//Logical processor of a cpu miner thread, U32_Max when threads are not pinned
+U32 GpuManager::GetThreadCpu(U32 threadIndex)
+{
+    if (CpuInfos.threadCpus.empty())
+        return U32_Max;
+    return CpuInfos.threadCpus[threadIndex % CpuInfos.threadCpus.size()];
+}
+
+U32 GpuManager::GetCpuNumaNode(U32 cpu)
+{
+    for (U32 n = 0; n < CpuInfos.numaNodes.size(); n++)
+        if (std::find(CpuInfos.numaNodes[n].begin(), CpuInfos.numaNodes[n].end(), cpu) != CpuInfos.numaNodes[n].end())
+            return n;
+    return 0;
+}
+
+U32 GpuManager::GetMinerThreadNode(U32 threadIndex, U32 threadCount)
+{
+    U32 cpu = GetThreadCpu(threadIndex);
+    return cpu != U32_Max ? GetCpuNumaNode(cpu) : GetThreadNumaNode(threadIndex, threadCount);
+}
+
+//Pin the calling cpu miner thread on its -affinity core, or else on its numa node
+void GpuManager::PinMinerThread(U32 threadIndex, U32 threadCount)
+{
+    U32 cpu = GetThreadCpu(threadIndex);
+    if (cpu != U32_Max)
+        RH_SetThreadAffinity(std::vector<U32>(1, cpu));
+    else
+        SetThreadNumaNode(GetThreadNumaNode(threadIndex, threadCount));
+}
+
+//Keep the calling thread off the hashing cores
+void GpuManager::PinServiceThread()
+{
+    if (CpuInfos.serviceCpus.size())
+        RH_SetThreadAffinity(CpuInfos.serviceCpus);
 }
 
 void GpuManager::LoadCPUInfos()
@@ -910,4 +1214,5 @@ void GpuManager::LoadCPUInfos()
     CpuInfos.cpuBrandName = brand;
 
     TestExtraInstructions();
+    LoadNumaNodes();
 }
@@ -74,6 +74,9 @@ struct CPUInfo
     bool    sse4aSupportted = false;
     bool    sse5Supportted = false;
     bool    avxSupportted = false;
+    bool    avx2Supportted = false;
+    bool    shaSupportted = false;
+    bool    avx512Supportted = false;
     bool*   pEnabled = 0;
     U64     avaiablelMem;
     U32     numberOfProcessors; //counting hyperthreads
@@ -82,6 +85,9 @@ struct CPUInfo
     U32     allocationGranularity;
     U64     UserSelectedCores = 0x0;  //mask used by SetProcessAffinityMask when application starts
     U64     UserSelectedCoresCount = 0;
+    std::vector<std::vector<U32>> numaNodes;    //logical processors of each numa node. A single node on non-numa systems
+    std::vector<U32> threadCpus;                //logical processor of each cpu miner thread, in order. Empty when threads are not pinned
+    std::vector<U32> serviceCpus;               //logical processors left to the stratum and submit threads
 };
 
 
@@ -137,6 +143,15 @@ public:
     static void                     LoadGPUMap();
     static void                     LoadCPUInfos();
     static void                     TestExtraInstructions();
+    static void                     LoadNumaNodes();
+    static U32                      GetThreadNumaNode(U32 threadIndex, U32 threadCount);
+    static bool                     SetThreadNumaNode(U32 node);
+    static void                     LoadCpuPlacement(U32 threadCount);
+    static U32                      GetThreadCpu(U32 threadIndex);
+    static U32                      GetCpuNumaNode(U32 cpu);
+    static U32                      GetMinerThreadNode(U32 threadIndex, U32 threadCount);
+    static void                     PinMinerThread(U32 threadIndex, U32 threadCount);
+    static void                     PinServiceThread();
     static void                     SetPostCommandLineOptions();
     
     static std::vector<cl::Device>  GetDevices(std::vector<cl::Platform> const& _platforms, unsigned _platformId);
@@ -20,6 +20,8 @@ const static U32 PascalHeaderSize        = 200; //Fixed header size for pool min
 const static U32 PascalHeaderNonce2Pos   = 116;
 const static U32 PascalHeaderNoncePosV3  = (PascalHeaderSize-4);
 #define          PascalHeaderNoncePosV4(headerSize) (headerSize - 4)
+//bytes of the full blocks before the nonce, for a hash of the given block size
+#define          PascalHeaderPrefixSize(blockSize) ((PascalHeaderNoncePosV4(PascalHeaderSize) / (blockSize)) * (blockSize))
 
 
 #define RH_M                    (RHMINER_KB(10)*5)
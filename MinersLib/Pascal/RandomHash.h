@@ -31,8 +31,13 @@ struct RH_ALIGN(RH_IDEAL_ALIGNMENT) RH_RoundData
     RH_ALIGN(RH_IDEAL_ALIGNMENT) RH_StridePtrArray        io_results;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) RH_StridePtrArray        backup_io_results;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      first_round_consume;
+    U32                                                   foldExpand;     //set by the phase 1 push of the parent round, see RandomHash_end
 };
 
+#define RH_HEADER_MIDSTATE_SIZE 256
+#define RH_ABANDON_SAMPLES      128
+#define RH_ABANDON_CHECKPOINTS  8
+
 struct RH_ALIGN(RH_IDEAL_ALIGNMENT) RandomHash_State
 {
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U8                       m_header[PascalHeaderSize]; 
@@ -42,6 +47,8 @@ struct RH_ALIGN(RH_IDEAL_ALIGNMENT) RandomHash_State
     RH_ALIGN(RH_IDEAL_ALIGNMENT) mersenne_twister_state   m_rndGenExpand;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_startNonce;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) RH_StridePtr             m_stridesInstances;
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_stridesPages;     //RH_PAGES_xxx of the bank
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_stridesLocked;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_stridesAllocIndex;
 
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_stridesAllocMidstateBarrier;
@@ -50,11 +57,37 @@ struct RH_ALIGN(RH_IDEAL_ALIGNMENT) RandomHash_State
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U8                       m_roundInput[RH_IDEAL_ALIGNMENT+512];
     RH_ALIGN(RH_IDEAL_ALIGNMENT) RH_StridePtrArray        m_round5Phase2PrecalcArray;
 
+    //round 1 hashes the header where only the nonce changes. The state of each hash after the blocks before the nonce, 
+    //and the Murmur3 of the bytes before the nonce, are computed once per header. See RandomHash_Init
+    RH_ALIGN(64)                 U8                       m_headerMidstates[RH_ALGO_COUNT][RH_HEADER_MIDSTATE_SIZE];
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) MurmurHash3_x86_32_State m_headerMurmur;
+
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_isCachedOutputs;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_isNewHeader;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_isMidStateRound;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_midStateNonce;
     RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_skipPhase1;
+
+    //midstate reuse statistics. A search either starts from the cached round 4 outputs of the last neighbour nonce or runs the full tree
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U64                      m_midStateHits;
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U64                      m_fullTreeCount;
+
+    //stride bank usage. The highest offset reached in the bank and, for each round, the most bytes of strides a search allocated
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_stridesAllocPeak;
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_roundBytes[RH_N+1];
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_roundBytesPeak[RH_N+1];
+
+    //early abandonment of the costly nonces, see RandomHash_Search. The thread cpu time (ns on linux, cycles on windows) the last searches
+    //had at each checkpoint, for the full tree searches [0] and the midstate ones [1], and the budgets set from them
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U64                      m_searchStartTime;
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U32                      m_searchKind;
+    U32                                                   m_abandoned;
+    U32                                                   m_checkpoint;
+    U64                                                   m_abandonedCount;
+    U64                                                   m_checkpointCost[RH_ABANDON_CHECKPOINTS];
+    U64                                                   m_abandonBudget[2][RH_ABANDON_CHECKPOINTS];
+    U32                                                   m_abandonSampleCount[2];
+    U64                                                   m_abandonSamples[2][RH_ABANDON_CHECKPOINTS][RH_ABANDON_SAMPLES];
 };
 
 //External API functions
@@ -72,7 +105,17 @@ extern void             CUDA_SYM(RandomHash_Alloc)(void** out_ptr, size_t size);
 extern void             CUDA_SYM(RandomHash_SetHeader)(RandomHash_State* state, U8* sourceHeader, U32 nonce2);
 
 #ifndef RANDOMHASH_CUDA
+    #define RH_CPU_MAX_LANES 4
+
     extern void RandomHash_Search(RandomHash_State* state, U8* out_hash, U32 startNonce);
+    //Search on laneCount consecutive states interleaved on the calling thread. out_hashes receives 32 bytes per lane
+    extern void RandomHash_SearchLanes(RandomHash_State* states, U32 laneCount, U8* out_hashes, U32* startNonces);
+    //Print the pages and the locking the stride banks got, once all the threads created their states
+    extern void RandomHash_LogStrideBanks(RandomHash_State* const* stateArrays, U32 arrayCount, U32 statesPerArray);
+    //Pick the Transfo, Murmur3 and hash kernels for the isa of the cpu. Called once the cpu features are known
+    extern void RandomHash_InitKernelTable(bool logKernels);
+    //Check every simd hash kernel against its scalar version and print their throughput
+    extern void RandomHash_TestKernels();
 #endif
 
 
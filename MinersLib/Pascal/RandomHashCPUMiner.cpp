@@ -19,6 +19,7 @@
 #include "MinersLib/Algo/sph_blake.h"
 #include "rhminer/ClientManager.h"
 RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_cputhrottling, 0)
+RHMINER_COMMAND_LINE_DEFINE_GLOBAL_INT(g_cpuLanes, 1)
 
 const U64 VentingMultiplyer = 3;
 extern bool g_useGPU;
@@ -32,7 +33,8 @@ RandomHashCPUMiner::RandomHashCPUMiner(FarmFace& _farm, unsigned globalWorkMult,
 
 RandomHashCPUMiner::~RandomHashCPUMiner()
 {
-    RandomHash_DestroyMany(m_randomHashArray, g_cpuMinerThreads);
+    for (auto states : m_laneStates)
+        RandomHash_DestroyMany(states, g_cpuLanes);
 }
 
 void RandomHashCPUMiner::InitFromFarm(U32 relativeIndex)
@@ -45,8 +47,25 @@ void RandomHashCPUMiner::InitFromFarm(U32 relativeIndex)
     m_localWorkSize = 64;
     UpdateWorkSize(g_cpuRoundsThread * g_cpuMinerThreads); //64
 
-    RandomHash_DestroyMany(m_randomHashArray, g_cpuMinerThreads);
-    RandomHash_CreateMany(&m_randomHashArray, g_cpuMinerThreads); 
+    if (g_cpuLanes > 1)
+        PrintOut("Cpu miner running %d interleaved lanes per thread\n", g_cpuLanes);
+
+    //each thread creates its own g_cpuLanes states, see RandomHashCpuKernel
+    for (auto states : m_laneStates)
+        RandomHash_DestroyMany(states, g_cpuLanes);
+    m_laneStates.assign(g_cpuMinerThreads, (RandomHash_State*)0);
+    m_laneStatesCreated = 0;
+
+    const U32 nodeCount = (U32)GpuManager::CpuInfos.numaNodes.size();
+    m_nodeHashes.assign(nodeCount, 0);
+    if (nodeCount > 1)
+    {
+        std::vector<U32> nodeThreads(nodeCount, 0);
+        for (U32 i=0; i < (U32)g_cpuMinerThreads; i++)
+            nodeThreads[GpuManager::GetMinerThreadNode(i, g_cpuMinerThreads)]++;
+        for (U32 n = 0; n < nodeCount; n++)
+            PrintOut("Numa node %u : %u cpu miner threads on %u logical cores\n", n, nodeThreads[n], (U32)GpuManager::CpuInfos.numaNodes[n].size());
+    }
 
     //Make all CPU miner threads
     for (U32 i=0; i < (U32)g_cpuMinerThreads; i++)
@@ -54,6 +73,7 @@ void RandomHashCPUMiner::InitFromFarm(U32 relativeIndex)
         CPUKernelData* kdata = (CPUKernelData*)RH_SysAlloc(sizeof(CPUKernelData));
         memset(kdata, 0, sizeof(CPUKernelData));
         kdata->m_id = i;
+        kdata->m_node = GpuManager::GetMinerThreadNode(i, g_cpuMinerThreads);
 		//kdata->m_packages[0].m_requestPause = true;
         kdata->m_thread = new std::thread([&,kdata] { RandomHashCpuKernel(kdata); });
         m_cpuKernels.push_back(kdata);
@@ -87,6 +107,19 @@ void RandomHashCPUMiner::RandomHashCpuKernel(CPUKernelData* kernelData)
     U32 endFrame = gid + workWindow;
     bool paused = false;
     U64 oldID = U64_Max;
+#ifdef RH_FORCE_PASCAL_V3_ON_CPU
+    const U32 laneCount = 1;
+#else
+    const U32 laneCount = (U32)g_cpuLanes;
+#endif
+    //Pin the thread on its core or numa node before creating the states, so the stride bank prefault places them in local memory
+    GpuManager::PinMinerThread(kernelData->m_id, g_cpuMinerThreads);
+    RandomHash_CreateMany(&m_laneStates[kernelData->m_id], (U32)g_cpuLanes);
+    if (AtomicIncrement(m_laneStatesCreated) == (U32)g_cpuMinerThreads)
+        RandomHash_LogStrideBanks(&m_laneStates[0], (U32)g_cpuMinerThreads, (U32)g_cpuLanes);
+    RandomHash_State* laneStates = m_laneStates[kernelData->m_id];
+    U32 laneNonces[RH_CPU_MAX_LANES];
+    static_assert(RH_CPU_MAX_LANES * 32 <= sizeof(CPUKernelData::DataPackage::m_work1), "Not enough room for all lanes results");
 	U64 cpuVentingTimeout = 0;
 	const U64 CpuVentingPeriod = g_cputhrottling * 10;
 
@@ -125,7 +158,13 @@ void RandomHashCPUMiner::RandomHashCpuKernel(CPUKernelData* kernelData)
             if (oldID != packageID)
             {
 				gid = packageData->m_rndVal;
-                RandomHash_SetHeader(&m_randomHashArray[kernelData->m_id], packageData->m_header.asU8, (U32)packageData->m_nonce2);                 
+                for (U32 l = 0; l < laneCount; l++)
+                {
+                    //same header, the lane goes on with the neighbour nonce of its last search instead of a full tree
+                    if (memcmp(laneStates[l].m_header, packageData->m_header.asU8, PascalHeaderSize))
+                        RandomHash_SetHeader(&laneStates[l], packageData->m_header.asU8, (U32)packageData->m_nonce2);
+                    laneNonces[l] = gid + l * (U32_Max / RH_CPU_MAX_LANES);
+                }
             }
 
             if (*GpuManager::CpuInfos.pEnabled == false)
@@ -141,45 +180,51 @@ void RandomHashCPUMiner::RandomHashCpuKernel(CPUKernelData* kernelData)
             PascalHashV3(packageData->m_work1, packageData->m_header.asU8);
     #else
             //set start nonce here
-            RandomHash_Search(&m_randomHashArray[kernelData->m_id], (U8*)packageData->m_work1, gid);
+            if (laneCount == 1)
+                RandomHash_Search(laneStates, (U8*)packageData->m_work1, gid);
+            else
+                RandomHash_SearchLanes(laneStates, laneCount, (U8*)packageData->m_work1, laneNonces);
     #endif            
-            U32* work = (uint32_t *)packageData->m_work1;
-            bool resetOFfset = false;
-            if (RH_swap_u32(*work) <= packageData->m_target)
+            for (U32 l = 0; l < laneCount; l++)
             {
-                //Swapb256
-                U32 tmp[4] = {work[0], work[1], work[2], work[3]};
-                work[0] = RH_swap_u32(work[7]);            
-                work[1] = RH_swap_u32(work[6]);
-                work[2] = RH_swap_u32(work[5]);
-                work[3] = RH_swap_u32(work[4]);
-                work[4] = RH_swap_u32(tmp[3]);
-                work[5] = RH_swap_u32(tmp[2]);
-                work[6] = RH_swap_u32(tmp[1]);
-                work[7] = RH_swap_u32(tmp[0]);
-                if (IsHashLessThan_32(work, packageData->m_targetFull))
+                U32* work = (uint32_t *)(packageData->m_work1 + l * 32);
+                bool resetOFfset = false;
+                if (RH_swap_u32(*work) <= packageData->m_target)
                 {
-                    std::vector<U64> foundNonce;
-#ifdef RH_FORCE_PASCAL_V3_ON_CPU
-                    foundNonce.push_back(gidBE);
-#else
-                    foundNonce.push_back(m_randomHashArray[kernelData->m_id].m_startNonce);
-#endif              
-                    SolutionSptr solPtr = MakeSubmitSolution(foundNonce, packageData->m_nonce2, true);
-                    m_farm.submitProof(solPtr);
-                    resetOFfset = true;
-
-                    //pause all solutions until next package in solo
-                    if (kernelData->m_isSolo)
+                    //Swapb256
+                    U32 tmp[4] = {work[0], work[1], work[2], work[3]};
+                    work[0] = RH_swap_u32(work[7]);            
+                    work[1] = RH_swap_u32(work[6]);
+                    work[2] = RH_swap_u32(work[5]);
+                    work[3] = RH_swap_u32(work[4]);
+                    work[4] = RH_swap_u32(tmp[3]);
+                    work[5] = RH_swap_u32(tmp[2]);
+                    work[6] = RH_swap_u32(tmp[1]);
+                    work[7] = RH_swap_u32(tmp[0]);
+                    if (IsHashLessThan_32(work, packageData->m_targetFull))
                     {
-                        paused = true;
-                    }
-
-#ifdef RH_SCREEN_SAVER_MODE
-                    extern void ScreensaverFoundNonce(U32 nonce);
-                    ScreensaverFoundNonce(foundNonce[0]);
-#endif
+                        std::vector<U64> foundNonce;
+    #ifdef RH_FORCE_PASCAL_V3_ON_CPU
+                        foundNonce.push_back(gidBE);
+    #else
+                        foundNonce.push_back(laneStates[l].m_startNonce);
+    #endif              
+                        SolutionSptr solPtr = MakeSubmitSolution(foundNonce, packageData->m_nonce2, true);
+                        m_farm.submitProof(solPtr);
+                        resetOFfset = true;
+
+                        //pause all solutions until next package in solo
+                        if (kernelData->m_isSolo)
+                        {
+                            paused = true;
+                        }
+
+    #ifdef RH_SCREEN_SAVER_MODE
+                        extern void ScreensaverFoundNonce(U32 nonce);
+                        ScreensaverFoundNonce(foundNonce[0]);
+    #endif
 
+                    }
                 }
             }
             /*gid++;
@@ -198,7 +243,7 @@ void RandomHashCPUMiner::RandomHashCpuKernel(CPUKernelData* kernelData)
             CpuSleep(20);
         }
         oldID = packageID;
-        kernelData->m_hashes++;
+        kernelData->m_hashes += laneCount;
     }
     AtomicSet(kernelData->m_abortThread, U32_Max);
 }
@@ -281,8 +326,13 @@ void RandomHashCPUMiner::SendWorkPackageToKernels(PascalWorkPackage* wp, bool re
 #ifdef RH_RANDOMIZE_NONCE2
         if (!wp->m_isSolo)
         {
-            //inject new n2
-            kernelData->m_nonce2 = rand32();
+            //inject new n2. A package of the same job, after a pause or a resend, keeps the n2 of the last one 
+            //so the header is the same and the kernel keeps its midstate chain
+            CPUKernelData::DataPackage* lastData = &data->m_packages[(nextPackage - 1) % CPUKernelData::PackagesCount];
+            if (!strcmp((const char*)lastData->m_workID, wp->m_jobID.c_str()))
+                kernelData->m_nonce2 = lastData->m_nonce2;
+            else
+                kernelData->m_nonce2 = rand32();
             U64 n264 = PascalWorkPackage::ComputeNonce2(kernelData->m_nonce2);
             U32 offset = (m_currentWp->m_coinbase1.length() + m_currentWp->m_nonce1.length()) / 2;
             string n2str = toHex(n264);
@@ -379,6 +429,23 @@ U64 RandomHashCPUMiner::GetHashRatePerSec()
                 m_lastHashReading[i] = kHash;
             }
             rate += dt;
+            if (m_nodeHashes.size() > 1)
+                m_nodeHashes[m_cpuKernels[i]->m_node] += dt;
+        }
+
+        //per node speed, to expose cross node penalties
+        if (m_nodeHashes.size() > 1)
+        {
+            U64 now = TimeGetMilliSec();
+            if (m_nodeRateTime && now > m_nodeRateTime)
+            {
+                string str = "Numa nodes speed :";
+                for (U32 n = 0; n < m_nodeHashes.size(); n++)
+                    str += FormatString(" node%u %s", n, HashrateToString(m_nodeHashes[n] * 1000.0f / (now - m_nodeRateTime)));
+                PrintOut("%s\n", str.c_str());
+            }
+            m_nodeRateTime = now;
+            m_nodeHashes.assign(m_nodeHashes.size(), 0);
         }
     }
 
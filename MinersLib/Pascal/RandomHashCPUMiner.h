@@ -19,6 +19,7 @@
 #include "MinersLib/CPUMiner.h"
 #include "MinersLib/Pascal/RandomHash.h"
 RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("cputhrottling", g_cputhrottling, "General", "Slow down mining by internally throttling the cpu. nThis is usefull to prevent virtual computer provider throttling vCpu when mining softwares are detected\nMin-Max are 0 and 99.\nEx. -cputhrottling 12 will throttle the cpu 12% of the time", 0, 99);
+RHMINER_COMMAND_LINE_DECLARE_GLOBAL_INT("lanes", g_cpuLanes, "Optimizations", "Number of RandomHash searches interleaved on each cpu miner thread.\nThis lets the cpu overlap the memory stalls of one search with the work of the others.\nTest it with -testperformance before using it.\nMin-Max are 1 and 4. Default is 1.", 1, RH_CPU_MAX_LANES);
 
 
 class RandomHashCPUMiner: public GenericCLMiner
@@ -65,6 +66,9 @@ protected:
     void PauseCpuKernel();
     void UpdateWorkSize(U32 absoluteVal);
     void RandomHashCpuKernel(CPUKernelData* kernelData); //The Kernel
-    RandomHash_State* m_randomHashArray = 0;
+    std::vector<RandomHash_State*> m_laneStates;   //g_cpuLanes states per kernel, allocated by the kernel's thread on its numa node
+    U32               m_laneStatesCreated = 0;
+    std::vector<U64>  m_nodeHashes;
+    U64               m_nodeRateTime = 0;
 };
 
@@ -122,61 +122,385 @@ void CUDA_SYM_DECL(blake2b_compress)( sph_blake2b_ctx *ctx, int last )
 		ctx->h[i] ^= v[i] ^ v[i + 8];
 }
 
-void CUDA_SYM_DECL(RandomHash_blake2b)(RH_StridePtr roundInput, RH_StridePtr output)
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isSSE4Supported;
+extern bool g_isAVX2Supported;
+
+static const uint8_t RH_ALIGN(64) blake2b_sigma[12][16] = {
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+    { 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+    { 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+    { 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+    { 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+    { 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+    { 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+    { 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+    { 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 }
+};
+
+// SSE4 compression. Each row of the 4x4 work matrix is held in two 128 bit registers
+#define B2B_SSE_ROTR63(x)   _mm_xor_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x))
+
+#define B2B_SSE_G(al, ah, bl, bh, cl, ch, dl, dh, xl, xh) { \
+    al = _mm_add_epi64(_mm_add_epi64(al, bl), xl);          \
+    ah = _mm_add_epi64(_mm_add_epi64(ah, bh), xh);          \
+    dl = _mm_shuffle_epi32(_mm_xor_si128(dl, al), _MM_SHUFFLE(2, 3, 0, 1)); \
+    dh = _mm_shuffle_epi32(_mm_xor_si128(dh, ah), _MM_SHUFFLE(2, 3, 0, 1)); \
+    cl = _mm_add_epi64(cl, dl);                             \
+    ch = _mm_add_epi64(ch, dh);                             \
+    bl = _mm_shuffle_epi8(_mm_xor_si128(bl, cl), r24);      \
+    bh = _mm_shuffle_epi8(_mm_xor_si128(bh, ch), r24); }
+
+#define B2B_SSE_G2(al, ah, bl, bh, cl, ch, dl, dh, yl, yh) { \
+    al = _mm_add_epi64(_mm_add_epi64(al, bl), yl);          \
+    ah = _mm_add_epi64(_mm_add_epi64(ah, bh), yh);          \
+    dl = _mm_shuffle_epi8(_mm_xor_si128(dl, al), r16);      \
+    dh = _mm_shuffle_epi8(_mm_xor_si128(dh, ah), r16);      \
+    cl = _mm_add_epi64(cl, dl);                             \
+    ch = _mm_add_epi64(ch, dh);                             \
+    bl = B2B_SSE_ROTR63(_mm_xor_si128(bl, cl));             \
+    bh = B2B_SSE_ROTR63(_mm_xor_si128(bh, ch)); }
+
+RH_TARGET_ISA("sse4.1") 
+inline void blake2b_compress_SSE4(sph_blake2b_ctx *ctx, int last)
+{
+    const __m128i r16 = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    const __m128i r24 = _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const uint64_t* m = (const uint64_t*)ctx->b;
+
+    __m128i row1l = _mm_loadu_si128((const __m128i*)&ctx->h[0]);
+    __m128i row1h = _mm_loadu_si128((const __m128i*)&ctx->h[2]);
+    __m128i row2l = _mm_loadu_si128((const __m128i*)&ctx->h[4]);
+    __m128i row2h = _mm_loadu_si128((const __m128i*)&ctx->h[6]);
+    __m128i row3l = _mm_load_si128((const __m128i*)&blake2b_iv[0]);
+    __m128i row3h = _mm_load_si128((const __m128i*)&blake2b_iv[2]);
+    __m128i row4l = _mm_xor_si128(_mm_load_si128((const __m128i*)&blake2b_iv[4]), _mm_loadu_si128((const __m128i*)&ctx->t[0]));
+    __m128i row4h = _mm_xor_si128(_mm_load_si128((const __m128i*)&blake2b_iv[6]), _mm_set_epi64x(0, last ? -1 : 0));
+    __m128i t0, t1;
+
+    for (int i = 0; i < 12; i++)
+    {
+        const uint8_t* s = blake2b_sigma[i];
+        //columns
+        B2B_SSE_G(row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h,
+                  _mm_set_epi64x(m[s[2]], m[s[0]]), _mm_set_epi64x(m[s[6]], m[s[4]]));
+        B2B_SSE_G2(row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h,
+                   _mm_set_epi64x(m[s[3]], m[s[1]]), _mm_set_epi64x(m[s[7]], m[s[5]]));
+
+        //diagonalize
+        t0 = _mm_alignr_epi8(row2h, row2l, 8);
+        t1 = _mm_alignr_epi8(row2l, row2h, 8);
+        row2l = t0; 
+        row2h = t1;
+        t0 = row3l; 
+        row3l = row3h; 
+        row3h = t0;
+        t0 = _mm_alignr_epi8(row4h, row4l, 8);
+        t1 = _mm_alignr_epi8(row4l, row4h, 8);
+        row4l = t1; 
+        row4h = t0;
+
+        //diagonals
+        B2B_SSE_G(row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h,
+                  _mm_set_epi64x(m[s[10]], m[s[8]]), _mm_set_epi64x(m[s[14]], m[s[12]]));
+        B2B_SSE_G2(row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h,
+                   _mm_set_epi64x(m[s[11]], m[s[9]]), _mm_set_epi64x(m[s[15]], m[s[13]]));
+
+        //undiagonalize
+        t0 = _mm_alignr_epi8(row2l, row2h, 8);
+        t1 = _mm_alignr_epi8(row2h, row2l, 8);
+        row2l = t0; 
+        row2h = t1;
+        t0 = row3l; 
+        row3l = row3h; 
+        row3h = t0;
+        t0 = _mm_alignr_epi8(row4h, row4l, 8);
+        t1 = _mm_alignr_epi8(row4l, row4h, 8);
+        row4l = t0; 
+        row4h = t1;
+    }
+
+    _mm_storeu_si128((__m128i*)&ctx->h[0], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&ctx->h[0]), _mm_xor_si128(row1l, row3l)));
+    _mm_storeu_si128((__m128i*)&ctx->h[2], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&ctx->h[2]), _mm_xor_si128(row1h, row3h)));
+    _mm_storeu_si128((__m128i*)&ctx->h[4], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&ctx->h[4]), _mm_xor_si128(row2l, row4l)));
+    _mm_storeu_si128((__m128i*)&ctx->h[6], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&ctx->h[6]), _mm_xor_si128(row2h, row4h)));
+}
+
+// AVX2 compression. One 256 bit register per row, diagonals are done with lane permutes
+#define B2B_AVX2_ROTR63(x)   _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x))
+
+#define B2B_AVX2_G(a, b, c, d, x, y) {                                 \
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);                   \
+    d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2, 3, 0, 1)); \
+    c = _mm256_add_epi64(c, d);                                        \
+    b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), r24);              \
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);                   \
+    d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r16);              \
+    c = _mm256_add_epi64(c, d);                                        \
+    b = B2B_AVX2_ROTR63(_mm256_xor_si256(b, c)); }
+
+RH_TARGET_ISA("avx2") 
+inline void blake2b_compress_AVX2(sph_blake2b_ctx *ctx, int last)
+{
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const uint64_t* m = (const uint64_t*)ctx->b;
+    const __m256i h0 = _mm256_loadu_si256((const __m256i*)&ctx->h[0]);
+    const __m256i h1 = _mm256_loadu_si256((const __m256i*)&ctx->h[4]);
+
+    __m256i a = h0;
+    __m256i b = h1;
+    __m256i c = _mm256_load_si256((const __m256i*)&blake2b_iv[0]);
+    __m256i d = _mm256_xor_si256(_mm256_load_si256((const __m256i*)&blake2b_iv[4]), 
+                                 _mm256_set_epi64x(0, last ? -1 : 0, ctx->t[1], ctx->t[0]));
+
+    for (int i = 0; i < 12; i++)
+    {
+        const uint8_t* s = blake2b_sigma[i];
+        B2B_AVX2_G(a, b, c, d,
+                   _mm256_set_epi64x(m[s[6]], m[s[4]], m[s[2]], m[s[0]]),
+                   _mm256_set_epi64x(m[s[7]], m[s[5]], m[s[3]], m[s[1]]));
+
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+
+        B2B_AVX2_G(a, b, c, d,
+                   _mm256_set_epi64x(m[s[14]], m[s[12]], m[s[10]], m[s[8]]),
+                   _mm256_set_epi64x(m[s[15]], m[s[13]], m[s[11]], m[s[9]]));
+
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+    }
+
+    _mm256_storeu_si256((__m256i*)&ctx->h[0], _mm256_xor_si256(h0, _mm256_xor_si256(a, c)));
+    _mm256_storeu_si256((__m256i*)&ctx->h[4], _mm256_xor_si256(h1, _mm256_xor_si256(b, d)));
+}
+
+#define BLAKE2B_COMPRESS(ctx, last) \
+    { \
+        if (g_isAVX2Supported) \
+            blake2b_compress_AVX2(ctx, last); \
+        else if (g_isSSE4Supported) \
+            blake2b_compress_SSE4(ctx, last); \
+        else \
+            _CM(blake2b_compress)(ctx, last); \
+    }
+
+#else
+#define BLAKE2B_COMPRESS(ctx, last) { _CM(blake2b_compress)(ctx, last); }
+#endif //!RANDOMHASH_CUDA
+
+inline void CUDA_SYM_DECL(blake2b_init)(sph_blake2b_ctx* ctx, int outlen)
 {
-    //sph_blake2b_init()
 	size_t i;
-    const int outlen = 64;
-    RH_ALIGN(64) sph_blake2b_ctx ctx;
-    RH_STRIDE_SET_SIZE(output, outlen);
-    
     // state, "param block"		
-    ctx.h[0] = blake2b_iv[0];
-    ctx.h[0] ^= 0x01010000 ^ (0 << 8) ^ outlen;
-    ctx.h[1] = blake2b_iv[1];
-    ctx.h[2] = blake2b_iv[2];
-    ctx.h[3] = blake2b_iv[3];
-    ctx.h[4] = blake2b_iv[4];
-    ctx.h[5] = blake2b_iv[5];
-    ctx.h[6] = blake2b_iv[6];
-    ctx.h[7] = blake2b_iv[7];
-
-	ctx.t[0] = 0;                      // input count low word
-	ctx.t[1] = 0;                      // input count high word
-	ctx.c = 0;                         // pointer within buffer
-	ctx.outlen = outlen;
+    ctx->h[0] = blake2b_iv[0];
+    ctx->h[0] ^= 0x01010000 ^ (0 << 8) ^ outlen;
+    ctx->h[1] = blake2b_iv[1];
+    ctx->h[2] = blake2b_iv[2];
+    ctx->h[3] = blake2b_iv[3];
+    ctx->h[4] = blake2b_iv[4];
+    ctx->h[5] = blake2b_iv[5];
+    ctx->h[6] = blake2b_iv[6];
+    ctx->h[7] = blake2b_iv[7];
+
+	ctx->t[0] = 0;                      // input count low word
+	ctx->t[1] = 0;                      // input count high word
+	ctx->c = 0;                         // pointer within buffer
+	ctx->outlen = outlen;
 
     //TODO: optimiz
 	for (i = 0; i < 128; i++)      // zero input block
-		ctx.b[i] = 0;
-
-    U8* in = RH_STRIDE_GET_DATA(roundInput);
-	for (i = 0; i < RH_STRIDE_GET_SIZE(roundInput); i++) {
-		if (ctx.c == 128) {            // buffer full ?
-			ctx.t[0] += ctx.c;        // add counters
-			if (ctx.t[0] < ctx.c)     // carry overflow ?
-				ctx.t[1]++;            // high word
-			_CM(blake2b_compress)(&ctx, 0);   // compress (not last)
-			ctx.c = 0;                 // counter to zero
+		ctx->b[i] = 0;
+}
+
+//absorb the input then output the hash
+inline void CUDA_SYM_DECL(blake2b_update_final)(sph_blake2b_ctx* ctx, const U8* in, size_t inlen, U8* out)
+{
+	size_t i;
+	for (i = 0; i < inlen; i++) {
+		if (ctx->c == 128) {            // buffer full ?
+			ctx->t[0] += ctx->c;        // add counters
+			if (ctx->t[0] < ctx->c)     // carry overflow ?
+				ctx->t[1]++;            // high word
+			BLAKE2B_COMPRESS(ctx, 0);   // compress (not last)
+			ctx->c = 0;                 // counter to zero
 		}
         
         //TODO: optimiz
-		ctx.b[ctx.c++] = ((const uint8_t *) in)[i];
+		ctx->b[ctx->c++] = ((const uint8_t *) in)[i];
 	}
 
-	ctx.t[0] += ctx.c;                // mark last block offset
-	if (ctx.t[0] < ctx.c)             // carry overflow
-		ctx.t[1]++;                    // high word
+	ctx->t[0] += ctx->c;                // mark last block offset
+	if (ctx->t[0] < ctx->c)             // carry overflow
+		ctx->t[1]++;                    // high word
 
-	while (ctx.c < 128)                // fill up with zeros
-		ctx.b[ctx.c++] = 0;
-	_CM(blake2b_compress)(&ctx, 1);           // final block flag = 1
+	while (ctx->c < 128)                // fill up with zeros
+		ctx->b[ctx->c++] = 0;
+	BLAKE2B_COMPRESS(ctx, 1);           // final block flag = 1
 
 	// little endian convert and store
-    U8* out = RH_STRIDE_GET_DATA(output);
-	for (i = 0; i < ctx.outlen; i++) {
+	for (i = 0; i < ctx->outlen; i++) {
 		((uint8_t *) out)[i] =
-			(ctx.h[i >> 3] >> (8 * (i & 7))) & 0xFF;
+			(ctx->h[i >> 3] >> (8 * (i & 7))) & 0xFF;
 	}
+}
+
+void CUDA_SYM_DECL(RandomHash_blake2b)(RH_StridePtr roundInput, RH_StridePtr output)
+{
+    //sph_blake2b_init()
+    const int outlen = 64;
+    RH_ALIGN(64) sph_blake2b_ctx ctx;
+    RH_STRIDE_SET_SIZE(output, outlen);
+    _CM(blake2b_init)(&ctx, outlen);
+    _CM(blake2b_update_final)(&ctx, RH_STRIDE_GET_DATA(roundInput), RH_STRIDE_GET_SIZE(roundInput), RH_STRIDE_GET_DATA(output));
+}
+
+
+#if !defined(RANDOMHASH_CUDA)
+//Round 1 header midstate. More bytes follow the blocks before the nonce, so they are compressed right away, 
+//like blake2b_update_final does when the next byte comes in
+inline void RandomHash_blake2b_HeaderPrefix(const uint8_t* header, uint8_t* midstate)
+{
+    static_assert(sizeof(sph_blake2b_ctx) <= RH_HEADER_MIDSTATE_SIZE, "blake2b midstate too large");
+    sph_blake2b_ctx* ctx = (sph_blake2b_ctx*)midstate;
+    blake2b_init(ctx, 64);
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(128); b += 128)
+    {
+        memcpy(ctx->b, header + b, 128);
+        ctx->t[0] += 128;
+        BLAKE2B_COMPRESS(ctx, 0);
+    }
+}
 
+inline void RandomHash_blake2b_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output)
+{
+    const uint32_t prefix = PascalHeaderPrefixSize(128);
+    RH_ALIGN(64) sph_blake2b_ctx ctx;
+    memcpy(&ctx, midstate, sizeof(ctx));
+    RH_STRIDE_SET_SIZE(output, 64);
+    blake2b_update_final(&ctx, RH_STRIDE_GET_DATA(roundInput) + prefix, RH_STRIDE_GET_SIZE(roundInput) - prefix, RH_STRIDE_GET_DATA(output));
+}
+#endif //!RANDOMHASH_CUDA
+
+#if !defined(RANDOMHASH_CUDA)
+//4 independent messages, one message per 64 bit lane. Inputs are not modified
+RH_TARGET_ISA("avx2") 
+inline void RandomHash_blake2b_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    const int outlen = 64;
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    RH_ALIGN(64) uint64_t lastBlock[4][16];
+    RH_ALIGN(32) uint64_t result[8][4];
+    const uint64_t* dataPtr[4];
+    uint32_t len[4];
+    uint32_t blockCount[4];
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 4; i++)
+    {
+        RH_memzero_of16(lastBlock[i], sizeof(lastBlock[i]));
+        if (i < count)
+        {
+            len[i] = RH_STRIDE_GET_SIZE(inputs[i]);
+            dataPtr[i] = (const uint64_t*)RH_STRIDE_GET_DATA(inputs[i]);
+            blockCount[i] = len[i] ? (len[i] + 127) / 128 : 1;
+            uint32_t lastOffset = (blockCount[i] - 1) * 128;
+            memcpy(lastBlock[i], ((const uint8_t*)dataPtr[i]) + lastOffset, len[i] - lastOffset);
+        }
+        else
+        {
+            len[i] = 0;
+            dataPtr[i] = lastBlock[i];
+            blockCount[i] = 0;
+        }
+        if (blockCount[i] > maxBlocks)
+            maxBlocks = blockCount[i];
+    }
+
+    __m256i h[8];
+    h[0] = _mm256_set1_epi64x(blake2b_iv[0] ^ (0x01010000 ^ outlen));
+    for (U32 w = 1; w < 8; w++)
+        h[w] = _mm256_set1_epi64x(blake2b_iv[w]);
+
+    for (uint32_t b = 0; b < maxBlocks; b++)
+    {
+        const uint64_t* m[4];
+        RH_ALIGN(32) uint64_t t[4];
+        RH_ALIGN(32) uint64_t lastMask[4];
+        RH_ALIGN(32) uint64_t activeMask[4];
+        for (U32 i = 0; i < 4; i++)
+        {
+            bool isLast = (b + 1 == blockCount[i]);
+            m[i] = isLast || b >= blockCount[i] ? lastBlock[i] : dataPtr[i] + b * 16;
+            t[i] = isLast ? len[i] : (b + 1) * 128;
+            lastMask[i] = isLast ? U64_Max : 0;
+            activeMask[i] = b < blockCount[i] ? U64_Max : 0;
+        }
+
+        __m256i M[16];
+        for (U32 w = 0; w < 16; w++)
+            M[w] = _mm256_set_epi64x(m[3][w], m[2][w], m[1][w], m[0][w]);
+
+        __m256i v[16];
+        for (U32 w = 0; w < 8; w++)
+        {
+            v[w] = h[w];
+            v[w + 8] = _mm256_set1_epi64x(blake2b_iv[w]);
+        }
+        v[12] = _mm256_xor_si256(v[12], _mm256_load_si256((const __m256i*)t));
+        v[14] = _mm256_xor_si256(v[14], _mm256_load_si256((const __m256i*)lastMask));
+
+        for (int i = 0; i < 12; i++)
+        {
+            const uint8_t* s = blake2b_sigma[i];
+            B2B_AVX2_G(v[0], v[4], v[8],  v[12], M[s[0]],  M[s[1]]);
+            B2B_AVX2_G(v[1], v[5], v[9],  v[13], M[s[2]],  M[s[3]]);
+            B2B_AVX2_G(v[2], v[6], v[10], v[14], M[s[4]],  M[s[5]]);
+            B2B_AVX2_G(v[3], v[7], v[11], v[15], M[s[6]],  M[s[7]]);
+            B2B_AVX2_G(v[0], v[5], v[10], v[15], M[s[8]],  M[s[9]]);
+            B2B_AVX2_G(v[1], v[6], v[11], v[12], M[s[10]], M[s[11]]);
+            B2B_AVX2_G(v[2], v[7], v[8],  v[13], M[s[12]], M[s[13]]);
+            B2B_AVX2_G(v[3], v[4], v[9],  v[14], M[s[14]], M[s[15]]);
+        }
+
+        const __m256i active = _mm256_load_si256((const __m256i*)activeMask);
+        for (U32 w = 0; w < 8; w++)
+            h[w] = _mm256_blendv_epi8(h[w], _mm256_xor_si256(h[w], _mm256_xor_si256(v[w], v[w + 8])), active);
+    }
+
+    for (U32 w = 0; w < 8; w++)
+        _mm256_store_si256((__m256i*)result[w], h[w]);
+
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(outputs[i], outlen);
+        uint64_t* out = (uint64_t*)RH_STRIDE_GET_DATA(outputs[i]);
+        for (U32 w = 0; w < 8; w++)
+            out[w] = result[w][i];
+    }
+}
+
+inline void RandomHash_blake2b_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 4)
+            RandomHash_blake2b_AVX2x4(inputs + i, outputs + i, RH_Min(count - i, 4U));
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            RandomHash_blake2b(inputs[i], outputs[i]);
+    }
 }
+#endif //!RANDOMHASH_CUDA
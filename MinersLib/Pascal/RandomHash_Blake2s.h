@@ -183,11 +183,8 @@ int CUDA_SYM_DECL(blake2s_final_SSE2)( blake2s_state *S, uint8_t *out, uint8_t o
 }
 
 
-void CUDA_SYM_DECL(RandomHash_blake2s)(RH_StridePtr roundInput, RH_StridePtr output)
+inline void CUDA_SYM_DECL(blake2s_init_SSE2)(blake2s_state* S)
 {
-    uint32_t *in = (uint32_t*)RH_STRIDE_GET_DATA(roundInput);
-
-    RH_ALIGN(64) blake2s_state S;
 	RH_ALIGN(64) blake2s_param P[1];
     const int outlen = BLAKE2S_OUTBYTES;
 	/* Move interval verification here? */
@@ -215,17 +212,52 @@ void CUDA_SYM_DECL(RandomHash_blake2s)(RH_StridePtr roundInput, RH_StridePtr out
     memset(P->personal, 0, sizeof( P->personal ) );
 #endif
 
-    RH_memzero_of16(&S, sizeof( blake2s_state ) );    
+    RH_memzero_of16(S, sizeof( blake2s_state ) );    
 
-	for( int i = 0; i < 8; ++i ) S.h[i] = blake2s_IV[i];
+	for( int i = 0; i < 8; ++i ) S->h[i] = blake2s_IV[i];
 
 	uint32_t *p = ( uint32_t * )( P );
 
 	/* IV XOR ParamBlock */
 	for( size_t i = 0; i < 8; ++i )
-		S.h[i] ^= load32_SSE2( &p[i] );
+		S->h[i] ^= load32_SSE2( &p[i] );
+}
+
+void CUDA_SYM_DECL(RandomHash_blake2s)(RH_StridePtr roundInput, RH_StridePtr output)
+{
+    uint32_t *in = (uint32_t*)RH_STRIDE_GET_DATA(roundInput);
+
+    RH_ALIGN(64) blake2s_state S;
+    _CM(blake2s_init_SSE2)(&S);
     
 	_CM(blake2s_update_SSE2)( &S, ( uint8_t * )in, RH_STRIDE_GET_SIZE(roundInput) );
 	_CM(blake2s_final_SSE2)( &S, RH_STRIDE_GET_DATA(output), BLAKE2S_OUTBYTES );
     RH_STRIDE_SET_SIZE(output, BLAKE2S_OUTBYTES)
 }
+
+
+#if !defined(RANDOMHASH_CUDA)
+//Round 1 header midstate. More bytes follow the blocks before the nonce, so they are compressed right away, 
+//like blake2s_update_SSE2 does once its buffer overflows
+inline void RandomHash_blake2s_HeaderPrefix(const uint8_t* header, uint8_t* midstate)
+{
+    static_assert(sizeof(blake2s_state) <= RH_HEADER_MIDSTATE_SIZE, "blake2s midstate too large");
+    blake2s_state* S = (blake2s_state*)midstate;
+    blake2s_init_SSE2(S);
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(BLAKE2S_BLOCKBYTES); b += BLAKE2S_BLOCKBYTES)
+    {
+        blake2s_increment_counter(S, BLAKE2S_BLOCKBYTES);
+        blake2s_compress_SSE2(S, header + b);
+    }
+}
+
+inline void RandomHash_blake2s_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output)
+{
+    const uint32_t prefix = PascalHeaderPrefixSize(BLAKE2S_BLOCKBYTES);
+    RH_ALIGN(64) blake2s_state S;
+    memcpy(&S, midstate, sizeof(S));
+    blake2s_update_SSE2(&S, RH_STRIDE_GET_DATA(roundInput) + prefix, RH_STRIDE_GET_SIZE(roundInput) - prefix);
+    blake2s_final_SSE2(&S, RH_STRIDE_GET_DATA(output), BLAKE2S_OUTBYTES);
+    RH_STRIDE_SET_SIZE(output, BLAKE2S_OUTBYTES)
+}
+#endif //!RANDOMHASH_CUDA
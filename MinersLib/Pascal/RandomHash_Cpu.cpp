@@ -38,6 +38,12 @@
 extern bool g_isSSE3Supported;
 extern bool g_isSSE4Supported;
 extern bool g_isAVX2Supported;
+extern bool g_isSHASupported;
+extern bool g_isAVX512Supported;
+extern int  g_sseOptimization;
+extern int  g_hugePages;
+extern int  g_lockPages;
+extern int  g_cpuAbandon;
 
 
 
@@ -54,6 +60,17 @@ static thread_local U64                 c_target = 0xFFFFFFFFFFFFFFFF;
 #define GetParentRoundOutputCount(n)    c_round_parenAndNeighbortOutputsCounts[n]
 #define GetDeviceID()                   0
 
+//The round functions below are instanced per round, so their round tests, output counts and expansion sizes are constants
+template <int Round>
+struct RH_Round
+{
+    static_assert(Round >= 1 && Round <= RH_N, "Invalid RandomHash round");
+    static const bool IsLast = Round == RH_N;
+    static const U32  OutputCount = (1 << Round) - 1;
+    static const U32  ParentOutputCount = (1 << (Round - 1)) - 1;
+    static const U32  ExpansionSize = (RH_N - Round) * RH_M;
+};
+
 CUDA_DECL_HOST_AND_DEVICE
 inline RH_StridePtr CUDA_SYM(RH_StrideArrayGet)(RH_StridePtrArray strideArrayVar, int idx) 
 {
@@ -62,6 +79,12 @@ inline RH_StridePtr CUDA_SYM(RH_StrideArrayGet)(RH_StridePtrArray strideArrayVar
 }
 
 
+//Every stride of the tree is live until the last compress, round r has 2^(5-r) strides of a hash output (64 bytes at most)
+//expanded 5-r times. The midstate reuse starts the next half tree up to 2 pages past the cached half, that has the round 5 output too.
+#define RH_STRIDE_ALLOC_SIZE(round)     RHMINER_ALIGN(RH_IDEAL_ALIGNMENT + 64 + (RH_N - (round)) * RH_M, 32)
+static_assert(16 * RH_STRIDE_ALLOC_SIZE(1) + 8 * RH_STRIDE_ALLOC_SIZE(2) + 4 * RH_STRIDE_ALLOC_SIZE(3) + 2 * RH_STRIDE_ALLOC_SIZE(4) + 
+              2 * RH_STRIDE_ALLOC_SIZE(5) + 2 * 4096 <= RH_STRIDE_BANK_SIZE, "The stride bank is too small for the largest tree");
+
 CUDA_DECL_HOST_AND_DEVICE
 inline RH_StridePtr CUDA_SYM(RH_StrideArrayAllocOutput)(RandomHash_State* state, U32 initialSize) 
 {
@@ -125,6 +148,8 @@ inline void CUDA_SYM(RH_StrideArrayClose)(RandomHash_State* state, RH_StridePtr
     state->m_stridesAllocIndex = RHMINER_ALIGN(state->m_stridesAllocIndex + ss, 32);
     RH_ASSERT(state->m_stridesAllocIndex < RH_STRIDE_BANK_SIZE);
     RH_ASSERT((size_t(state->m_stridesAllocIndex) % 32) == 0);
+    if (state->m_stridesAllocIndex > state->m_stridesAllocPeak)
+        state->m_stridesAllocPeak = state->m_stridesAllocIndex;
 
     RH_STRIDE_CHECK_INTEGRITY(stride);
 }
@@ -142,11 +167,75 @@ inline void CUDA_SYM(RH_StrideArrayReset)(RH_StridePtrArray strideArrayVar)
     static_assert(sizeof(void*) == sizeof(U64), "Incorrect ptr size");
 }
 
+//Kernel dispatch table. Every slot is set once at startup by RandomHash_InitKernelTable, from the cpu features, 
+//so one binary runs the best kernels of any x86-64 cpu without testing the isa in the hot loops.
+typedef void (*RH_TransfoFunc)(U8* nextChunk, U32 size, U8* source);
+typedef void (*RH_MurmurUpdateFunc)(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray);
+struct RH_MurmurStream;
+typedef void (*RH_MurmurStreamsFunc)(RH_MurmurStream* streams, U32 count);
+typedef void (*RH_HashBatchFunc)(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count);
+
+struct RH_KernelTable
+{
+    RH_TransfoFunc      transfo[8];
+    RH_MurmurUpdateFunc murmurUpdate;
+    RH_MurmurStreamsFunc murmurStreams;
+    RH_HashBatchFunc    hashBatch[RH_ALGO_COUNT];
+};
+static RH_KernelTable g_RH_Kernels;
+
+//Round 1 header midstates, by algorithm. The prefix hashes the blocks before the nonce once per header and the 
+//resume hashes the rest of the header from there. None for SHA3, Snefru, Grindahl and RadioGatun
+typedef void (*RH_HeaderPrefixFunc)(const U8* header, U8* midstate);
+typedef void (*RH_HeaderResumeFunc)(const U8* midstate, RH_StridePtr roundInput, RH_StridePtr output);
+struct RH_HeaderMidstateKernel
+{
+    RH_HeaderPrefixFunc prefix;
+    RH_HeaderResumeFunc resume;
+};
+
+static const RH_HeaderMidstateKernel c_RH_HeaderMidstates[RH_ALGO_COUNT] =
+{
+    { RandomHash_SHA2_256_HeaderPrefix,         RandomHash_SHA2_256_FromMidstate },
+    { RandomHash_SHA2_384_HeaderPrefix,         RandomHash_SHA2_384_FromMidstate },
+    { RandomHash_SHA2_512_HeaderPrefix,         RandomHash_SHA2_512_FromMidstate },
+    { 0, 0 },
+    { 0, 0 },
+    { 0, 0 },
+    { RH_MD_HeaderPrefix<RH_RIPEMD160_X8>,      RH_MD_FromMidstate<RH_RIPEMD160_X8> },
+    { RH_MD_HeaderPrefix<RH_RIPEMD256_X8>,      RH_MD_FromMidstate<RH_RIPEMD256_X8> },
+    { RH_MD_HeaderPrefix<RH_RIPEMD320_X8>,      RH_MD_FromMidstate<RH_RIPEMD320_X8> },
+    { RandomHash_blake2b_HeaderPrefix,          RandomHash_blake2b_FromMidstate },
+    { RandomHash_blake2s_HeaderPrefix,          RandomHash_blake2s_FromMidstate },
+    { RandomHash_Tiger2_5_192_HeaderPrefix,     RandomHash_Tiger2_5_192_FromMidstate },
+    { 0, 0 },
+    { 0, 0 },
+    { RH_MD_HeaderPrefix<RH_Haval_5_256_X8>,    RH_MD_FromMidstate<RH_Haval_5_256_X8> },
+    { RH_MD_HeaderPrefix<RH_MD5_X8>,            RH_MD_FromMidstate<RH_MD5_X8> },
+    { 0, 0 },
+    { RandomHash_WhirlPool_HeaderPrefix,        RandomHash_WhirlPool_FromMidstate },
+};
+
 #include "MinersLib/Pascal/RandomHash_inl.h"
+#include "MinersLib/Pascal/RandomHash_Transfo_AVX.h"
 
 inline CUDA_DECL_HOST_AND_DEVICE U32 CUDA_SYM(GetNextRnd)(mersenne_twister_state* gen) 
 {    
+#ifdef RH_ENABLE_MT_LAZY_SEED
+    return _CM(merssen_twister_rand_lazy)(gen);
+#else
     return _CM(merssen_twister_rand)(gen);
+#endif
+}
+
+inline CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(GetNextRnds)(mersenne_twister_state* gen, U32* out, U32 count) 
+{    
+#ifdef RH_ENABLE_MT_LAZY_SEED
+    _CM(merssen_twister_rand_many_lazy)(gen, out, count);
+#else
+    for (U32 i = 0; i < count; i++)
+        out[i] = _CM(merssen_twister_rand)(gen);
+#endif
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -177,6 +266,8 @@ inline void CUDA_DECL_HOST_AND_DEVICE CUDA_SYM(RandomHash_Initialize)(RandomHash
 
     RH_ASSERT(RH_WorkSize == RH_StrideSize);
     state->m_strideID = 0;
+    for (U32 r = 0; r <= RH_N; r++)
+        state->m_roundBytes[r] = 0;
     RH_STRIDEARRAY_RESET(state->m_round5Phase2PrecalcArray);
     
     if (state->m_isCachedOutputs)
@@ -242,7 +333,7 @@ void CUDA_SYM(RandomHash_Destroy)(RandomHash_State* state)
     _CM(RandomHash_RoundDataUnInit)(&state->m_data[5], 5);
    
     state->m_isCachedOutputs = false;
-    _CM(RandomHash_Free)(state->m_stridesInstances);
+    RH_SysFreeLarge(state->m_stridesInstances);
 }
 
 void CUDA_SYM(RandomHash_DestroyMany)(RandomHash_State* stateArray, U32 count)
@@ -292,7 +383,10 @@ void CUDA_SYM(RandomHash_Create)(RandomHash_State* state)
     ajust = sizeof(U64);
 #endif    
 
-    _CM(RandomHash_Alloc)((void**)&state->m_stridesInstances, RH_STRIDE_BANK_SIZE + ajust);
+    bool locked;
+    state->m_stridesInstances = (U8*)RH_SysAllocLarge(RH_STRIDE_BANK_SIZE + ajust, g_hugePages != 0, g_lockPages != 0, state->m_stridesPages, locked);
+    RHMINER_ASSERT(state->m_stridesInstances);
+    state->m_stridesLocked = locked;
     
 #ifdef RHMINER_DEBUG_STRIDE_INTEGRITY_CHECK
     U64* check = (U64*)(state->m_stridesInstances + RH_STRIDE_BANK_SIZE);
@@ -323,6 +417,19 @@ void CUDA_SYM(RandomHash_Create)(RandomHash_State* state)
     state->m_data[3].first_round_consume = false;
     state->m_data[4].first_round_consume = false;
     state->m_data[5].first_round_consume = false;
+    state->m_midStateHits = 0;
+    state->m_fullTreeCount = 0;
+    state->m_stridesAllocPeak = 0;
+    for (U32 r = 0; r <= RH_N; r++)
+        state->m_roundBytesPeak[r] = 0;
+    state->m_abandoned = false;
+    state->m_abandonedCount = 0;
+    for (U32 k = 0; k < 2; k++)
+    {
+        for (U32 c = 0; c < RH_ABANDON_CHECKPOINTS; c++)
+            state->m_abandonBudget[k][c] = U64_Max;
+        state->m_abandonSampleCount[k] = 0;
+    }
 
     _CM(RandomHash_Initialize)(state);
 }
@@ -339,6 +446,25 @@ void CUDA_SYM(RandomHash_CreateMany)(RandomHash_State** outPtr, U32 count)
 
 } 
 
+void RandomHash_LogStrideBanks(RandomHash_State* const* stateArrays, U32 arrayCount, U32 statesPerArray)
+{
+    if (!g_hugePages && !g_lockPages)
+        return;
+
+    U32 pages[3] = { 0 };
+    U32 locked = 0;
+    for (U32 a = 0; a < arrayCount; a++)
+    {
+        for (U32 i = 0; i < statesPerArray; i++)
+        {
+            pages[stateArrays[a][i].m_stridesPages]++;
+            locked += stateArrays[a][i].m_stridesLocked;
+        }
+    }
+    PrintOut("Stride banks of %u KB : %u on 2 MB pages, %u on transparent huge pages, %u on 4 KB pages. %u locked\n", 
+             RH_STRIDE_BANK_SIZE / 1024, pages[RH_PAGES_HUGE], pages[RH_PAGES_THP], pages[RH_PAGES_NORMAL], locked);
+}
+
 void CUDA_SYM(RandomHash_RoundDataUnInit)(RH_RoundData* rd, int round)
 {
     _CM(RandomHash_Free)(rd->roundOutputs);
@@ -366,7 +492,11 @@ void CUDA_SYM(RandomHash_SetHeader)(RandomHash_State* state, U8* sourceHeader, U
 
 inline void CUDA_SYM_DECL(RandomHash_Reseed)(mersenne_twister_state& rndGen, U32 seed) 
 {
+#ifdef RH_ENABLE_MT_LAZY_SEED
+    _CM(merssen_twister_seed_lazy)(seed, &rndGen);
+#else
     _CM(merssen_twister_seed)(seed, &rndGen);
+#endif
 }
 
 
@@ -392,12 +522,14 @@ U32 CUDA_SYM_DECL(RandomHash_ChecksumArray)(RH_StridePtrArray inputs)
 	return csum;
 }
 
-void CUDA_SYM_DECL(RandomHash_Expand)(RandomHash_State* state, RH_StridePtr input, int round, int ExpansionFactor, U8* strideArray)
+//With accumulator arrays, the output is folded in their accumulators chunk by chunk as it is produced
+template <U32 ExpansionSize>
+void CUDA_SYM_DECL(RandomHash_Expand)(RandomHash_State* state, RH_StridePtr input, U8* strideArray, U8* r5p2AccumArray)
 {
     U32 inputSize = RH_STRIDE_GET_SIZE(input);
     U32 seed = _CM(RandomHash_Checksum)(input);
     _CM(RandomHash_Reseed)(state->m_rndGenExpand, seed);
-    size_t sizeExp = inputSize + ExpansionFactor * RH_M;
+    size_t sizeExp = inputSize + ExpansionSize;
 
     RH_StridePtr output = input;
 
@@ -407,6 +539,12 @@ void CUDA_SYM_DECL(RandomHash_Expand)(RandomHash_State* state, RH_StridePtr inpu
     RH_ASSERT(RH_STRIDE_GET_SIZE(output) < RH_StrideSize);
 
     U8* outputPtr = RH_STRIDE_GET_DATA(output);
+#ifdef RH_ENABLE_OPTIM_STRIDE_ARRAY_MURMUR3
+    MurmurHash3_x86_32_State* accum1 = strideArray ? RH_StrideArrayStruct_GetAccum(strideArray) : 0;
+    MurmurHash3_x86_32_State* accum2 = strideArray ? RH_StrideArrayStruct_GetAccum(r5p2AccumArray) : 0;
+    if (accum1)
+        _CM(RH_Murmur3Update_2)(outputPtr, inputSize, accum1, accum2);
+#endif
     while (bytesToAdd > 0)
     {
         U32 nextChunkSize = RH_STRIDE_GET_SIZE(output);
@@ -422,70 +560,11 @@ void CUDA_SYM_DECL(RandomHash_Expand)(RandomHash_State* state, RH_StridePtr inpu
         U32 random = _CM(GetNextRnd)(&state->m_rndGenExpand);
         U32 r = random % 8;
         RH_ASSERT((nextChunkSize & 1) == 0);
-        switch(r)
-        {
-            case 0: 
-#if defined(RHMINER_ENABLE_SSE4) && defined(RH_ENABLE_AVX)
-                    if (nextChunkSize <= 512 && (g_sseOptimization == 2))
-                    {
-                        extern void Transfo0_2_AVX(U8* nextChunk, U32 size, U8* source);
-                        Transfo0_2_AVX(nextChunk, nextChunkSize, outputPtr);
-                    }
-                    else
-#endif
-                    if (nextChunkSize <= 128 && (size_t(nextChunk) & 0x0f) == 0)
-                    {
-#if defined(RHMINER_ENABLE_SSE4)
-    #if defined(RHMINER_COND_SSE4)
-                        if (g_isSSE4Supported)
-                            _CM(Transfo0_2_128_SSE4)(nextChunk, nextChunkSize,  outputPtr);
-                        else if (g_isSSE3Supported)
-                            _CM(Transfo0_2_128_SSE3)(nextChunk, nextChunkSize,  outputPtr);
-                        else
-                            _CM(Transfo0_2)(nextChunk, nextChunkSize,  outputPtr); 
-    #else
-                        _CM(Transfo0_2_128_SSE4)(nextChunk, nextChunkSize,  outputPtr);
-                            
-    #endif //defined(RHMINER_COND_SSE4)
-#else
-                        if (g_isSSE3Supported)
-                            _CM(Transfo0_2_128_SSE3)(nextChunk, nextChunkSize,  outputPtr);
-                        else
-                            _CM(Transfo0_2)(nextChunk, nextChunkSize,  outputPtr); 
-#endif
-                    }
-                    else
-                        _CM(Transfo0_2)(nextChunk, nextChunkSize,  outputPtr); 
-                    break;
-                    
-            case 1: _CM(Transfo1_2)(nextChunk, nextChunkSize,  outputPtr); break;
-            case 2: _CM(Transfo2_2)(nextChunk, nextChunkSize,  outputPtr); break;
-            case 3: _CM(Transfo3_2)(nextChunk, nextChunkSize,  outputPtr); break;
-            case 4: 
-            {
-#if defined(RHMINER_ENABLE_SSE4)
-    #if defined(RH_ENABLE_AVX)
-                if (g_sseOptimization == 2 && nextChunkSize > 32)
-                {
-                    extern void Transfo4_2_AVX(U8* nextChunk, U32 size, U8* outputPtr);
-                    Transfo4_2_AVX(nextChunk, nextChunkSize, outputPtr);
-                }
-                else
-    #endif //defined(RH_ENABLE_AVX)
-#if 0
-                if (nextChunkSize <= 128 && (size_t(nextChunk) & 0x0f) && g_isSSE4Supported)
-                {
-                    _CM(Transfo4_2_128_SSE4)(nextChunk, nextChunkSize, outputPtr);
-                }
-                else
+        g_RH_Kernels.transfo[r](nextChunk, nextChunkSize, outputPtr);
+#ifdef RH_ENABLE_OPTIM_STRIDE_ARRAY_MURMUR3
+        if (accum1)
+            _CM(RH_Murmur3Update_2)(nextChunk, nextChunkSize, accum1, accum2);
 #endif
-#endif //#if defined(RHMINER_ENABLE_SSE4)
-                    _CM(Transfo4_2)(nextChunk, nextChunkSize, outputPtr);
-            }break;
-            case 5: _CM(Transfo5_2)(nextChunk, nextChunkSize,  outputPtr); break; 
-            case 6: _CM(Transfo6_2)(nextChunk, nextChunkSize,  outputPtr); break;
-            case 7: _CM(Transfo7_2)(nextChunk, nextChunkSize,  outputPtr); break;
-        }
 
         RH_STRIDE_CHECK_INTEGRITY(output);
         RH_ASSERT(RH_STRIDE_GET_SIZE(output) < RH_StrideSize);
@@ -513,14 +592,23 @@ void CUDA_SYM_DECL(RandomHash_Compress)(RandomHash_State* state, RH_StridePtrArr
     U8* resultPtr = RH_STRIDE_GET_DATA(Result);
     U32 inoutSize = RH_STRIDEARRAY_GET_SIZE(inputs);
 
+    //The 200 draws only depend on the seed. All the byte addresses are computed and prefetched first,
+    //so the cache misses in the strides overlap instead of waiting on the generator one by one
+    RH_ALIGN(64) U32 rnd[200];
+    const U8* sources[100];
+    _CM(GetNextRnds)(&state->m_rndGenCompress, rnd, 200);
     for (size_t i = 0; i < 100; i++)
     {
-        RH_StridePtr source = RH_STRIDEARRAY_GET(inputs, _CM(GetNextRnd)(&state->m_rndGenCompress) % inoutSize);
+        RH_StridePtr source = RH_STRIDEARRAY_GET(inputs, rnd[i * 2] % inoutSize);
         U32 sourceSize = RH_STRIDE_GET_SIZE(source);
 
-        rval = _CM(GetNextRnd)(&state->m_rndGenCompress);
-        resultPtr[i] = RH_STRIDE_GET_DATA(source)[rval % sourceSize];
+        rval = rnd[i * 2 + 1];
+        sources[i] = RH_STRIDE_GET_DATA(source) + rval % sourceSize;
+        RH_PREFETCH_MEM(sources[i]);
     }
+
+    for (size_t i = 0; i < 100; i++)
+        resultPtr[i] = *sources[i];
 } 
 
 inline void CUDA_SYM_DECL(RandomHash_MiddlePoint)(RandomHash_State* state)
@@ -537,17 +625,25 @@ inline void CUDA_SYM_DECL(RandomHash_MiddlePoint)(RandomHash_State* state)
 
 }
 
-inline void CUDA_SYM_DECL(RandomHash_start)(RandomHash_State* state, U32 in_round)
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_start)(RandomHash_State* state)
 {
-    RH_ASSERT(in_round >= 1 && in_round <= RH_N);
     RH_ASSERT(RH_STRIDE_GET_SIZE(state->m_roundInput) <= PascalHeaderSize);
+#if !defined(RANDOMHASH_CUDA)
+    //only the nonce is left to add to the checksum of the header
+    MurmurHash3_x86_32_State accum = state->m_headerMurmur;
+    _CM(MurmurHash3_x86_32_Update)(RH_STRIDE_GET_DATA(state->m_roundInput) + PascalHeaderNoncePosV4(PascalHeaderSize), 4, &accum);
+    U32 seed = _CM(MurmurHash3_x86_32_Finalize)(&accum);
+#else
     U32 seed = _CM(RandomHash_Checksum)(state->m_roundInput);
+#endif
     _CM(RandomHash_Reseed)(state->m_data[in_round].rndGen, seed);
 }
 
-inline void CUDA_SYM_DECL(RandomHash_Phase_1_push)(RandomHash_State* state, int in_round)
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_Phase_1_push)(RandomHash_State* state)
 {
-    if (in_round == RH_N)
+    if (RH_Round<in_round>::IsLast)
     {
         if (in_round == 5)
         {
@@ -560,18 +656,20 @@ inline void CUDA_SYM_DECL(RandomHash_Phase_1_push)(RandomHash_State* state, int
     }
 
     state->m_data[in_round-1].backup_io_results = state->m_data[in_round-1].io_results;
+    state->m_data[in_round-1].foldExpand = 1;
     
-    if (in_round == RH_N)
+    if (RH_Round<in_round>::IsLast)
         state->m_data[in_round - 1].io_results = state->m_data[RH_N].parenAndNeighbortOutputs;
     else
         state->m_data[in_round - 1].io_results = state->m_data[in_round].parenAndNeighbortOutputs;
 }
 
-inline void CUDA_SYM_DECL(RandomHash_Phase_1_pop)(RandomHash_State* state, int in_round)
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_Phase_1_pop)(RandomHash_State* state)
 {
     RH_StridePtrArray pano;
     bool skipLastUpdate = false;
-    if (in_round == RH_N)
+    if (RH_Round<in_round>::IsLast)
     {    
         if (state->m_skipPhase1)
         {
@@ -598,6 +696,7 @@ inline void CUDA_SYM_DECL(RandomHash_Phase_1_pop)(RandomHash_State* state, int i
 
     {
 
+        //the cached pano comes from a phase 2 expand, that did not fold its last stride
         if (skipLastUpdate)
         {
             _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3)(pano, RH_STRIDEARRAY_GET_SIZE(pano) - 1); 
@@ -606,7 +705,8 @@ inline void CUDA_SYM_DECL(RandomHash_Phase_1_pop)(RandomHash_State* state, int i
         }
         else
         {
-            _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_DUO)(pano, RH_STRIDEARRAY_GET_SIZE(pano) - 1, state->m_round5Phase2PrecalcArray);
+            //the last stride, the expanded output of the child round, is already in both accumulators. See RandomHash_end
+            RH_STRIDEARRAY_PUSHBACK(state->m_round5Phase2PrecalcArray, RH_STRIDEARRAY_GET(pano, RH_STRIDEARRAY_GET_SIZE(pano) - 1));
         }
     }
 
@@ -622,30 +722,35 @@ inline void CUDA_SYM_DECL(RandomHash_Phase_1_pop)(RandomHash_State* state, int i
     RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) == 0);
     RH_STRIDEARRAY_PUSHBACK_MANY_ALL(state->m_data[in_round].roundOutputs, pano); 
 
-    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(pano) <= GetParentRoundOutputCount(in_round));
-    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= GetRoundOutputCount(in_round));
+    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(pano) <= RH_Round<in_round>::ParentOutputCount);
+    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= RH_Round<in_round>::OutputCount);
    
     RH_STRIDEARRAY_RESET(pano);
 }
 
-inline void CUDA_SYM_DECL(RandomHash_Phase_2_push)(RandomHash_State* state, int in_round)
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_Phase_2_push)(RandomHash_State* state)
 {
     U32 newNonce = _CM(GetNextRnd)(&state->m_data[in_round].rndGen);
     *(U32*)(RH_STRIDE_GET_DATA(state->m_roundInput)+PascalHeaderNoncePosV4(PascalHeaderSize)) = newNonce; 
     
     state->m_data[in_round-1].backup_io_results = state->m_data[in_round-1].io_results;
-    if (in_round == RH_N)
+    state->m_data[in_round-1].foldExpand = 0;
+    if (RH_Round<in_round>::IsLast)
         state->m_data[in_round - 1].io_results = state->m_data[RH_N].parenAndNeighbortOutputs;
     else
         state->m_data[in_round - 1].io_results = state->m_data[in_round].parenAndNeighbortOutputs;
 }
 
 
-void CUDA_SYM_DECL(RandomHash_Phase_2_pop)(RandomHash_State* state, int in_round)         
+//Phase 2 pop is split around the accumulator updates of the round outputs. With a queue, the updates of 
+//the strides from the parent round are only queued so the lanes can run theirs together before the compress.
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_Phase_2_pop_Accum)(RandomHash_State* state, RH_MurmurStreamQueue* queue)
 {
     state->m_data[in_round-1].io_results = state->m_data[in_round-1].backup_io_results;
     RH_StridePtrArray pano;
-    if (in_round == RH_N)
+    if (RH_Round<in_round>::IsLast)
     {
         pano = state->m_data[RH_N].parenAndNeighbortOutputs;
 
@@ -654,7 +759,7 @@ void CUDA_SYM_DECL(RandomHash_Phase_2_pop)(RandomHash_State* state, int in_round
     else
         pano = state->m_data[in_round].parenAndNeighbortOutputs;
 
-    RH_ASSERT( RH_STRIDE_GET_SIZE(state->m_data[in_round].roundOutputs) + RH_STRIDE_GET_SIZE(pano) < GetRoundOutputCount(in_round) );
+    RH_ASSERT( RH_STRIDE_GET_SIZE(state->m_data[in_round].roundOutputs) + RH_STRIDE_GET_SIZE(pano) < RH_Round<in_round>::OutputCount );
     
     RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) != 0);
     
@@ -681,35 +786,48 @@ void CUDA_SYM_DECL(RandomHash_Phase_2_pop)(RandomHash_State* state, int in_round
         }
         else
         {
-            _CM(RH_STRIDEARRAY_PUSHBACK_MANY_UPDATE)(state->m_data[in_round].roundOutputs, pano, state->m_round5Phase2PrecalcArray);
+            _CM(RH_STRIDEARRAY_PUSHBACK_MANY_UPDATE)(state->m_data[in_round].roundOutputs, pano, state->m_round5Phase2PrecalcArray, queue);
         }
     }
 
-    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(pano) <= GetParentRoundOutputCount(in_round));
-    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= GetRoundOutputCount(in_round));
+    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(pano) <= RH_Round<in_round>::ParentOutputCount);
+    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= RH_Round<in_round>::OutputCount);
+}
 
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_Phase_2_pop_Compress)(RandomHash_State* state)
+{
     _CM(RandomHash_Compress)(state, state->m_data[in_round].roundOutputs, state->m_workBytes, in_round);  
     RH_ASSERT(RH_STRIDE_GET_SIZE(state->m_workBytes) <= 100);
         
-    if (in_round != RH_N)
+    if (!RH_Round<in_round>::IsLast)
     {
         if (in_round == 4 && state->m_isMidStateRound)
         {
             if (state->m_stridesAllocMidstateBarrier != RH_STRIDE_BANK_SIZE)
                 state->m_stridesAllocMidstateBarrierNext = RH_STRIDE_BANK_SIZE;
         }
-        RH_STRIDEARRAY_RESET(pano);
+        RH_STRIDEARRAY_RESET(state->m_data[in_round].parenAndNeighbortOutputs);
     }
 }
 
-inline void CUDA_SYM_DECL(RandomHash_Phase_init)(RandomHash_State* state, int in_round)
+template <int in_round>
+void CUDA_SYM_DECL(RandomHash_Phase_2_pop)(RandomHash_State* state)
+{
+    _CM(RandomHash_Phase_2_pop_Accum)<in_round>(state, 0);
+    _CM(RandomHash_Phase_2_pop_Compress)<in_round>(state);
+}
+
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_Phase_init)(RandomHash_State* state)
 {    
     RH_STRIDEARRAY_RESET(state->m_data[in_round].roundOutputs);
 }
 
-inline void CUDA_SYM_DECL(RandomHash)(RandomHash_State* state, int in_round)
+//pick the round's next algorithm and allocate its output
+template <int in_round>
+inline U32 CUDA_SYM_DECL(RandomHash_Select)(RandomHash_State* state, RH_StridePtr& input, RH_StridePtr& output)
 {
-    RH_StridePtr input;
     if (in_round == 1)
     {
         RH_ASSERT(RH_STRIDE_GET_SIZE(state->m_roundInput) <= PascalHeaderSize);
@@ -721,12 +839,30 @@ inline void CUDA_SYM_DECL(RandomHash)(RandomHash_State* state, int in_round)
         input = state->m_workBytes;
     }
 
-    U32 rndHash = _CM(GetNextRnd)(&state->m_data[in_round].rndGen) % 18;
+    U32 rndHash = _CM(GetNextRnd)(&state->m_data[in_round].rndGen) % RH_ALGO_COUNT;
 
-    RH_StridePtr output = _CM(RH_StrideArrayAllocOutput)(state, c_AlgoSize[rndHash]);
+    output = _CM(RH_StrideArrayAllocOutput)(state, c_AlgoSize[rndHash]);
     RH_STRIDEARRAY_PUSHBACK(state->m_data[in_round].roundOutputs, output);
-    RH_ASSERT( RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= GetRoundOutputCount(in_round));
+    RH_ASSERT( RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= RH_Round<in_round>::OutputCount);
+    return rndHash;
+}
+
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash)(RandomHash_State* state)
+{
+    RH_StridePtr input;
+    RH_StridePtr output;
+    U32 rndHash = _CM(RandomHash_Select)<in_round>(state, input, output);
     
+#if !defined(RANDOMHASH_CUDA)
+    if (in_round == 1 && c_RH_HeaderMidstates[rndHash].resume)
+    {
+        c_RH_HeaderMidstates[rndHash].resume(state->m_headerMidstates[rndHash], input, output);
+        RH_STRIDE_CHECK_INTEGRITY(output);
+        return;
+    }
+#endif
+
     switch(rndHash)
     {
         case RandomHashAlgos::RH_SHA2_256     :
@@ -806,10 +942,17 @@ inline void CUDA_SYM_DECL(RandomHash)(RandomHash_State* state, int in_round)
     RH_STRIDE_CHECK_INTEGRITY(output);
 }
 
-inline void CUDA_SYM_DECL(RandomHash_end)(RandomHash_State* state, int in_round)
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_end)(RandomHash_State* state)
 {    
     RH_StridePtr output = RH_STRIDEARRAY_GET(state->m_data[in_round].roundOutputs, RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) - 1);
-    _CM(RandomHash_Expand)(state, output, in_round, RH_N - in_round, state->m_data[in_round].roundOutputs);
+    //Before a phase 1 pop, the expanded output is the last stride the parent adds to both accumulators of its pano.
+    //pano receives the accumulator of roundOutputs below, so the expand folds it right away in that one and in the round 5 one
+    RH_StridePtrArray foldArray = !RH_Round<in_round>::IsLast && state->m_data[in_round].foldExpand ? state->m_data[in_round].roundOutputs : 0;
+    _CM(RandomHash_Expand)<RH_Round<in_round>::ExpansionSize>(state, output, foldArray, state->m_round5Phase2PrecalcArray);
+    state->m_roundBytes[in_round] += RHMINER_ALIGN(RH_STRIDE_GET_SIZE(output) + RH_IDEAL_ALIGNMENT, 32);
+    if (state->m_roundBytes[in_round] > state->m_roundBytesPeak[in_round])
+        state->m_roundBytesPeak[in_round] = state->m_roundBytes[in_round];
     RH_STRIDEARRAY_RESET(state->m_data[in_round].io_results);
 
     RH_STRIDEARRAY_PUSHBACK_MANY_ALL(state->m_data[in_round].io_results, state->m_data[in_round].roundOutputs); 
@@ -817,15 +960,71 @@ inline void CUDA_SYM_DECL(RandomHash_end)(RandomHash_State* state, int in_round)
     if (in_round == 5)
         _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_DUO)(state->m_data[5].roundOutputs, RH_STRIDEARRAY_GET_SIZE(state->m_data[5].roundOutputs) - 1, state->m_round5Phase2PrecalcArray);
     
-    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= GetRoundOutputCount(in_round));
+    RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(state->m_data[in_round].roundOutputs) <= RH_Round<in_round>::OutputCount);
 }
 
-inline void CUDA_SYM_DECL(RandomHash_FirstCall_push)(RandomHash_State* state, int in_round)
+template <int in_round>
+inline void CUDA_SYM_DECL(RandomHash_FirstCall_push)(RandomHash_State* state)
 {
     state->m_data[5].io_results = state->m_data[0].parenAndNeighbortOutputs;
     state->m_skipPhase1 = 0;    
 }
 
+//-------------------------------------------------------------------------------------------------------------------------------------
+//Early abandonment. Each checkpoint of a search kind has its own budget, the g_cpuAbandon percentile of the cost the last
+//RH_ABANDON_SAMPLES searches had when they reached that same checkpoint. An abandoned search never reaches the later checkpoints,
+//so it counts there as over any budget, otherwise each new budget would cut the top of the last one
+inline void RandomHash_AddSearchSample(RandomHash_State* state)
+{
+    U32 kind = state->m_searchKind;
+    U32 n = state->m_abandonSampleCount[kind]++;
+    for (U32 c = 0; c < RH_ABANDON_CHECKPOINTS; c++)
+        state->m_abandonSamples[kind][c][n % RH_ABANDON_SAMPLES] = c < state->m_checkpoint ? state->m_checkpointCost[c] : U64_Max;
+
+    if (n + 1 >= RH_ABANDON_SAMPLES && ((n + 1) % (RH_ABANDON_SAMPLES / 4)) == 0)
+    {
+        U32 rank = RH_ABANDON_SAMPLES * g_cpuAbandon / 100;
+        for (U32 c = 0; c < RH_ABANDON_CHECKPOINTS; c++)
+        {
+            U64 sorted[RH_ABANDON_SAMPLES];
+            memcpy(sorted, state->m_abandonSamples[kind][c], sizeof(sorted));
+            std::nth_element(sorted, sorted + rank, sorted + RH_ABANDON_SAMPLES);
+            state->m_abandonBudget[kind][c] = sorted[rank];
+        }
+    }
+}
+
+inline bool RandomHash_OverBudget(RandomHash_State* state)
+{
+    if (!g_cpuAbandon)
+        return false;
+    U32 c = state->m_checkpoint++;
+    RH_ASSERT(c < RH_ABANDON_CHECKPOINTS);
+    U64 cost = TimeGetThreadCpuTime() - state->m_searchStartTime;
+    state->m_checkpointCost[c] = cost;
+    if (cost <= state->m_abandonBudget[state->m_searchKind][c])
+        return false;
+
+    RandomHash_AddSearchSample(state);
+    state->m_abandoned = true;
+    return true;
+}
+#define RH_ABANDON_CHECKPOINT() if (RandomHash_OverBudget(state)) return;
+
+//The abandoned search leaves the state like a new header does, without the header midstates. Its round 4 outputs are lost,
+//so the next search builds its full tree from a fresh nonce
+inline U32 RandomHash_Abandon(RandomHash_State* state)
+{
+    state->m_abandoned = false;
+    state->m_abandonedCount++;
+    state->m_isCachedOutputs = false;
+    state->m_isMidStateRound = false;
+    state->m_midStateNonce = 0xFFFFFFFF;
+    for (U32 r = 1; r <= RH_N; r++)
+        state->m_data[r].first_round_consume = false;
+    return state->m_startNonce * 1664525 + 1013904223;
+}
+
 //-------------------------------------------------------------------------------------------------------------------------------------
 #define RH_CALL_KERNEL_BLOCK(N)    CUDA_SYM(RandomHash_Block##N)(allStates);
 
@@ -839,256 +1038,264 @@ CUDA_DECL_KERNEL void CUDA_SYM(RandomHash_Block0)(RandomHash_State* allStates)
 {
     CUDA_DECLARE_STATE();
     /*#define RH_B0*/     
-    RandomHash_FirstCall_push(state, 5);
-    RandomHash_Phase_init(state, 5);
-    RandomHash_Phase_1_push(state, 5);
+    RandomHash_FirstCall_push<5>(state);
+    RandomHash_Phase_init<5>(state);
+    RandomHash_Phase_1_push<5>(state);
     if (!state->m_skipPhase1) 
     {
-        RandomHash_Phase_init(state, 4);
-        RandomHash_Phase_1_push(state, 4);
-        RandomHash_Phase_init(state, 3);
-        RandomHash_Phase_1_push(state, 3);
-        RandomHash_Phase_init(state, 2);
-        RandomHash_Phase_1_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_init<4>(state);
+        RandomHash_Phase_1_push<4>(state);
+        RandomHash_Phase_init<3>(state);
+        RandomHash_Phase_1_push<3>(state);
+        RandomHash_Phase_init<2>(state);
+        RandomHash_Phase_1_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_1_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_1_pop<2>(state);
 
 
-        RandomHash_Phase_2_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_2_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_2_pop<2>(state);
 
-        RandomHash(state, 2);
+        RandomHash<2>(state);
 
-        RandomHash_end(state, 2);
-        RandomHash_Phase_1_pop(state, 3);
+        RandomHash_end<2>(state);
+        RH_ABANDON_CHECKPOINT();
+        RandomHash_Phase_1_pop<3>(state);
 
 
-        RandomHash_Phase_2_push(state, 3);
-        RandomHash_Phase_init(state, 2);
-        RandomHash_Phase_1_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<3>(state);
+        RandomHash_Phase_init<2>(state);
+        RandomHash_Phase_1_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_1_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_1_pop<2>(state);
 
 
-        RandomHash_Phase_2_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_2_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_2_pop<2>(state);
 
-        RandomHash(state, 2);
+        RandomHash<2>(state);
 
-        RandomHash_end(state, 2);
-        RandomHash_Phase_2_pop(state, 3);
+        RandomHash_end<2>(state);
+        RH_ABANDON_CHECKPOINT();
+        RandomHash_Phase_2_pop<3>(state);
 
-        RandomHash(state, 3);
+        RandomHash<3>(state);
 
-        RandomHash_end(state, 3);
-        RandomHash_Phase_1_pop(state, 4);
+        RandomHash_end<3>(state);
+        RandomHash_Phase_1_pop<4>(state);
 
 
-        RandomHash_Phase_2_push(state, 4);
-        RandomHash_Phase_init(state, 3);
-        RandomHash_Phase_1_push(state, 3);
-        RandomHash_Phase_init(state, 2);
-        RandomHash_Phase_1_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<4>(state);
+        RandomHash_Phase_init<3>(state);
+        RandomHash_Phase_1_push<3>(state);
+        RandomHash_Phase_init<2>(state);
+        RandomHash_Phase_1_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_1_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_1_pop<2>(state);
 
 
-        RandomHash_Phase_2_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_2_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_2_pop<2>(state);
 
-        RandomHash(state, 2);
+        RandomHash<2>(state);
 
-        RandomHash_end(state, 2);
-        RandomHash_Phase_1_pop(state, 3);
+        RandomHash_end<2>(state);
+        RH_ABANDON_CHECKPOINT();
+        RandomHash_Phase_1_pop<3>(state);
 
 
-        RandomHash_Phase_2_push(state, 3);
-        RandomHash_Phase_init(state, 2);
-        RandomHash_Phase_1_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<3>(state);
+        RandomHash_Phase_init<2>(state);
+        RandomHash_Phase_1_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_1_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_1_pop<2>(state);
 
 
-        RandomHash_Phase_2_push(state, 2);
-        RandomHash_Phase_init(state, 1);
-        RandomHash_start(state, 1);
-        RandomHash(state, 1);
+        RandomHash_Phase_2_push<2>(state);
+        RandomHash_Phase_init<1>(state);
+        RandomHash_start<1>(state);
+        RandomHash<1>(state);
 
-        RandomHash_end(state, 1);
-        RandomHash_Phase_2_pop(state, 2);
+        RandomHash_end<1>(state);
+        RandomHash_Phase_2_pop<2>(state);
 
-        RandomHash(state, 2);
+        RandomHash<2>(state);
 
-        RandomHash_end(state, 2);
-        RandomHash_Phase_2_pop(state, 3);
+        RandomHash_end<2>(state);
+        RH_ABANDON_CHECKPOINT();
+        RandomHash_Phase_2_pop<3>(state);
 
-        RandomHash(state, 3);
+        RandomHash<3>(state);
 
-        RandomHash_end(state, 3);
-        RandomHash_Phase_2_pop(state, 4);
+        RandomHash_end<3>(state);
+        RandomHash_Phase_2_pop<4>(state);
 
-        RandomHash(state, 4);
+        RandomHash<4>(state);
 
-        RandomHash_end(state, 4);
+        RandomHash_end<4>(state);
     }
-    RandomHash_Phase_1_pop(state, 5);
-
-
-    RandomHash_Phase_2_push(state, 5);
-    RandomHash_Phase_init(state, 4);
-    RandomHash_Phase_1_push(state, 4);
-    RandomHash_Phase_init(state, 3);
-    RandomHash_Phase_1_push(state, 3);
-    RandomHash_Phase_init(state, 2);
-    RandomHash_Phase_1_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
+    RandomHash_Phase_1_pop<5>(state);
+
+
+    RandomHash_Phase_2_push<5>(state);
+    RandomHash_Phase_init<4>(state);
+    RandomHash_Phase_1_push<4>(state);
+    RandomHash_Phase_init<3>(state);
+    RandomHash_Phase_1_push<3>(state);
+    RandomHash_Phase_init<2>(state);
+    RandomHash_Phase_1_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
     RandomHash_MiddlePoint(state);
-    RandomHash(state, 1);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_1_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_1_pop<2>(state);
 
 
-    RandomHash_Phase_2_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_2_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_2_pop<2>(state);
 
-    RandomHash(state, 2);
+    RandomHash<2>(state);
 
-    RandomHash_end(state, 2);
-    RandomHash_Phase_1_pop(state, 3);
+    RandomHash_end<2>(state);
+    RH_ABANDON_CHECKPOINT();
+    RandomHash_Phase_1_pop<3>(state);
 
 
-    RandomHash_Phase_2_push(state, 3);
-    RandomHash_Phase_init(state, 2);
-    RandomHash_Phase_1_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<3>(state);
+    RandomHash_Phase_init<2>(state);
+    RandomHash_Phase_1_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_1_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_1_pop<2>(state);
 
 
-    RandomHash_Phase_2_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_2_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_2_pop<2>(state);
 
-    RandomHash(state, 2);
+    RandomHash<2>(state);
 
-    RandomHash_end(state, 2);
-    RandomHash_Phase_2_pop(state, 3);
+    RandomHash_end<2>(state);
+    RH_ABANDON_CHECKPOINT();
+    RandomHash_Phase_2_pop<3>(state);
 
-    RandomHash(state, 3);
+    RandomHash<3>(state);
 
-    RandomHash_end(state, 3);
-    RandomHash_Phase_1_pop(state, 4);
+    RandomHash_end<3>(state);
+    RandomHash_Phase_1_pop<4>(state);
 
 
-    RandomHash_Phase_2_push(state, 4);
-    RandomHash_Phase_init(state, 3);
-    RandomHash_Phase_1_push(state, 3);
-    RandomHash_Phase_init(state, 2);
-    RandomHash_Phase_1_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<4>(state);
+    RandomHash_Phase_init<3>(state);
+    RandomHash_Phase_1_push<3>(state);
+    RandomHash_Phase_init<2>(state);
+    RandomHash_Phase_1_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_1_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_1_pop<2>(state);
 
 
-    RandomHash_Phase_2_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_2_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_2_pop<2>(state);
 
-    RandomHash(state, 2);
+    RandomHash<2>(state);
 
-    RandomHash_end(state, 2);
-    RandomHash_Phase_1_pop(state, 3);
+    RandomHash_end<2>(state);
+    RH_ABANDON_CHECKPOINT();
+    RandomHash_Phase_1_pop<3>(state);
 
 
-    RandomHash_Phase_2_push(state, 3);
-    RandomHash_Phase_init(state, 2);
-    RandomHash_Phase_1_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<3>(state);
+    RandomHash_Phase_init<2>(state);
+    RandomHash_Phase_1_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_1_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_1_pop<2>(state);
 
 
-    RandomHash_Phase_2_push(state, 2);
-    RandomHash_Phase_init(state, 1);
-    RandomHash_start(state, 1);
-    RandomHash(state, 1);
+    RandomHash_Phase_2_push<2>(state);
+    RandomHash_Phase_init<1>(state);
+    RandomHash_start<1>(state);
+    RandomHash<1>(state);
 
-    RandomHash_end(state, 1);
-    RandomHash_Phase_2_pop(state, 2);
+    RandomHash_end<1>(state);
+    RandomHash_Phase_2_pop<2>(state);
 
-    RandomHash(state, 2);
+    RandomHash<2>(state);
 
-    RandomHash_end(state, 2);
-    RandomHash_Phase_2_pop(state, 3);
+    RandomHash_end<2>(state);
+    RH_ABANDON_CHECKPOINT();
+    RandomHash_Phase_2_pop<3>(state);
 
-    RandomHash(state, 3);
+    RandomHash<3>(state);
 
-    RandomHash_end(state, 3);
-    RandomHash_Phase_2_pop(state, 4);
+    RandomHash_end<3>(state);
+    RandomHash_Phase_2_pop<4>(state);
 
-    RandomHash(state, 4);
+    RandomHash<4>(state);
 
-    RandomHash_end(state, 4);
-    RandomHash_Phase_2_pop(state, 5);
+    RandomHash_end<4>(state);
+    RandomHash_Phase_2_pop<5>(state);
 
-    RandomHash(state, 5);
+    RandomHash<5>(state);
 
-    RandomHash_end(state, 5);
+    RandomHash_end<5>(state);
 }
 
 #define RH_CALL_ALL_KERNEL_BLOCKS \
@@ -1106,10 +1313,27 @@ CUDA_DECL_KERNEL void CUDA_SYM(RandomHash_Init)(RandomHash_State* allStates, U8*
         state->m_isNewHeader = false;
         (*(U32*)(state->m_roundInput)) = PascalHeaderSize;
         _CM(RH_STRIDE_MEMCPY_UNALIGNED_SIZE8)(RH_STRIDE_GET_DATA(state->m_roundInput), &state->m_header[0], PascalHeaderSize); 
+
+#if !defined(RANDOMHASH_CUDA)
+        //everything before the nonce is hashed once for all the nonces of this header
+        for (U32 algo = 0; algo < RH_ALGO_COUNT; algo++)
+            if (c_RH_HeaderMidstates[algo].prefix)
+                c_RH_HeaderMidstates[algo].prefix(&state->m_header[0], state->m_headerMidstates[algo]);
+        _CM(MurmurHash3_x86_32_Init)(0, &state->m_headerMurmur);
+        _CM(MurmurHash3_x86_32_Update)(&state->m_header[0], PascalHeaderNoncePosV4(PascalHeaderSize), &state->m_headerMurmur);
+#endif
     }
     
+    //NOTE: Only round 5 phase 2 produces a complete set of round 4 outputs and the next search always consumes it.
+    //      So there is never more than one live midstate per state, the chain only breaks on a new header.
+    state->m_searchKind = state->m_isCachedOutputs ? 1 : 0;
     if (state->m_isCachedOutputs)
+    {
         startNonce = state->m_midStateNonce;
+        state->m_midStateHits++;
+    }
+    else
+        state->m_fullTreeCount++;
 
 #ifdef RH_SCREEN_SAVER_MODE
     extern void ScreensaverFeed(U32 nonce);
@@ -1118,6 +1342,11 @@ CUDA_DECL_KERNEL void CUDA_SYM(RandomHash_Init)(RandomHash_State* allStates, U8*
     
     state->m_startNonce = startNonce;
     *(U32*)(RH_STRIDE_GET_DATA(state->m_roundInput) + PascalHeaderNoncePosV4(PascalHeaderSize)) = startNonce;
+    if (g_cpuAbandon)
+    {
+        state->m_checkpoint = 0;
+        state->m_searchStartTime = TimeGetThreadCpuTime();
+    }
 }
 
 #ifdef __CUDA_ARCH__
@@ -1162,7 +1391,670 @@ void RandomHash_Search(RandomHash_State* in_state, U8* out_hash, U32 startNonce)
     RandomHash_State* allStates = in_state;
     RandomHash_Init(allStates, out_hash, startNonce);
     RH_CALL_ALL_KERNEL_BLOCKS
+    while (allStates->m_abandoned)
+    {
+        RandomHash_Init(allStates, out_hash, RandomHash_Abandon(allStates));
+        RH_CALL_ALL_KERNEL_BLOCKS
+    }
+    if (g_cpuAbandon)
+        RandomHash_AddSearchSample(allStates);
     RandomHash_Finalize(allStates, out_hash);
 }
 
+//-------------------------------------------------------------------------------------------------------------------------------------
+//Lane mode. RandomHash_Block0 written as a resumable step program, so one thread can advance many states in lockstep
+//and the core can overlap one lane's memory stalls with the hashing of the other lanes.
+enum RH_LaneOp : U8
+{
+    RH_LANE_OP_FirstCall_push,
+    RH_LANE_OP_Phase_init,
+    RH_LANE_OP_Phase_1_push,
+    RH_LANE_OP_Phase_1_pop,
+    RH_LANE_OP_Phase_2_push,
+    RH_LANE_OP_Phase_2_pop,
+    RH_LANE_OP_start,
+    RH_LANE_OP_Hash,
+    RH_LANE_OP_end,
+    RH_LANE_OP_MiddlePoint,
+    RH_LANE_OP_SkipPhase1,
+};
+
+struct RH_LaneStep
+{
+    U8 op;
+    U8 arg;     //round, or jump distance for RH_LANE_OP_SkipPhase1
+};
+
+//NOTE: Must stay in sync with the call sequence of RandomHash_Block0. -testkernels checks the lanes against RandomHash_Search
+static const RH_LaneStep c_RH_LaneProgram[] =
+{
+    {RH_LANE_OP_FirstCall_push, 5},
+    {RH_LANE_OP_Phase_init, 5},
+    {RH_LANE_OP_Phase_1_push, 5},
+    {RH_LANE_OP_SkipPhase1, 82},   //jump over the round 1-4 phase 1 when the round 4 outputs are cached
+    {RH_LANE_OP_Phase_init, 4},
+    {RH_LANE_OP_Phase_1_push, 4},
+    {RH_LANE_OP_Phase_init, 3},
+    {RH_LANE_OP_Phase_1_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_1_pop, 3},
+    {RH_LANE_OP_Phase_2_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_2_pop, 3},
+    {RH_LANE_OP_Hash, 3},
+    {RH_LANE_OP_end, 3},
+    {RH_LANE_OP_Phase_1_pop, 4},
+    {RH_LANE_OP_Phase_2_push, 4},
+    {RH_LANE_OP_Phase_init, 3},
+    {RH_LANE_OP_Phase_1_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_1_pop, 3},
+    {RH_LANE_OP_Phase_2_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_2_pop, 3},
+    {RH_LANE_OP_Hash, 3},
+    {RH_LANE_OP_end, 3},
+    {RH_LANE_OP_Phase_2_pop, 4},
+    {RH_LANE_OP_Hash, 4},
+    {RH_LANE_OP_end, 4},
+    {RH_LANE_OP_Phase_1_pop, 5},
+    {RH_LANE_OP_Phase_2_push, 5},
+    {RH_LANE_OP_Phase_init, 4},
+    {RH_LANE_OP_Phase_1_push, 4},
+    {RH_LANE_OP_Phase_init, 3},
+    {RH_LANE_OP_Phase_1_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_MiddlePoint, 0},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_1_pop, 3},
+    {RH_LANE_OP_Phase_2_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_2_pop, 3},
+    {RH_LANE_OP_Hash, 3},
+    {RH_LANE_OP_end, 3},
+    {RH_LANE_OP_Phase_1_pop, 4},
+    {RH_LANE_OP_Phase_2_push, 4},
+    {RH_LANE_OP_Phase_init, 3},
+    {RH_LANE_OP_Phase_1_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_1_pop, 3},
+    {RH_LANE_OP_Phase_2_push, 3},
+    {RH_LANE_OP_Phase_init, 2},
+    {RH_LANE_OP_Phase_1_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_1_pop, 2},
+    {RH_LANE_OP_Phase_2_push, 2},
+    {RH_LANE_OP_Phase_init, 1},
+    {RH_LANE_OP_start, 1},
+    {RH_LANE_OP_Hash, 1},
+    {RH_LANE_OP_end, 1},
+    {RH_LANE_OP_Phase_2_pop, 2},
+    {RH_LANE_OP_Hash, 2},
+    {RH_LANE_OP_end, 2},
+    {RH_LANE_OP_Phase_2_pop, 3},
+    {RH_LANE_OP_Hash, 3},
+    {RH_LANE_OP_end, 3},
+    {RH_LANE_OP_Phase_2_pop, 4},
+    {RH_LANE_OP_Hash, 4},
+    {RH_LANE_OP_end, 4},
+    {RH_LANE_OP_Phase_2_pop, 5},
+    {RH_LANE_OP_Hash, 5},
+    {RH_LANE_OP_end, 5},
+};
+static const U32 c_RH_LaneProgramSize = sizeof(c_RH_LaneProgram) / sizeof(c_RH_LaneProgram[0]);
+
+//the program's rounds are only known at run time, so each round op goes through its table of per round instances
+static_assert(RH_N == 5, "RH_ROUND_INSTANCES lists one instance per round");
+#define RH_ROUND_INSTANCES(func) { 0, func<1>, func<2>, func<3>, func<4>, func<5> }
+
+typedef void (*RH_RoundFunc)(RandomHash_State* state);
+static const RH_RoundFunc c_RH_LaneRoundFuncs[RH_LANE_OP_MiddlePoint][RH_N + 1] =
+{
+    RH_ROUND_INSTANCES(RandomHash_FirstCall_push),
+    RH_ROUND_INSTANCES(RandomHash_Phase_init),
+    RH_ROUND_INSTANCES(RandomHash_Phase_1_push),
+    RH_ROUND_INSTANCES(RandomHash_Phase_1_pop),
+    RH_ROUND_INSTANCES(RandomHash_Phase_2_push),
+    RH_ROUND_INSTANCES(RandomHash_Phase_2_pop),
+    RH_ROUND_INSTANCES(RandomHash_start),
+    RH_ROUND_INSTANCES(RandomHash),
+    RH_ROUND_INSTANCES(RandomHash_end),
+};
+
+inline U32 RandomHash_LaneStep(RandomHash_State* state, U32 pc)
+{
+    const RH_LaneStep& step = c_RH_LaneProgram[pc];
+    switch (step.op)
+    {
+        case RH_LANE_OP_MiddlePoint:    RandomHash_MiddlePoint(state); break;
+        case RH_LANE_OP_SkipPhase1:
+        {
+            if (state->m_skipPhase1)
+                return pc + step.arg;
+        } break;
+        default:
+        {
+            RH_ASSERT(step.arg >= 1 && step.arg <= RH_N);
+            c_RH_LaneRoundFuncs[step.op][step.arg](state);
+        }
+    }
+    return pc + 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+//Kernel variants and their selection
+
+#define RH_ISA_SSE4     1
+#define RH_ISA_AVX2     2
+#define RH_ISA_SHA      4
+#define RH_ISA_AVX512   8
+#define RH_ISA_SSE3     16
+#define RH_ISA_COUNT    5
+
+static bool* const c_RH_IsaFlags[RH_ISA_COUNT] = { &g_isSSE4Supported, &g_isAVX2Supported, &g_isSHASupported, &g_isAVX512Supported, &g_isSSE3Supported };
+static const char* c_RH_IsaNames[RH_ISA_COUNT] = { "SSE4", "AVX2", "SHA", "AVX512", "SSE3" };
+
+static bool RH_HasIsa(U32 isa)
+{
+    for (U32 f = 0; f < RH_ISA_COUNT; f++)
+        if ((isa & (1 << f)) && !*c_RH_IsaFlags[f])
+            return false;
+    return true;
+}
+
+//Transfo0 has a register version for the small aligned chunks
+#if defined(RHMINER_ENABLE_SSE4)
+static void Transfo0_2_SSE4(U8* nextChunk, U32 size, U8* source)
+{
+    if (size <= 128 && (size_t(nextChunk) & 0x0f) == 0)
+        _CM(Transfo0_2_128_SSE4)(nextChunk, size, source);
+    else
+        _CM(Transfo0_2)(nextChunk, size, source);
+}
+#endif
+
+static void Transfo0_2_SSE3(U8* nextChunk, U32 size, U8* source)
+{
+    if (size <= 128 && (size_t(nextChunk) & 0x0f) == 0)
+        _CM(Transfo0_2_128_SSE3)(nextChunk, size, source);
+    else
+        _CM(Transfo0_2)(nextChunk, size, source);
+}
+
+struct RH_TransfoKernel
+{
+    U32                 slot;
+    const char*         name;
+    U32                 isa;
+    RH_TransfoFunc      func;
+};
+
+//The first variant of each slot the cpu supports is selected, in the order they measured on a Xeon with AVX-512.
+//The 64 byte loads and stores of the AVX-512 interleaves and of Transfo5 split cache lines and end up slower than AVX2.
+//The variants after the scalar one are slower than it and only run in -testkernels.
+static const RH_TransfoKernel c_RH_TransfoKernels[] =
+{
+    { 0, "AVX512",  RH_ISA_AVX512,  Transfo0_2_AVX512 },
+#if defined(RHMINER_ENABLE_SSE4)
+    { 0, "SSE4",    RH_ISA_SSE4,    Transfo0_2_SSE4 },
+#endif
+    { 0, "SSE3",    RH_ISA_SSE3,    Transfo0_2_SSE3 },
+    { 0, "scalar",  0,              _CM(Transfo0_2) },
+    { 0, "AVX2",    RH_ISA_AVX2,    Transfo0_2_AVX2 },
+    { 1, "scalar",  0,              _CM(Transfo1_2) },
+    { 1, "AVX2",    RH_ISA_AVX2,    Transfo1_2_AVX2 },
+    { 1, "AVX512",  RH_ISA_AVX512,  Transfo1_2_AVX512 },
+    { 2, "AVX512",  RH_ISA_AVX512,  Transfo2_2_AVX512 },
+    { 2, "AVX2",    RH_ISA_AVX2,    Transfo2_2_AVX2 },
+    { 2, "scalar",  0,              _CM(Transfo2_2) },
+    { 3, "AVX2",    RH_ISA_AVX2,    Transfo3_2_AVX2 },
+    { 3, "AVX512",  RH_ISA_AVX512,  Transfo3_2_AVX512 },
+    { 3, "scalar",  0,              _CM(Transfo3_2) },
+    { 4, "AVX2",    RH_ISA_AVX2,    Transfo4_2_AVX2 },
+    { 4, "scalar",  0,              _CM(Transfo4_2) },
+    { 4, "AVX512",  RH_ISA_AVX512,  Transfo4_2_AVX512 },
+    { 5, "AVX2",    RH_ISA_AVX2,    Transfo5_2_AVX2 },
+    { 5, "AVX512",  RH_ISA_AVX512,  Transfo5_2_AVX512 },
+    { 5, "scalar",  0,              _CM(Transfo5_2) },
+    { 6, "AVX512",  RH_ISA_AVX512,  Transfo6_2_AVX512 },
+    { 6, "AVX2",    RH_ISA_AVX2,    Transfo6_2_AVX2 },
+    { 6, "scalar",  0,              _CM(Transfo6_2) },
+    { 7, "AVX512",  RH_ISA_AVX512,  Transfo7_2_AVX512 },
+    { 7, "AVX2",    RH_ISA_AVX2,    Transfo7_2_AVX2 },
+    { 7, "scalar",  0,              _CM(Transfo7_2) },
+};
+
+struct RH_MurmurKernel
+{
+    const char*         name;
+    U32                 sseOptimization;    //-sseboost level that enables it
+    U32                 isa;
+    RH_MurmurUpdateFunc func;
+};
+
+static const RH_MurmurKernel c_RH_MurmurKernels[] =
+{
+#if defined(RHMINER_ENABLE_SSE4)
+    { "SSE4",   1, RH_ISA_SSE4,   RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41_ANY },
+#endif
+    //h1 is a serial chain, the wider k1 mix measured the same as SSE4
+    { "AVX512", 1, RH_ISA_AVX512, RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX512_ANY },
+    { "AVX2",   1, RH_ISA_AVX2,   RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX2_ANY },
+    { "scalar", 0, 0,             RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b },
+};
+
+static void RH_Murmur3UpdateStreams_Scalar(RH_MurmurStream* streams, U32 count)
+{
+    for (U32 i = 0; i < count; i++)
+        for (U32 s = 0; s < streams[i].count; s++)
+            _CM(MurmurHash3_x86_32_Update)(RH_STRIDE_GET_DATA(streams[i].strides[s]), RH_STRIDE_GET_SIZE(streams[i].strides[s]), streams[i].accum);
+}
+
+struct RH_MurmurStreamsKernel
+{
+    const char*             name;
+    U32                     isa;
+    RH_MurmurStreamsFunc    func;
+};
+
+//the accumulators of all lanes, queued by RandomHash_SearchLanes
+static const RH_MurmurStreamsKernel c_RH_MurmurStreamsKernels[] =
+{
+    { "AVX2 x8",    RH_ISA_AVX2,    RH_Murmur3UpdateStreams_AVX2 },
+    { "scalar",     0,              RH_Murmur3UpdateStreams_Scalar },
+};
+
+//Batched hash dispatch. The pending hashes of all lanes are grouped by algorithm so each one runs on many inputs per call.
+template <void (*HASH)(RH_StridePtr, RH_StridePtr)>
+static void RH_HashBatch_Scalar(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    for (U32 i = 0; i < count; i++)
+        HASH(inputs[i], outputs[i]);
+}
+
+//groups of LANES inputs in a multi-buffer kernel. Under MIN_COUNT inputs the scalar kernel is faster
+template <U32 LANES, U32 MIN_COUNT, void (*HASHN)(RH_StridePtr*, RH_StridePtr*, U32), void (*HASH)(RH_StridePtr, RH_StridePtr)>
+static void RH_HashBatch_Multi(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (count < MIN_COUNT)
+    {
+        for (U32 i = 0; i < count; i++)
+            HASH(inputs[i], outputs[i]);
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i += LANES)
+            HASHN(inputs + i, outputs + i, RH_Min(count - i, LANES));
+    }
+}
+
+static void RH_SHA2_384_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA2_512_AVX2x4(inputs, outputs, count, true); }
+static void RH_SHA2_512_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA2_512_AVX2x4(inputs, outputs, count, false); }
+static void RH_SHA3_256_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_X4<false>(inputs, outputs, count, 32); }
+static void RH_SHA3_384_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_X4<false>(inputs, outputs, count, 48); }
+static void RH_SHA3_512_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_X4<false>(inputs, outputs, count, 64); }
+static void RH_SHA3_256_AVX512x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_X4<true>(inputs, outputs, count, 32); }
+static void RH_SHA3_384_AVX512x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_X4<true>(inputs, outputs, count, 48); }
+static void RH_SHA3_512_AVX512x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_X4<true>(inputs, outputs, count, 64); }
+
+struct RH_HashKernel
+{
+    U32                 algo;
+    const char*         name;
+    U32                 isa;
+    RH_HashBatchFunc    func;
+};
+
+//the first variant of each algorithm the cpu supports is selected. The scalar SHA2_256 and blake2b
+//pick their SHA-NI, SSE4 or AVX2 compression inside.
+static const RH_HashKernel c_RH_HashKernels[] =
+{
+    { RH_SHA2_256,      "SHA-NI",       RH_ISA_SHA,                 RH_HashBatch_Scalar<_CM(RandomHash_SHA2_256)> },
+    { RH_SHA2_256,      "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 4, RandomHash_SHA2_256_AVX2x8, _CM(RandomHash_SHA2_256)> },
+    { RH_SHA2_256,      "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_SHA2_256)> },
+    { RH_SHA2_384,      "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RH_SHA2_384_AVX2x4, _CM(RandomHash_SHA2_384)> },
+    { RH_SHA2_384,      "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_SHA2_384)> },
+    { RH_SHA2_512,      "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RH_SHA2_512_AVX2x4, _CM(RandomHash_SHA2_512)> },
+    { RH_SHA2_512,      "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_SHA2_512)> },
+    { RH_SHA3_256,      "AVX512 x4",    RH_ISA_AVX2 | RH_ISA_AVX512, RH_HashBatch_Multi<4, 2, RH_SHA3_256_AVX512x4, _CM(RandomHash_SHA3_256)> },
+    { RH_SHA3_256,      "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RH_SHA3_256_AVX2x4, _CM(RandomHash_SHA3_256)> },
+    { RH_SHA3_256,      "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_SHA3_256)> },
+    { RH_SHA3_384,      "AVX512 x4",    RH_ISA_AVX2 | RH_ISA_AVX512, RH_HashBatch_Multi<4, 2, RH_SHA3_384_AVX512x4, _CM(RandomHash_SHA3_384)> },
+    { RH_SHA3_384,      "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RH_SHA3_384_AVX2x4, _CM(RandomHash_SHA3_384)> },
+    { RH_SHA3_384,      "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_SHA3_384)> },
+    { RH_SHA3_512,      "AVX512 x4",    RH_ISA_AVX2 | RH_ISA_AVX512, RH_HashBatch_Multi<4, 2, RH_SHA3_512_AVX512x4, _CM(RandomHash_SHA3_512)> },
+    { RH_SHA3_512,      "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RH_SHA3_512_AVX2x4, _CM(RandomHash_SHA3_512)> },
+    { RH_SHA3_512,      "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_SHA3_512)> },
+    { RH_RIPEMD160,     "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 2, RandomHash_MD_X8<RH_RIPEMD160_X8>, _CM(RandomHash_RIPEMD160)> },
+    { RH_RIPEMD160,     "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_RIPEMD160)> },
+    { RH_RIPEMD256,     "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 2, RandomHash_MD_X8<RH_RIPEMD256_X8>, _CM(RandomHash_RIPEMD256)> },
+    { RH_RIPEMD256,     "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_RIPEMD256)> },
+    { RH_RIPEMD320,     "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 2, RandomHash_MD_X8<RH_RIPEMD320_X8>, _CM(RandomHash_RIPEMD320)> },
+    { RH_RIPEMD320,     "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_RIPEMD320)> },
+    { RH_Blake2b,       "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RandomHash_blake2b_AVX2x4, _CM(RandomHash_blake2b)> },
+    { RH_Blake2b,       "SSE4",         RH_ISA_SSE4,                RH_HashBatch_Scalar<_CM(RandomHash_blake2b)> },
+    { RH_Blake2b,       "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_blake2b)> },
+    { RH_Blake2s,       "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_blake2s)> },
+    { RH_Tiger2_5_192,  "AVX2 x4",      RH_ISA_AVX2,                RH_HashBatch_Multi<4, 2, RandomHash_Tiger2_5_192_AVX2x4, _CM(RandomHash_Tiger2_5_192)> },
+    { RH_Tiger2_5_192,  "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_Tiger2_5_192)> },
+    { RH_Snefru_8_256,  "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_Snefru_8_256)> },
+    { RH_Grindahl512,   "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_Grindahl512)> },
+    { RH_Haval_5_256,   "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 2, RandomHash_MD_X8<RH_Haval_5_256_X8>, _CM(RandomHash_Haval_5_256)> },
+    { RH_Haval_5_256,   "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_Haval_5_256)> },
+    { RH_MD5,           "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 2, RandomHash_MD_X8<RH_MD5_X8>, _CM(RandomHash_MD5)> },
+    { RH_MD5,           "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_MD5)> },
+    { RH_RadioGatun32,  "AVX2 x8",      RH_ISA_AVX2,                RH_HashBatch_Multi<8, 2, RandomHash_RadioGatun32_X8, _CM(RandomHash_RadioGatun32)> },
+    { RH_RadioGatun32,  "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_RadioGatun32)> },
+    { RH_Whirlpool,     "scalar",       0,                          RH_HashBatch_Scalar<_CM(RandomHash_WhirlPool)> },
+};
+
+static const char* c_RH_AlgoNames[RH_ALGO_COUNT] = 
+{ 
+    "SHA2_256", "SHA2_384", "SHA2_512", "SHA3_256", "SHA3_384", "SHA3_512", "RIPEMD160", "RIPEMD256", "RIPEMD320", 
+    "blake2b", "blake2s", "Tiger2_5_192", "Snefru_8_256", "Grindahl512", "Haval_5_256", "MD5", "RadioGatun32", "WhirlPool" 
+};
+
+void RandomHash_InitKernelTable(bool logKernels)
+{
+    RH_InitXorShiftJumpTables();
+
+    const char* transfoNames[8] = { 0 };
+    for (U32 i = 0; i < RHMINER_ARRAY_COUNT(c_RH_TransfoKernels); i++)
+    {
+        const RH_TransfoKernel& k = c_RH_TransfoKernels[i];
+        if (!transfoNames[k.slot] && RH_HasIsa(k.isa))
+        {
+            g_RH_Kernels.transfo[k.slot] = k.func;
+            transfoNames[k.slot] = k.name;
+        }
+    }
+
+    //the simd accumulator updates are opt-in with -sseboost
+    const char* murmurName = 0;
+    for (const RH_MurmurKernel& k : c_RH_MurmurKernels)
+    {
+        if (k.sseOptimization <= (U32)g_sseOptimization && RH_HasIsa(k.isa))
+        {
+            g_RH_Kernels.murmurUpdate = k.func;
+            murmurName = k.name;
+            break;
+        }
+    }
+
+    const char* murmurStreamsName = 0;
+    for (const RH_MurmurStreamsKernel& k : c_RH_MurmurStreamsKernels)
+    {
+        if (RH_HasIsa(k.isa))
+        {
+            g_RH_Kernels.murmurStreams = k.func;
+            murmurStreamsName = k.name;
+            break;
+        }
+    }
+
+    const char* hashNames[RH_ALGO_COUNT] = { 0 };
+    for (const RH_HashKernel& k : c_RH_HashKernels)
+    {
+        if (!hashNames[k.algo] && RH_HasIsa(k.isa))
+        {
+            g_RH_Kernels.hashBatch[k.algo] = k.func;
+            hashNames[k.algo] = k.name;
+        }
+    }
+
+    if (!logKernels)
+        return;
+
+    string isaList;
+    for (U32 f = 0; f < RH_ISA_COUNT; f++)
+    {
+        if (*c_RH_IsaFlags[f])
+        {
+            isaList += " ";
+            isaList += c_RH_IsaNames[f];
+        }
+    }
+    PrintOutSilent("Kernels for%s\n", isaList.length() ? isaList.c_str() : " x86-64");
+    for (U32 i = 0; i < 8; i++)
+        PrintOutSilent("  Transfo%u      : %s\n", i, transfoNames[i]);
+    PrintOutSilent("  Murmur3 update : %s\n", murmurName);
+    PrintOutSilent("  Murmur3 lanes  : %s\n", murmurStreamsName);
+    for (U32 a = 0; a < RH_ALGO_COUNT; a++)
+        PrintOutSilent("  %-14s : %s\n", c_RH_AlgoNames[a], hashNames[a]);
+}
+
+struct RH_HashBatchQueue
+{
+    U32          usedMask;
+    U32          count[RH_ALGO_COUNT];
+    RH_StridePtr inputs[RH_ALGO_COUNT][RH_CPU_MAX_LANES];
+    RH_StridePtr outputs[RH_ALGO_COUNT][RH_CPU_MAX_LANES];
+};
+
+//same as RandomHash() but the hash itself is deferred to RandomHash_FlushBatch
+template <int in_round>
+inline void RandomHash_Queue(RandomHash_State* state, RH_HashBatchQueue& queue)
+{
+    RH_StridePtr input;
+    RH_StridePtr output;
+    U32 rndHash = _CM(RandomHash_Select)<in_round>(state, input, output);
+
+    //round 1 hashes from the header midstate don't gain from the batch, they're only one or two blocks
+    if (in_round == 1 && c_RH_HeaderMidstates[rndHash].resume)
+    {
+        c_RH_HeaderMidstates[rndHash].resume(state->m_headerMidstates[rndHash], input, output);
+        RH_STRIDE_CHECK_INTEGRITY(output);
+        return;
+    }
+
+    U32 bit = 1 << rndHash;
+    if (!(queue.usedMask & bit))
+    {
+        queue.usedMask |= bit;
+        queue.count[rndHash] = 0;
+    }
+    U32 i = queue.count[rndHash]++;
+    queue.inputs[rndHash][i] = input;
+    queue.outputs[rndHash][i] = output;
+}
+
+typedef void (*RH_RoundQueueFunc)(RandomHash_State* state, RH_HashBatchQueue& queue);
+typedef void (*RH_RoundAccumFunc)(RandomHash_State* state, RH_MurmurStreamQueue* queue);
+static const RH_RoundQueueFunc c_RH_LaneQueueFuncs[RH_N + 1] = RH_ROUND_INSTANCES(RandomHash_Queue);
+static const RH_RoundAccumFunc c_RH_LanePopAccumFuncs[RH_N + 1] = RH_ROUND_INSTANCES(RandomHash_Phase_2_pop_Accum);
+static const RH_RoundFunc c_RH_LanePopCompressFuncs[RH_N + 1] = RH_ROUND_INSTANCES(RandomHash_Phase_2_pop_Compress);
+
+inline void RandomHash_FlushBatch(RH_HashBatchQueue& queue)
+{
+    for (U32 algo = 0; algo < RH_ALGO_COUNT; algo++)
+    {
+        if (!(queue.usedMask & (1 << algo)))
+            continue;
+
+        g_RH_Kernels.hashBatch[algo](queue.inputs[algo], queue.outputs[algo], queue.count[algo]);
+#ifdef RHMINER_DEBUG_STRIDE_INTEGRITY_CHECK
+        for (U32 i = 0; i < queue.count[algo]; i++)
+            RH_STRIDE_CHECK_INTEGRITY(queue.outputs[algo][i]);
+#endif
+    }
+    queue.usedMask = 0;
+}
+
+void RandomHash_SearchLanes(RandomHash_State* states, U32 laneCount, U8* out_hashes, U32* startNonces)
+{
+    RHMINER_ASSERT(laneCount && laneCount <= RH_CPU_MAX_LANES);
+    U32 pc[RH_CPU_MAX_LANES];
+    for (U32 l = 0; l < laneCount; l++)
+    {
+        RandomHash_Init(&states[l], out_hashes + l * 32, startNonces[l]);
+        pc[l] = 0;
+    }
+
+    //round robin, one step per lane. A lane that skips its phase 1 just finishes before the others.
+    //Hash steps are queued and run grouped by algorithm at the end of each pass. The accumulator updates of the
+    //phase 2 pops are queued too, and their compress waits for the updates of all lanes
+    RH_HashBatchQueue queue;
+    queue.usedMask = 0;
+    RH_MurmurStreamQueue streams;
+    streams.count = 0;
+    static_assert(RH_CPU_MAX_LANES * 2 <= RH_MURMUR_STREAMS_MAX, "Not enough murmur streams for all lanes");
+    U32 popRound[RH_CPU_MAX_LANES];
+    U32 running = laneCount;
+    while (running)
+    {
+        running = 0;
+        U32 popMask = 0;
+        for (U32 l = 0; l < laneCount; l++)
+        {
+            if (pc[l] < c_RH_LaneProgramSize)
+            {
+                const RH_LaneStep& step = c_RH_LaneProgram[pc[l]];
+                if (step.op == RH_LANE_OP_Hash)
+                {
+                    c_RH_LaneQueueFuncs[step.arg](&states[l], queue);
+                    pc[l]++;
+                }
+                else if (step.op == RH_LANE_OP_Phase_2_pop)
+                {
+                    c_RH_LanePopAccumFuncs[step.arg](&states[l], &streams);
+                    popRound[l] = step.arg;
+                    popMask |= 1 << l;
+                    pc[l]++;
+                }
+                else
+                    pc[l] = RandomHash_LaneStep(&states[l], pc[l]);
+                running++;
+            }
+        }
+        if (queue.usedMask)
+            RandomHash_FlushBatch(queue);
+        if (streams.count)
+        {
+            g_RH_Kernels.murmurStreams(streams.streams, streams.count);
+            streams.count = 0;
+        }
+        for (U32 l = 0; l < laneCount; l++)
+            if (popMask & (1 << l))
+                c_RH_LanePopCompressFuncs[popRound[l]](&states[l]);
+    }
+
+    //same as RandomHash_Finalize, with one batched sha2 on all lanes
+    RH_StridePtr workBytes[RH_CPU_MAX_LANES];
+    RH_StridePtr finalHash[RH_CPU_MAX_LANES];
+    RH_ALIGN(RH_IDEAL_ALIGNMENT) U8 tempStrides[RH_CPU_MAX_LANES][RH_IDEAL_ALIGNMENT + 256];
+    for (U32 l = 0; l < laneCount; l++)
+    {
+        RH_STRIDE_CHECK_INTEGRITY(RH_STRIDEARRAY_GET(states[l].m_data[5].roundOutputs, 30));
+        _CM(RandomHash_Compress)(&states[l], states[l].m_data[5].roundOutputs, states[l].m_workBytes, 0);
+        RH_ASSERT(RH_STRIDE_GET_SIZE(states[l].m_workBytes) <= 100);
+        workBytes[l] = states[l].m_workBytes;
+        finalHash[l] = &tempStrides[l][0];
+    }
+
+    g_RH_Kernels.hashBatch[RH_SHA2_256](workBytes, finalHash, laneCount);
+
+    for (U32 l = 0; l < laneCount; l++)
+        memcpy(out_hashes + l * 32, RH_STRIDE_GET_DATA(finalHash[l]), 32);
+}
 
+#include "MinersLib/Pascal/RandomHash_KernelTest.h"
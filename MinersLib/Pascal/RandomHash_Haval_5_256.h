@@ -15,50 +15,10 @@
 /// @copyright Polyminer1, QualiaLibre
 
 #include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 #define SPH_SIZE_haval256_5   256
 
-#define HAVAL_RSTATE \
-		s0 = sc.s0; \
-		s1 = sc.s1; \
-		s2 = sc.s2; \
-		s3 = sc.s3; \
-		s4 = sc.s4; \
-		s5 = sc.s5; \
-		s6 = sc.s6; \
-		s7 = sc.s7; \
-
-#define HAVAL_WSTATE \
-		sc.s0 = s0; \
-		sc.s1 = s1; \
-		sc.s2 = s2; \
-		sc.s3 = s3; \
-		sc.s4 = s4; \
-		sc.s5 = s5; \
-		sc.s6 = s6; \
-		sc.s7 = s7; \
-
-#define HAVAL_SAVE_STATE \
-		u0 = s0; \
-		u1 = s1; \
-		u2 = s2; \
-		u3 = s3; \
-		u4 = s4; \
-		u5 = s5; \
-		u6 = s6; \
-		u7 = s7; \
-
-#define HAVAL_UPDATE_STATE \
-		s0 = (s0 + u0); \
-		s1 = (s1 + u1); \
-		s2 = (s2 + u2); \
-		s3 = (s3 + u3); \
-		s4 = (s4 + u4); \
-		s5 = (s5 + u5); \
-		s6 = (s6 + u6); \
-		s7 = (s7 + u7); \
-
-
 #define F1(x6, x5, x4, x3, x2, x1, x0) (((x1) & ((x0) ^ (x4))) ^ ((x2) & (x5)) ^ ((x3) & (x6)) ^ (x0))
 #define F2(x6, x5, x4, x3, x2, x1, x0) (((x2) & (((x1) & ~(x3)) ^ ((x4) & (x5)) ^ (x6) ^ (x0))) ^ ((x4) & ((x1) ^ (x5))) ^ ((x3 & (x5)) ^ (x0)))
 #define F3(x6, x5, x4, x3, x2, x1, x0) (((x3) & (((x1) & (x2)) ^ (x6) ^ (x0))) ^ ((x1) & (x4)) ^ ((x2) & (x5)) ^ (x0))
@@ -82,12 +42,13 @@
 #define FP5_5(x6, x5, x4, x3, x2, x1, x0) F5(x2, x5, x0, x6, x4, x3, x1)
 
 
+//W is the word type of Haval_5_256_Transform, uint32_t or a vector of them
 #define HAVAL_STEP(n, p, x7, x6, x5, x4, x3, x2, x1, x0, w, c)  { \
-		uint32_t t = FP ## n ## _ ## p(x6, x5, x4, x3, x2, x1, x0); \
+		W t = FP ## n ## _ ## p(x6, x5, x4, x3, x2, x1, x0); \
         (x7) = ROTR32(t, 7) + ROTR32((x7), 11) + (w) + (c); \
 	}
 
-#define HAVAL_INW(i)   *(uint32_t*)(load_ptr + 4 * (i))
+#define HAVAL_INW(i)   (in[i])
 
 #define HAVAL_PASS1(n) \
    HAVAL_STEP(n, 1, s7, s6, s5, s4, s3, s2, s1, s0, HAVAL_INW( 0), (0x00000000)); \
@@ -275,98 +236,88 @@
    HAVAL_STEP(n, 5, s1, s0, s7, s6, s5, s4, s3, s2, HAVAL_INW(25), (0xC1A94FB6)); \
    HAVAL_STEP(n, 5, s0, s7, s6, s5, s4, s3, s2, s1, HAVAL_INW(15), (0x409F60C4)); \
 
-struct RH_ALIGN(64) RH_sph_haval_context {
-	unsigned char buf[128];    /* first field, for alignment */
-	uint32_t s0, s1, s2, s3, s4, s5, s6, s7;
-	unsigned passes;
-	uint64_t count;
-};
+#define HAVAL_BLOCK_SIZE 128
 
+template <typename W>
+inline void CUDA_SYM_DECL(Haval_5_256_Transform)(W* in, W* state)
+{
+    W s0 = state[0];
+    W s1 = state[1];
+    W s2 = state[2];
+    W s3 = state[3];
+    W s4 = state[4];
+    W s5 = state[5];
+    W s6 = state[6];
+    W s7 = state[7];
+
+    HAVAL_PASS1(5);
+    HAVAL_PASS2(5);
+    HAVAL_PASS3(5);
+    HAVAL_PASS4(5);
+    HAVAL_PASS5(5);
+
+    state[0] += s0;
+    state[1] += s1;
+    state[2] += s2;
+    state[3] += s3;
+    state[4] += s4;
+    state[5] += s5;
+    state[6] += s6;
+    state[7] += s7;
+}
 
-void CUDA_SYM_DECL(RandomHash_Haval_5_256)(RH_StridePtr roundInput, RH_StridePtr output)
+//Copy the last partial block of the message in tail and pad it (haval_close). Returns the number of blocks written, 1 or 2
+inline uint32_t CUDA_SYM_DECL(Haval_5_256_PadTail)(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen)
 {
-    RH_ALIGN(64) RH_sph_haval_context sc;
-    //init
-    const unsigned passes = 5;
     const unsigned olen = 8;
-	sc.s0 = (0x243F6A88);
-	sc.s1 = (0x85A308D3);
-	sc.s2 = (0x13198A2E);
-	sc.s3 = (0x03707344);
-	sc.s4 = (0xA4093822);
-	sc.s5 = (0x299F31D0);
-	sc.s6 = (0x082EFA98);
-	sc.s7 = (0xEC4E6C89);
-	sc.passes = passes;
-	sc.count = 0;
-
-    //haval _short
-	unsigned current;
-    uint32_t s0, s1, s2, s3, s4, s5, s6, s7;
-	uint32_t u0, u1, u2, u3, u4, u5, u6, u7;
+    uint32_t blocks = 1;
+    memcpy(tail, data, len);
+    tail[len++] = 0x01;
+    if (len > 118U)
+    {
+        memset(tail + len, 0, HAVAL_BLOCK_SIZE - len);
+        tail += HAVAL_BLOCK_SIZE;
+        len = 0;
+        blocks++;
+    }
+    memset(tail + len, 0, 118U - len);
+    tail[118] = 0x01 | (5 << 3);
+    tail[119] = olen << 3;
+    *(uint64_t*)(tail + 120) = RHMINER_T64((uint64_t)totalLen << 3);
+    return blocks;
+}
 
-    const unsigned char *data = RH_STRIDE_GET_DATA(roundInput);
-    size_t len = RH_STRIDE_GET_SIZE(roundInput);
+void CUDA_SYM_DECL(RandomHash_Haval_5_256)(RH_StridePtr roundInput, RH_StridePtr output)
+{
+    RH_ALIGN(64) uint32_t state[8] = { 0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344, 0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89 };
+    RH_ALIGN(64) uint8_t tail[HAVAL_BLOCK_SIZE * 2];
 
-    uint32_t orig_len = (U32)len;
-    //haval()
-	HAVAL_RSTATE;
-	while (len >= 128U) {
-        const unsigned char *const load_ptr = (const unsigned char *)(data);
-		HAVAL_SAVE_STATE;
-		HAVAL_PASS1(5);
-		HAVAL_PASS2(5);
-		HAVAL_PASS3(5);
-		HAVAL_PASS4(5);
-		HAVAL_PASS5(5);
-		HAVAL_UPDATE_STATE;
+    uint8_t *data = RH_STRIDE_GET_DATA(roundInput);
+    uint32_t len = RH_STRIDE_GET_SIZE(roundInput);
+    uint32_t blockCount = len / HAVAL_BLOCK_SIZE;
+    for (uint32_t b = 0; b < blockCount; b++)
+        _CM(Haval_5_256_Transform)((uint32_t*)(data + b * HAVAL_BLOCK_SIZE), state);
 
-		data = (const unsigned char *)data + 128U;
-		len -= 128U;
-	}
-	HAVAL_WSTATE;
-	if (len > 0)
-		memcpy(sc.buf, data, len);
+    uint32_t tailBlocks = _CM(Haval_5_256_PadTail)(tail, data + blockCount * HAVAL_BLOCK_SIZE, len - blockCount * HAVAL_BLOCK_SIZE, len);
+    for (uint32_t b = 0; b < tailBlocks; b++)
+        _CM(Haval_5_256_Transform)((uint32_t*)(tail + b * HAVAL_BLOCK_SIZE), state);
 
-	sc.count += (uint64_t)orig_len;
+    RH_STRIDE_SET_SIZE(output, 32);
+    memcpy(RH_STRIDE_GET_DATA(output), state, 32);
+}
 
-    //haval_close
-	current = (unsigned)sc.count & 127U;
-	sc.buf[current ++] = (0x01 << 0) | ((0 & 0xFF) >> (8 - 0));
-	HAVAL_RSTATE;
-	if (current > 118U) {
-		memset(sc.buf + current, 0, 128U - current);
-        const unsigned char *const load_ptr = (const unsigned char *)(sc.buf);
-		HAVAL_SAVE_STATE;
-		HAVAL_PASS1(5);
-		HAVAL_PASS2(5);
-		HAVAL_PASS3(5);
-		HAVAL_PASS4(5);
-		HAVAL_PASS5(5);
-		HAVAL_UPDATE_STATE;
-		current = 0;
-	}
-	memset(sc.buf + current, 0, 118U - current);
-	sc.buf[118] = 0x01 | (5 << 3);
-	sc.buf[119] = olen << 3;
-	*(uint64_t*)(sc.buf + 120) = RHMINER_T64(sc.count << 3);
-    const unsigned char *const load_ptr = (const unsigned char *)(sc.buf);
-	HAVAL_SAVE_STATE;
-	HAVAL_PASS1(5);
-	HAVAL_PASS2(5);
-	HAVAL_PASS3(5);
-	HAVAL_PASS4(5);
-	HAVAL_PASS5(5);
+#if !defined(RANDOMHASH_CUDA)
+struct RH_Haval_5_256_X8
+{
+    enum { BlockSize = HAVAL_BLOCK_SIZE, StateWords = 8 };
+    static const uint32_t* IV() { static const uint32_t iv[StateWords] = { 0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344, 0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89 }; return iv; }
+    template <typename W> static void Transform(W* data, W* state) { Haval_5_256_Transform(data, state); }
+    static uint32_t PadTail(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen) { return Haval_5_256_PadTail(tail, data, len, totalLen); }
+    static void Scalar(RH_StridePtr in, RH_StridePtr out) { RandomHash_Haval_5_256(in, out); }
+};
 
-	//haval_out(sc, dst);    
-    RH_STRIDE_SET_SIZE(output, 32);
-    uint32_t* buf = (uint32_t*)RH_STRIDE_GET_DATA(output);
-	buf[0] = (s0 + u0);
-	buf[1] = (s1 + u1);
-	buf[2] = (s2 + u2);
-	buf[3] = (s3 + u3);
-	buf[4] = (s4 + u4);
-	buf[5] = (s5 + u5);
-	buf[6] = (s6 + u6);
-	buf[7] = (s7 + u7);
+inline void RandomHash_Haval_5_256_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RandomHash_MD_Batch<RH_Haval_5_256_X8>(inputs, outputs, count);
 }
+#endif //!RANDOMHASH_CUDA
@@ -0,0 +1,741 @@
+/**
+ * RandomHash hash kernels self test and benchmark
+ *
+ * Copyright 2018 Polyminer1 <https://github.com/polyminer1>
+ *
+ * To the extent possible under law, the author(s) have dedicated all copyright
+ * and related and neighboring rights to this software to the public domain
+ * worldwide. This software is distributed without any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+///
+/// @file
+/// @copyright Polyminer1
+
+//NOTE: This file is included at the end of RandomHash_Cpu.cpp
+
+#define RH_KTEST_MAX_LANES  8
+#define RH_KTEST_MAX_SIZE   1100
+
+struct RH_KernelTestEntry
+{
+    const char*         algo;
+    const char*         variant;
+    RH_HashBatchFunc    reference;  //called with all simd flags cleared
+    RH_HashBatchFunc    func;       //called with only the 'isa' flags set
+    U32                 lanes;
+    U32                 isa;
+};
+
+struct RH_KernelKAT
+{
+    RH_HashBatchFunc    func;
+    const char*         algo;
+    const char*         message;
+    const char*         digest;
+};
+
+//-smalltables is a global switch, force it for the two Whirlpool variants
+static void RH_KTest_WhirlPool_8T(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    int smallTables = g_smallHashTables;
+    g_smallHashTables = 0;
+    RH_HashBatch_Scalar<_CM(RandomHash_WhirlPool)>(inputs, outputs, count);
+    g_smallHashTables = smallTables;
+}
+static void RH_KTest_WhirlPool_1T(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    int smallTables = g_smallHashTables;
+    g_smallHashTables = 1;
+    RH_HashBatch_Scalar<_CM(RandomHash_WhirlPool)>(inputs, outputs, count);
+    g_smallHashTables = smallTables;
+}
+
+static const RH_KernelTestEntry c_RH_KernelTests[] =
+{
+    { "SHA2_256",     "scalar",   RandomHash_SHA2_256_Batch,   RandomHash_SHA2_256_Batch,          1, 0 },
+    { "SHA2_256",     "SHA-NI",   RandomHash_SHA2_256_Batch,   RandomHash_SHA2_256_Batch,          1, RH_ISA_SHA },
+    { "SHA2_256",     "AVX2 x8",  RandomHash_SHA2_256_Batch,   RandomHash_SHA2_256_AVX2x8,         8, RH_ISA_AVX2 },
+    { "SHA2_384",     "scalar",   RandomHash_SHA2_384_Batch,   RandomHash_SHA2_384_Batch,          1, 0 },
+    { "SHA2_384",     "AVX2 x4",  RandomHash_SHA2_384_Batch,   RH_SHA2_384_AVX2x4,                4, RH_ISA_AVX2 },
+    { "SHA2_512",     "scalar",   RandomHash_SHA2_512_Batch,   RandomHash_SHA2_512_Batch,          1, 0 },
+    { "SHA2_512",     "AVX2 x4",  RandomHash_SHA2_512_Batch,   RH_SHA2_512_AVX2x4,                4, RH_ISA_AVX2 },
+    { "blake2b",      "scalar",   RandomHash_blake2b_Batch,    RandomHash_blake2b_Batch,           1, 0 },
+    { "blake2b",      "SSE4",     RandomHash_blake2b_Batch,    RandomHash_blake2b_Batch,           1, RH_ISA_SSE4 },
+    { "blake2b",      "AVX2",     RandomHash_blake2b_Batch,    RandomHash_blake2b_Batch,           1, RH_ISA_AVX2 },
+    { "blake2b",      "AVX2 x4",  RandomHash_blake2b_Batch,    RandomHash_blake2b_AVX2x4,          4, RH_ISA_AVX2 },
+    { "Tiger2_5_192", "scalar",   RandomHash_Tiger2_5_192_Batch, RandomHash_Tiger2_5_192_Batch,    1, 0 },
+    { "Tiger2_5_192", "AVX2 x4",  RandomHash_Tiger2_5_192_Batch, RandomHash_Tiger2_5_192_AVX2x4,   4, RH_ISA_AVX2 },
+    { "SHA3_256",     "scalar",   RandomHash_SHA3_256_Batch,   RandomHash_SHA3_256_Batch,          1, 0 },
+    { "SHA3_256",     "AVX2 x4",  RandomHash_SHA3_256_Batch,   RandomHash_SHA3_256_Batch,          4, RH_ISA_AVX2 },
+    { "SHA3_256",     "AVX512 x4", RandomHash_SHA3_256_Batch,  RandomHash_SHA3_256_Batch,          4, RH_ISA_AVX2 | RH_ISA_AVX512 },
+    { "SHA3_384",     "scalar",   RandomHash_SHA3_384_Batch,   RandomHash_SHA3_384_Batch,          1, 0 },
+    { "SHA3_384",     "AVX2 x4",  RandomHash_SHA3_384_Batch,   RandomHash_SHA3_384_Batch,          4, RH_ISA_AVX2 },
+    { "SHA3_384",     "AVX512 x4", RandomHash_SHA3_384_Batch,  RandomHash_SHA3_384_Batch,          4, RH_ISA_AVX2 | RH_ISA_AVX512 },
+    { "SHA3_512",     "scalar",   RandomHash_SHA3_512_Batch,   RandomHash_SHA3_512_Batch,          1, 0 },
+    { "SHA3_512",     "AVX2 x4",  RandomHash_SHA3_512_Batch,   RandomHash_SHA3_512_Batch,          4, RH_ISA_AVX2 },
+    { "SHA3_512",     "AVX512 x4", RandomHash_SHA3_512_Batch,  RandomHash_SHA3_512_Batch,          4, RH_ISA_AVX2 | RH_ISA_AVX512 },
+    { "MD5",          "scalar",   RandomHash_MD5_Batch,        RandomHash_MD5_Batch,               1, 0 },
+    { "MD5",          "AVX2 x8",  RandomHash_MD5_Batch,        RandomHash_MD_X8<RH_MD5_X8>,        8, RH_ISA_AVX2 },
+    { "MD5",          "AVX2 3/8", RandomHash_MD5_Batch,        RandomHash_MD_X8<RH_MD5_X8>,        3, RH_ISA_AVX2 },
+    { "RIPEMD160",    "scalar",   RandomHash_RIPEMD160_Batch,  RandomHash_RIPEMD160_Batch,         1, 0 },
+    { "RIPEMD160",    "AVX2 x8",  RandomHash_RIPEMD160_Batch,  RandomHash_MD_X8<RH_RIPEMD160_X8>,  8, RH_ISA_AVX2 },
+    { "RIPEMD256",    "scalar",   RandomHash_RIPEMD256_Batch,  RandomHash_RIPEMD256_Batch,         1, 0 },
+    { "RIPEMD256",    "AVX2 x8",  RandomHash_RIPEMD256_Batch,  RandomHash_MD_X8<RH_RIPEMD256_X8>,  8, RH_ISA_AVX2 },
+    { "RIPEMD320",    "scalar",   RandomHash_RIPEMD320_Batch,  RandomHash_RIPEMD320_Batch,         1, 0 },
+    { "RIPEMD320",    "AVX2 x8",  RandomHash_RIPEMD320_Batch,  RandomHash_MD_X8<RH_RIPEMD320_X8>,  8, RH_ISA_AVX2 },
+    { "Haval_5_256",  "scalar",   RandomHash_Haval_5_256_Batch, RandomHash_Haval_5_256_Batch,      1, 0 },
+    { "Haval_5_256",  "AVX2 x8",  RandomHash_Haval_5_256_Batch, RandomHash_MD_X8<RH_Haval_5_256_X8>, 8, RH_ISA_AVX2 },
+    { "Grindahl512",  "scalar",   RandomHash_Grindahl512_Batch, RandomHash_Grindahl512_Batch,      1, 0 },
+    { "Grindahl512",  "AVX2 x4",  RandomHash_Grindahl512_Batch, RandomHash_Grindahl512_AVX2x4,     4, RH_ISA_AVX2 },
+    { "RadioGatun32", "scalar",   RandomHash_RadioGatun32_Batch, RandomHash_RadioGatun32_Batch,    1, 0 },
+    { "RadioGatun32", "AVX2 x8",  RandomHash_RadioGatun32_Batch, RandomHash_RadioGatun32_X8,       8, RH_ISA_AVX2 },
+    { "RadioGatun32", "AVX2 3/8", RandomHash_RadioGatun32_Batch, RandomHash_RadioGatun32_X8,       3, RH_ISA_AVX2 },
+    { "WhirlPool",    "8 tables", RH_KTest_WhirlPool_8T,       RH_KTest_WhirlPool_8T,              1, 0 },
+    { "WhirlPool",    "1 table",  RH_KTest_WhirlPool_8T,       RH_KTest_WhirlPool_1T,              1, 0 },
+};
+
+static const RH_KernelKAT c_RH_KernelKATs[] =
+{
+    { RandomHash_SHA2_256_Batch, "SHA2_256", "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { RandomHash_SHA2_384_Batch, "SHA2_384", "abc", "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7" },
+    { RandomHash_SHA2_512_Batch, "SHA2_512", "abc", "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+    { RandomHash_blake2b_Batch,  "blake2b",  "abc", "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d17d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923" },
+    { RandomHash_SHA3_256_Batch, "SHA3_256", "abc", "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532" },
+    { RandomHash_SHA3_384_Batch, "SHA3_384", "abc", "ec01498288516fc926459f58e2c6ad8df9b473cb0fc08c2596da7cf0e49be4b298d88cea927ac7f539f1edf228376d25" },
+    { RandomHash_SHA3_512_Batch, "SHA3_512", "abc", "b751850b1a57168a5693cd924b6b096e08f621827444f70d884f5d0240d2712e10e116e9192af3c91a7ec57647e3934057340b4cf408d5a56592f8274eec53f0" },
+    { RandomHash_MD5_Batch,       "MD5",       "abc", "900150983cd24fb0d6963f7d28e17f72" },
+    { RandomHash_RIPEMD160_Batch, "RIPEMD160", "abc", "8eb208f7e05d987a9b044a8e98c6b087f15a0bfc" },
+    { RandomHash_RIPEMD256_Batch, "RIPEMD256", "abc", "afbd6e228b9d8cbbcef5ca2d03e6dba10ac0bc7dcbe4680e1e42d2e975459b65" },
+    { RandomHash_RIPEMD320_Batch, "RIPEMD320", "abc", "de4c01b3054f8930a79d09ae738e92301e5a17085beffdc1b8d116713e74f82fa942d64cdbc4682d" },
+    { RandomHash_Haval_5_256_Batch, "Haval_5_256", "", "be417bb4dd5cfb76c7126f4f8eeb1553a449039307b1a3cd451dbfdc0fbbe330" },
+    { RandomHash_RadioGatun32_Batch, "RadioGatun32", "", "f30028b54afab6b3e55355d277711109a19beda7091067e9a492fb5ed9f20117" },
+    { RH_KTest_WhirlPool_8T,      "WhirlPool", "abc", "4e2448a4c6f486bb16b6562c73b4020bf3043e3a731bce721ae1b303d97e6d4c7181eebdb6c57e277d0e34957114cbd6c797fc9d95d8b582d225292076d4eef5" },
+    { RH_KTest_WhirlPool_1T,      "WhirlPool", "abc", "4e2448a4c6f486bb16b6562c73b4020bf3043e3a731bce721ae1b303d97e6d4c7181eebdb6c57e277d0e34957114cbd6c797fc9d95d8b582d225292076d4eef5" },
+};
+
+static const U32 c_RH_KernelBenchSizes[] = { 32, 64, 100, 200, 500, 1000 };
+
+
+static bool RH_KTest_SetIsa(U32 isa, const bool* realFlags)
+{
+    //only flags the cpu really has can be turned on
+    for (U32 f = 0; f < RH_ISA_COUNT; f++)
+        if ((isa & (1 << f)) && !realFlags[f])
+            return false;
+
+    for (U32 f = 0; f < RH_ISA_COUNT; f++)
+        *c_RH_IsaFlags[f] = !!(isa & (1 << f));
+    return true;
+}
+
+//Strides are reset from a pristine copy before every call since some kernels pad their input in place
+static void RH_KTest_Prepare(RH_StridePtr* strides, const U8* source, const U32* sizes, U32 count)
+{
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(strides[i], sizes[i]);
+        memcpy(RH_STRIDE_GET_DATA(strides[i]), source + i * RH_KTEST_MAX_SIZE, sizes[i]);
+    }
+}
+
+void RandomHash_TestKernels()
+{
+    bool realFlags[RH_ISA_COUNT];
+    U32 realIsa = 0;
+    string isaList;
+    for (U32 f = 0; f < RH_ISA_COUNT; f++)
+    {
+        realFlags[f] = *c_RH_IsaFlags[f];
+        if (realFlags[f])
+        {
+            realIsa |= 1 << f;
+            isaList += " ";
+            isaList += c_RH_IsaNames[f];
+        }
+    }
+    const size_t strideSize = RH_IDEAL_ALIGNMENT + ((RH_KTEST_MAX_SIZE + 256 + 63) & ~63);
+    U8* strideMem = (U8*)RH_SysAlloc(strideSize * RH_KTEST_MAX_LANES * 3);
+    U8* source = (U8*)RH_SysAlloc(RH_KTEST_MAX_SIZE * RH_KTEST_MAX_LANES);
+    RH_StridePtr inputs[RH_KTEST_MAX_LANES];
+    RH_StridePtr outputs[RH_KTEST_MAX_LANES];
+    RH_StridePtr refOutputs[RH_KTEST_MAX_LANES];
+    for (U32 i = 0; i < RH_KTEST_MAX_LANES; i++)
+    {
+        inputs[i] = strideMem + strideSize * (i * 3 + 0);
+        outputs[i] = strideMem + strideSize * (i * 3 + 1);
+        refOutputs[i] = strideMem + strideSize * (i * 3 + 2);
+    }
+
+    mersenne_twister_state rnd;
+    _CM(merssen_twister_seed)(0x4A3B9C01, &rnd);
+    for (U32 i = 0; i < RH_KTEST_MAX_SIZE * RH_KTEST_MAX_LANES; i++)
+        source[i] = (U8)_CM(merssen_twister_rand)(&rnd);
+
+    PrintOut("Hash kernels using:%s\n", isaList.c_str());
+
+    U32 failCount = 0;
+
+    //known answers, on the scalar path
+    RH_KTest_SetIsa(0, realFlags);
+    for (const RH_KernelKAT& kat : c_RH_KernelKATs)
+    {
+        U32 len = (U32)strlen(kat.message);
+        RH_KTest_Prepare(inputs, (const U8*)kat.message, &len, 1);
+        kat.func(inputs, outputs, 1);
+        string digest = toHex(RH_STRIDE_GET_DATA(outputs[0]), RH_STRIDE_GET_SIZE(outputs[0]), false);
+        if (digest != kat.digest)
+        {
+            PrintOut("KAT FAILED for %s\n", kat.algo);
+            failCount++;
+        }
+    }
+
+    //every variant against the scalar kernel, on random sizes
+    for (const RH_KernelTestEntry& test : c_RH_KernelTests)
+    {
+        if (!RH_KTest_SetIsa(test.isa, realFlags))
+        {
+            PrintOut("%-14s %-9s : not supported by this cpu\n", test.algo, test.variant);
+            continue;
+        }
+
+        U32 sizes[RH_KTEST_MAX_LANES];
+        U32 mismatch = 0;
+        for (U32 iter = 0; iter < 500; iter++)
+        {
+            for (U32 i = 0; i < test.lanes; i++)
+                sizes[i] = _CM(merssen_twister_rand)(&rnd) % (iter < 250 ? 301 : RH_KTEST_MAX_SIZE);
+
+            RH_KTest_SetIsa(0, realFlags);
+            RH_KTest_Prepare(inputs, source, sizes, test.lanes);
+            test.reference(inputs, refOutputs, test.lanes);
+
+            RH_KTest_SetIsa(test.isa, realFlags);
+            RH_KTest_Prepare(inputs, source, sizes, test.lanes);
+            test.func(inputs, outputs, test.lanes);
+
+            for (U32 i = 0; i < test.lanes; i++)
+            {
+                if (RH_STRIDE_GET_SIZE(outputs[i]) != RH_STRIDE_GET_SIZE(refOutputs[i]) ||
+                    memcmp(RH_STRIDE_GET_DATA(outputs[i]), RH_STRIDE_GET_DATA(refOutputs[i]), RH_STRIDE_GET_SIZE(refOutputs[i])))
+                    mismatch++;
+            }
+        }
+        if (mismatch)
+        {
+            PrintOut("%-14s %-9s : FAILED on %u inputs\n", test.algo, test.variant, mismatch);
+            failCount++;
+            continue;
+        }
+
+        //throughput per input size
+        string line;
+        for (U32 size : c_RH_KernelBenchSizes)
+        {
+            for (U32 i = 0; i < test.lanes; i++)
+                sizes[i] = size;
+
+            U64 bytes = 0;
+            U64 start = TimeGetMicroSec();
+            U64 elapsed = 0;
+            while (elapsed < 100000)
+            {
+                for (U32 n = 0; n < 64; n++)
+                {
+                    RH_KTest_Prepare(inputs, source, sizes, test.lanes);
+                    test.func(inputs, outputs, test.lanes);
+                }
+                bytes += 64 * size * test.lanes;
+                elapsed = TimeGetMicroSec() - start;
+            }
+            line += FormatString(" %4u:%7.1f", size, bytes / (double)elapsed);
+        }
+        PrintOut("%-14s %-9s : MB/s%s\n", test.algo, test.variant, line.c_str());
+    }
+
+    RH_KTest_SetIsa(realIsa, realFlags);
+
+    //the kernels selected in g_RH_Kernels against the scalar ones, on 1 to 8 lanes
+    for (U32 algo = 0; algo < RH_ALGO_COUNT; algo++)
+    {
+        RH_HashBatchFunc scalar = 0;
+        for (const RH_HashKernel& k : c_RH_HashKernels)
+            if (k.algo == algo && k.isa == 0)
+                scalar = k.func;
+
+        U32 sizes[RH_KTEST_MAX_LANES];
+        U32 mismatch = 0;
+        for (U32 iter = 0; iter < 200; iter++)
+        {
+            U32 lanes = 1 + (iter % RH_KTEST_MAX_LANES);
+            for (U32 i = 0; i < lanes; i++)
+                sizes[i] = _CM(merssen_twister_rand)(&rnd) % RH_KTEST_MAX_SIZE;
+
+            RH_KTest_Prepare(inputs, source, sizes, lanes);
+            scalar(inputs, refOutputs, lanes);
+            RH_KTest_Prepare(inputs, source, sizes, lanes);
+            g_RH_Kernels.hashBatch[algo](inputs, outputs, lanes);
+            for (U32 i = 0; i < lanes; i++)
+            {
+                if (RH_STRIDE_GET_SIZE(outputs[i]) != RH_STRIDE_GET_SIZE(refOutputs[i]) ||
+                    memcmp(RH_STRIDE_GET_DATA(outputs[i]), RH_STRIDE_GET_DATA(refOutputs[i]), RH_STRIDE_GET_SIZE(refOutputs[i])))
+                    mismatch++;
+            }
+        }
+        if (mismatch)
+        {
+            PrintOut("%-14s dispatch  : FAILED on %u inputs\n", c_RH_AlgoNames[algo], mismatch);
+            failCount++;
+        }
+    }
+
+    //Transfo variants against the scalar ones. The chunk is written right after its source, like in RandomHash_Expand
+    U8* transfoMem = (U8*)RH_SysAlloc(RH_KTEST_MAX_SIZE * 2 * 3);
+    U8* transfoSrc = transfoMem + RH_KTEST_MAX_SIZE * 2;
+    U8* transfoRef = transfoMem + RH_KTEST_MAX_SIZE * 4;
+    for (const RH_TransfoKernel& k : c_RH_TransfoKernels)
+    {
+        if (k.isa == 0)
+            continue;
+        if (!RH_HasIsa(k.isa))
+        {
+            PrintOut("Transfo%u       %-9s : not supported by this cpu\n", k.slot, k.name);
+            continue;
+        }
+        RH_TransfoFunc scalar = 0;
+        for (const RH_TransfoKernel& r : c_RH_TransfoKernels)
+            if (r.slot == k.slot && r.isa == 0)
+                scalar = r.func;
+
+        U32 mismatch = 0;
+        for (U32 iter = 0; iter < 500; iter++)
+        {
+            U32 size = (2 + _CM(merssen_twister_rand)(&rnd) % (iter < 250 ? 160 : RH_KTEST_MAX_SIZE - 2)) & ~1;
+            memcpy(transfoSrc, source, size);
+            scalar(transfoSrc + size, size, transfoSrc);
+            memcpy(transfoRef, transfoSrc + size, size);
+
+            memcpy(transfoMem, source, size);
+            k.func(transfoMem + size, size, transfoMem);
+            if (memcmp(transfoMem + size, transfoRef, size))
+                mismatch++;
+        }
+        if (mismatch)
+        {
+            PrintOut("Transfo%u       %-9s : FAILED on %u inputs\n", k.slot, k.name, mismatch);
+            failCount++;
+            continue;
+        }
+
+        string line;
+        for (U32 size : c_RH_KernelBenchSizes)
+        {
+            U64 bytes = 0;
+            U64 start = TimeGetMicroSec();
+            U64 elapsed = 0;
+            while (elapsed < 50000)
+            {
+                for (U32 n = 0; n < 256; n++)
+                    k.func(transfoMem + size, size, transfoMem);
+                bytes += 256 * size;
+                elapsed = TimeGetMicroSec() - start;
+            }
+            start = TimeGetMicroSec();
+            U64 refBytes = 0;
+            elapsed = 0;
+            while (elapsed < 50000)
+            {
+                for (U32 n = 0; n < 256; n++)
+                    scalar(transfoMem + size, size, transfoMem);
+                refBytes += 256 * size;
+                elapsed = TimeGetMicroSec() - start;
+            }
+            line += FormatString(" %4u: x%4.2f", size, bytes / (double)refBytes);
+        }
+        PrintOut("Transfo%u       %-9s : speedup%s\n", k.slot, k.name, line.c_str());
+    }
+    RH_SysFree(transfoMem);
+
+    //Murmur3 accumulator updates against the scalar one, alone and with the second accumulator
+    RH_StrideArrayStruct* arrays = (RH_StrideArrayStruct*)RH_SysAlloc(sizeof(RH_StrideArrayStruct) * 4);
+    RH_MurmurUpdateFunc murmurScalar = 0;
+    for (const RH_MurmurKernel& r : c_RH_MurmurKernels)
+        if (r.isa == 0)
+            murmurScalar = r.func;
+    for (const RH_MurmurKernel& k : c_RH_MurmurKernels)
+    {
+        if (k.isa == 0)
+            continue;
+        if (!RH_HasIsa(k.isa))
+        {
+            PrintOut("Murmur3 update %-9s : not supported by this cpu\n", k.name);
+            continue;
+        }
+
+        U32 mismatch = 0;
+        for (U32 iter = 0; iter < 500; iter++)
+        {
+            U32 size = 8 + _CM(merssen_twister_rand)(&rnd) % (RH_KTEST_MAX_SIZE - 8);
+            RH_KTest_Prepare(inputs, source, &size, 1);
+            for (U32 a = 0; a < 4; a++)
+            {
+                arrays[a] = RH_StrideArrayStruct();
+                arrays[a].maxSize = RH_StrideArrayCount;
+                arrays[a].accum.h1 = iter * 0x9E3779B9;
+                arrays[a].accum.totalLen = iter;
+            }
+            arrays[0].size = arrays[2].size = 1;
+            arrays[0].strides[0] = arrays[2].strides[0] = inputs[0];
+
+            U8* duo = (iter & 1) ? (U8*)&arrays[1] : 0;
+            murmurScalar((U8*)&arrays[0], 0, duo);
+            duo = (iter & 1) ? (U8*)&arrays[3] : 0;
+            k.func((U8*)&arrays[2], 0, duo);
+            if (memcmp(&arrays[0].accum, &arrays[2].accum, sizeof(MurmurHash3_x86_32_State)) ||
+                memcmp(&arrays[1].accum, &arrays[3].accum, sizeof(MurmurHash3_x86_32_State)) ||
+                arrays[1].size != arrays[3].size)
+                mismatch++;
+        }
+        if (mismatch)
+        {
+            PrintOut("Murmur3 update %-9s : FAILED on %u inputs\n", k.name, mismatch);
+            failCount++;
+            continue;
+        }
+
+        string line;
+        for (U32 size : c_RH_KernelBenchSizes)
+        {
+            RH_KTest_Prepare(inputs, source, &size, 1);
+            double speed[2];
+            for (U32 v = 0; v < 2; v++)
+            {
+                RH_MurmurUpdateFunc func = v ? murmurScalar : k.func;
+                U64 bytes = 0;
+                U64 start = TimeGetMicroSec();
+                U64 elapsed = 0;
+                while (elapsed < 50000)
+                {
+                    for (U32 n = 0; n < 256; n++)
+                    {
+                        arrays[0].accum.idx = 0;
+                        func((U8*)&arrays[0], 0, 0);
+                    }
+                    bytes += 256 * size;
+                    elapsed = TimeGetMicroSec() - start;
+                }
+                speed[v] = bytes / (double)elapsed;
+            }
+            line += FormatString(" %4u: x%4.2f", size, speed[0] / speed[1]);
+        }
+        PrintOut("Murmur3 update %-9s : speedup%s\n", k.name, line.c_str());
+    }
+    RH_SysFree(arrays);
+
+    //Murmur3 streams of many lanes against the scalar updates, with pending bytes and strides of any even size
+    for (const RH_MurmurStreamsKernel& k : c_RH_MurmurStreamsKernels)
+    {
+        if (k.isa == 0)
+            continue;
+        if (!RH_HasIsa(k.isa))
+        {
+            PrintOut("Murmur3 lanes  %-9s : not supported by this cpu\n", k.name);
+            continue;
+        }
+
+        RH_StridePtr streamStrides[RH_MURMUR_STREAMS_MAX][3];
+        RH_MurmurStream streams[RH_MURMUR_STREAMS_MAX];
+        MurmurHash3_x86_32_State accums[2][RH_MURMUR_STREAMS_MAX];
+        U32 mismatch = 0;
+        for (U32 iter = 0; iter < 500; iter++)
+        {
+            U32 sizes[RH_KTEST_MAX_LANES];
+            for (U32 i = 0; i < RH_KTEST_MAX_LANES; i++)
+                sizes[i] = 2 + (_CM(merssen_twister_rand)(&rnd) % (RH_KTEST_MAX_SIZE - 2) & ~1);
+            RH_KTest_Prepare(inputs, source, sizes, RH_KTEST_MAX_LANES);
+
+            U32 count = 1 + iter % RH_MURMUR_STREAMS_MAX;
+            for (U32 i = 0; i < count; i++)
+            {
+                U32 strideCount = 1 + _CM(merssen_twister_rand)(&rnd) % 3;
+                for (U32 j = 0; j < strideCount; j++)
+                    streamStrides[i][j] = inputs[_CM(merssen_twister_rand)(&rnd) % RH_KTEST_MAX_LANES];
+                streams[i].strides = streamStrides[i];
+                streams[i].count = strideCount;
+
+                _CM(MurmurHash3_x86_32_Init)(0, &accums[0][i]);
+                accums[0][i].h1 = _CM(merssen_twister_rand)(&rnd);
+                _CM(MurmurHash3_x86_32_Update)(source + i, _CM(merssen_twister_rand)(&rnd) % 4, &accums[0][i]);
+                accums[1][i] = accums[0][i];
+            }
+            for (U32 v = 0; v < 2; v++)
+            {
+                for (U32 i = 0; i < count; i++)
+                    streams[i].accum = &accums[v][i];
+                if (v)
+                    RH_Murmur3UpdateStreams_Scalar(streams, count);
+                else
+                    k.func(streams, count);
+            }
+            if (memcmp(accums[0], accums[1], sizeof(MurmurHash3_x86_32_State) * count))
+                mismatch++;
+        }
+        if (mismatch)
+        {
+            PrintOut("Murmur3 lanes  %-9s : FAILED on %u inputs\n", k.name, mismatch);
+            failCount++;
+            continue;
+        }
+
+        //4 lanes of one stride each, as in RandomHash_SearchLanes
+        string line;
+        for (U32 size : c_RH_KernelBenchSizes)
+        {
+            U32 sizes[4] = { size, size, size, size };
+            RH_KTest_Prepare(inputs, source, sizes, 4);
+            for (U32 i = 0; i < 4; i++)
+            {
+                streams[i].strides = inputs + i;
+                streams[i].count = 1;
+                streams[i].accum = &accums[0][i];
+                _CM(MurmurHash3_x86_32_Init)(0, &accums[0][i]);
+            }
+            double speed[2];
+            for (U32 v = 0; v < 2; v++)
+            {
+                RH_MurmurStreamsFunc func = v ? RH_Murmur3UpdateStreams_Scalar : k.func;
+                U64 bytes = 0;
+                U64 start = TimeGetMicroSec();
+                U64 elapsed = 0;
+                while (elapsed < 50000)
+                {
+                    for (U32 n = 0; n < 256; n++)
+                        func(streams, 4);
+                    bytes += 256 * 4 * size;
+                    elapsed = TimeGetMicroSec() - start;
+                }
+                speed[v] = bytes / (double)elapsed;
+            }
+            line += FormatString(" %4u: x%4.2f", size, speed[0] / speed[1]);
+        }
+        PrintOut("Murmur3 lanes  %-9s : speedup%s\n", k.name, line.c_str());
+    }
+
+    //Round 1 header midstates against the full scalar hash of the header, on random headers and nonces
+    {
+        RH_ALIGN(64) U8 header[PascalHeaderSize];
+        RH_ALIGN(64) U8 midstate[RH_HEADER_MIDSTATE_SIZE];
+        RH_KTest_SetIsa(realIsa, realFlags);
+        for (U32 algo = 0; algo < RH_ALGO_COUNT; algo++)
+        {
+            const RH_HeaderMidstateKernel& k = c_RH_HeaderMidstates[algo];
+            if (!k.prefix)
+                continue;
+            RH_HashBatchFunc scalar = 0;
+            for (const RH_HashKernel& h : c_RH_HashKernels)
+                if (h.algo == algo && h.isa == 0)
+                    scalar = h.func;
+
+            U32 mismatch = 0;
+            for (U32 iter = 0; iter < 64; iter++)
+            {
+                for (U32 i = 0; i < PascalHeaderSize; i++)
+                    header[i] = (U8)_CM(merssen_twister_rand)(&rnd);
+                k.prefix(header, midstate);
+                for (U32 n = 0; n < 8; n++)
+                {
+                    U32 size = PascalHeaderSize;
+                    *(U32*)(header + PascalHeaderNoncePosV4(PascalHeaderSize)) = _CM(merssen_twister_rand)(&rnd);
+                    RH_KTest_Prepare(inputs, header, &size, 1);
+                    scalar(inputs, refOutputs, 1);
+                    RH_KTest_Prepare(inputs, header, &size, 1);
+                    k.resume(midstate, inputs[0], outputs[0]);
+                    if (RH_STRIDE_GET_SIZE(outputs[0]) != RH_STRIDE_GET_SIZE(refOutputs[0]) ||
+                        memcmp(RH_STRIDE_GET_DATA(outputs[0]), RH_STRIDE_GET_DATA(refOutputs[0]), RH_STRIDE_GET_SIZE(refOutputs[0])))
+                        mismatch++;
+                }
+            }
+            if (mismatch)
+            {
+                PrintOut("%-14s midstate  : FAILED on %u headers\n", c_RH_AlgoNames[algo], mismatch);
+                failCount++;
+            }
+        }
+    }
+
+    //Mersenne twister : the simd twist and tempering against the scalar stream, 1M outputs over 256 seeds,
+    //through the full generator, the lazy one and the batched lazy draws
+    {
+        const U32 SeedCount = 256;
+        const U32 DrawCount = 4096;
+        U32* refStream = (U32*)RH_SysAlloc(DrawCount * 4 * 2);
+        U32* stream = refStream + DrawCount;
+        mersenne_twister_state* gen = (mersenne_twister_state*)RH_SysAlloc(sizeof(mersenne_twister_state));
+        for (U32 v = 0; v < 3; v++)
+        {
+            static const char* const names[] = { "scalar", "SSE4", "AVX2" };
+            static const U32 isas[] = { 0, RH_ISA_SSE4, RH_ISA_AVX2 };
+            if (!RH_KTest_SetIsa(isas[v], realFlags))
+            {
+                PrintOut("MersenneTwister %-8s : not supported by this cpu\n", names[v]);
+                continue;
+            }
+
+            U32 mismatch = 0;
+            for (U32 seed = 0; seed < SeedCount; seed++)
+            {
+                U32 seedValue = seed * 0x9E3779B9 + 1;
+                RH_KTest_SetIsa(0, realFlags);
+                _CM(merssen_twister_seed)(seedValue, gen);
+                for (U32 i = 0; i < DrawCount; i++)
+                    refStream[i] = _CM(merssen_twister_rand)(gen);
+                RH_KTest_SetIsa(isas[v], realFlags);
+
+                _CM(merssen_twister_seed)(seedValue, gen);
+                for (U32 i = 0; i < DrawCount; i++)
+                    stream[i] = _CM(merssen_twister_rand)(gen);
+                mismatch += memcmp(stream, refStream, DrawCount * 4) != 0;
+
+                _CM(merssen_twister_seed_lazy)(seedValue, gen);
+                for (U32 i = 0; i < DrawCount; i++)
+                    stream[i] = _CM(merssen_twister_rand_lazy)(gen);
+                mismatch += memcmp(stream, refStream, DrawCount * 4) != 0;
+
+                //batches of any size, mixed with single draws
+                _CM(merssen_twister_seed_lazy)(seedValue, gen);
+                for (U32 i = 0; i < DrawCount;)
+                {
+                    U32 n = RH_Min(DrawCount - i, (i * 7 + seed) % 300);
+                    if (n)
+                        _CM(merssen_twister_rand_many_lazy)(gen, stream + i, n);
+                    else
+                        stream[i++] = _CM(merssen_twister_rand_lazy)(gen);
+                    i += n;
+                }
+                mismatch += memcmp(stream, refStream, DrawCount * 4) != 0;
+            }
+            if (mismatch)
+            {
+                PrintOut("MersenneTwister %-8s : FAILED on %u streams\n", names[v], mismatch);
+                failCount++;
+                continue;
+            }
+
+            //a reseed and the 200 draws of RandomHash_Compress, then a full generation
+            U64 count[2] = { 0, 0 };
+            for (U32 b = 0; b < 2; b++)
+            {
+                U64 start = TimeGetMicroSec();
+                U64 elapsed = 0;
+                while (elapsed < 50000)
+                {
+                    for (U32 n = 0; n < 256; n++)
+                    {
+                        if (b == 0)
+                        {
+                            _CM(merssen_twister_seed_lazy)(n, gen);
+                            _CM(merssen_twister_rand_many_lazy)(gen, stream, 200);
+                        }
+                        else
+                        {
+                            gen->index = MERSENNE_TWISTER_SIZE;
+                            stream[n] = _CM(merssen_twister_rand)(gen);
+                        }
+                    }
+                    count[b] += 256;
+                    elapsed = TimeGetMicroSec() - start;
+                }
+                count[b] = count[b] * 1000000 / elapsed;
+            }
+            PrintOut("MersenneTwister %-8s : %llu reseed+200/s, %llu generations/s\n", names[v], count[0], count[1]);
+        }
+        RH_KTest_SetIsa(realIsa, realFlags);
+        RH_SysFree(gen);
+        RH_SysFree(refStream);
+    }
+
+    //Full searches : a known digest, then RandomHash_SearchLanes against RandomHash_Search on chained searches, so c_RH_LaneProgram
+    //stays in sync with RandomHash_Block0. At every isa level, with the kernel table rebuilt for it
+    {
+        const U32 HeaderCount = 3;
+        const U32 ChainLength = 8;
+        static const U32 isaMasks[] = { ~0U, ~(U32)(RH_ISA_AVX512 | RH_ISA_SHA), ~(U32)(RH_ISA_AVX512 | RH_ISA_SHA | RH_ISA_AVX2), 0 };
+        static const char* const isaLevels[] = { "all", "no AVX512/SHA", "no AVX2", "scalar" };
+        int savedAbandon = g_cpuAbandon;
+        g_cpuAbandon = 0;
+
+        U8 header[PascalHeaderSize];
+        U8 hash[32];
+        U8 laneHashes[RH_CPU_MAX_LANES * 32];
+        U32 laneNonces[RH_CPU_MAX_LANES];
+        RandomHash_State* laneStates = 0;
+        RandomHash_State* refStates = 0;
+        RandomHash_CreateMany(&laneStates, RH_CPU_MAX_LANES);
+        RandomHash_CreateMany(&refStates, RH_CPU_MAX_LANES);
+        for (U32 v = 0; v < RHMINER_ARRAY_COUNT(isaMasks); v++)
+        {
+            RH_KTest_SetIsa(realIsa & isaMasks[v], realFlags);
+            RandomHash_InitKernelTable(false);
+
+            for (U32 i = 0; i < PascalHeaderSize; i++)
+                header[i] = (U8)(i * 13 + 7);
+            RandomHash_SetHeader(&refStates[0], header, 0);
+            RandomHash_Search(&refStates[0], hash, 0x12345678);
+            if (toHex(hash, 32, false) != "5f3a16556d076339eed26cc3be2997b17960f5eeea32200e51d999d8a7ab1d76")
+            {
+                PrintOut("RandomHash     %-13s : KAT FAILED, %s\n", isaLevels[v], toHex(hash, 32, false).c_str());
+                failCount++;
+            }
+
+            U32 mismatch = 0;
+            for (U32 laneCount = 2; laneCount <= RH_CPU_MAX_LANES; laneCount++)
+            {
+                for (U32 h = 0; h < HeaderCount; h++)
+                {
+                    for (U32 i = 0; i < PascalHeaderSize; i++)
+                        header[i] = (U8)_CM(merssen_twister_rand)(&rnd);
+                    for (U32 l = 0; l < laneCount; l++)
+                    {
+                        RandomHash_SetHeader(&laneStates[l], header, h);
+                        RandomHash_SetHeader(&refStates[l], header, h);
+                    }
+                    for (U32 n = 0; n < ChainLength; n++)
+                    {
+                        for (U32 l = 0; l < laneCount; l++)
+                            laneNonces[l] = _CM(merssen_twister_rand)(&rnd);
+                        RandomHash_SearchLanes(laneStates, laneCount, laneHashes, laneNonces);
+                        for (U32 l = 0; l < laneCount; l++)
+                        {
+                            RandomHash_Search(&refStates[l], hash, laneNonces[l]);
+                            if (memcmp(hash, laneHashes + l * 32, 32) || laneStates[l].m_startNonce != refStates[l].m_startNonce)
+                                mismatch++;
+                        }
+                    }
+                }
+            }
+            if (mismatch)
+            {
+                PrintOut("RandomHash     %-13s : lanes FAILED on %u searches\n", isaLevels[v], mismatch);
+                failCount++;
+            }
+            else
+                PrintOut("RandomHash     %-13s : lanes 2 to %u match the serial search\n", isaLevels[v], RH_CPU_MAX_LANES);
+        }
+        RandomHash_DestroyMany(laneStates, RH_CPU_MAX_LANES);
+        RandomHash_DestroyMany(refStates, RH_CPU_MAX_LANES);
+        RH_KTest_SetIsa(realIsa, realFlags);
+        RandomHash_InitKernelTable(false);
+        g_cpuAbandon = savedAbandon;
+    }
+
+    RH_SysFree(strideMem);
+    RH_SysFree(source);
+
+    if (failCount)
+        PrintOut("Kernel test FAILED (%u errors)\n", failCount);
+    else
+        PrintOut("Kernel test passed\n");
+}
@@ -16,6 +16,7 @@
 
 
 #include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 #define MD5_BLOCKSIZE 64
 
@@ -70,9 +71,10 @@ PLATFORM_CONST uint32_t MD5_d0 = 0x10325476;
 
 
 
-void CUDA_SYM_DECL(md5)(uint32_t *in, uint32_t *state) 
+template <typename W>
+inline void CUDA_SYM_DECL(md5)(W *in, W *state) 
 {
-    uint32_t a, b, c, d;
+    W a, b, c, d;
 
     a = state[0];
     b = state[1];
@@ -205,3 +207,19 @@ void CUDA_SYM_DECL(RandomHash_MD5)(RH_StridePtr roundInput, RH_StridePtr output)
     memcpy(RH_STRIDE_GET_DATA(output), state, 16);
     RH_STRIDE_SET_SIZE(output, 16);
 }
+
+#if !defined(RANDOMHASH_CUDA)
+struct RH_MD5_X8
+{
+    enum { BlockSize = MD5_BLOCKSIZE, StateWords = 4 };
+    static const uint32_t* IV() { static const uint32_t iv[StateWords] = { MD5_a0, MD5_b0, MD5_c0, MD5_d0 }; return iv; }
+    template <typename W> static void Transform(W* data, W* state) { md5(data, state); }
+    static uint32_t PadTail(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen) { return RH_MD_PadTail(tail, data, len, totalLen, BlockSize); }
+    static void Scalar(RH_StridePtr in, RH_StridePtr out) { RandomHash_MD5(in, out); }
+};
+
+inline void RandomHash_MD5_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RandomHash_MD_Batch<RH_MD5_X8>(inputs, outputs, count);
+}
+#endif //!RANDOMHASH_CUDA
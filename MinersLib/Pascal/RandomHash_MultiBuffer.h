@@ -0,0 +1,243 @@
+/**
+ *
+ * Copyright 2018 Polyminer1 <https://github.com/polyminer1>
+ *
+ * To the extent possible under law, the author(s) have dedicated all copyright
+ * and related and neighboring rights to this software to the public domain
+ * worldwide. This software is distributed without any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+///
+/// @file
+/// @copyright Polyminer1, QualiaLibre
+
+#pragma once
+
+#include "RandomHash_core.h"
+
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isAVX2Supported;
+
+//Multi-buffer engine for the 32 bit MD family hashes (MD5, RIPEMD, Haval).
+//Each word of the state holds the same word of 8 independent messages, one per 32 bit lane, so the scalar
+//transforms, written as templates over their word type, hash 8 messages per call when given RH_U32x8 words.
+//
+//An ALGO descriptor provides :
+//  BlockSize, StateWords             : block size in bytes and state size in words, the state is the digest
+//  IV()                              : the initial state
+//  Transform<W>(W* data, W* state)   : the compression function
+//  PadTail(tail, data, len, totalLen): copy and pad the last partial block in tail, return the number of blocks written
+//  Scalar(in, out)                   : the single buffer hash
+#if defined(_MSC_VER)
+struct RH_U32x8
+{
+    __m256i v;
+    RH_U32x8() {}
+    RH_U32x8(__m256i x) : v(x) {}
+    RH_U32x8(uint32_t x) : v(_mm256_set1_epi32((int)x)) {}
+    RH_U32x8& operator+=(const RH_U32x8& x) { v = _mm256_add_epi32(v, x.v); return *this; }
+};
+inline RH_U32x8 operator+(const RH_U32x8& a, const RH_U32x8& b) { return _mm256_add_epi32(a.v, b.v); }
+inline RH_U32x8 operator^(const RH_U32x8& a, const RH_U32x8& b) { return _mm256_xor_si256(a.v, b.v); }
+inline RH_U32x8 operator&(const RH_U32x8& a, const RH_U32x8& b) { return _mm256_and_si256(a.v, b.v); }
+inline RH_U32x8 operator|(const RH_U32x8& a, const RH_U32x8& b) { return _mm256_or_si256(a.v, b.v); }
+inline RH_U32x8 operator~(const RH_U32x8& a) { return _mm256_xor_si256(a.v, _mm256_set1_epi32(-1)); }
+inline RH_U32x8 operator<<(const RH_U32x8& a, int n) { return _mm256_slli_epi32(a.v, n); }
+inline RH_U32x8 operator>>(const RH_U32x8& a, int n) { return _mm256_srli_epi32(a.v, n); }
+#define RH_U32X8_FROM_M256(x)   RH_U32x8(x)
+#define RH_U32X8_TO_M256(x)     ((x).v)
+#else
+//gcc/clang vector extension : the builtin operators take the isa of the function they are inlined into
+typedef uint32_t RH_U32x8 __attribute__((vector_size(32)));
+#define RH_U32X8_FROM_M256(x)   ((RH_U32x8)(x))
+#define RH_U32X8_TO_M256(x)     ((__m256i)(x))
+#endif
+
+//load 8 consecutive words of 8 messages, one message per lane
+RH_TARGET_ISA("avx2")
+inline void RH_U32x8_LoadTransposed(const uint8_t* const* msg, uint32_t offset, RH_U32x8* out)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i*)(msg[0] + offset));
+    __m256i r1 = _mm256_loadu_si256((const __m256i*)(msg[1] + offset));
+    __m256i r2 = _mm256_loadu_si256((const __m256i*)(msg[2] + offset));
+    __m256i r3 = _mm256_loadu_si256((const __m256i*)(msg[3] + offset));
+    __m256i r4 = _mm256_loadu_si256((const __m256i*)(msg[4] + offset));
+    __m256i r5 = _mm256_loadu_si256((const __m256i*)(msg[5] + offset));
+    __m256i r6 = _mm256_loadu_si256((const __m256i*)(msg[6] + offset));
+    __m256i r7 = _mm256_loadu_si256((const __m256i*)(msg[7] + offset));
+
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    r0 = _mm256_unpacklo_epi64(t0, t2);
+    r1 = _mm256_unpackhi_epi64(t0, t2);
+    r2 = _mm256_unpacklo_epi64(t1, t3);
+    r3 = _mm256_unpackhi_epi64(t1, t3);
+    r4 = _mm256_unpacklo_epi64(t4, t6);
+    r5 = _mm256_unpackhi_epi64(t4, t6);
+    r6 = _mm256_unpacklo_epi64(t5, t7);
+    r7 = _mm256_unpackhi_epi64(t5, t7);
+
+    out[0] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r0, r4, 0x20));
+    out[1] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r1, r5, 0x20));
+    out[2] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r2, r6, 0x20));
+    out[3] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r3, r7, 0x20));
+    out[4] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r0, r4, 0x31));
+    out[5] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r1, r5, 0x31));
+    out[6] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r2, r6, 0x31));
+    out[7] = RH_U32X8_FROM_M256(_mm256_permute2x128_si256(r3, r7, 0x31));
+}
+
+//MD4 style padding : 0x80, zeros then the 64 bit LE bit length at the end of the last block
+inline uint32_t RH_MD_PadTail(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen, uint32_t blockSize)
+{
+    uint32_t blocks = len < blockSize - 8 ? 1 : 2;
+    uint32_t end = blocks * blockSize;
+    memcpy(tail, data, len);
+    tail[len] = 0x80;
+    memset(tail + len + 1, 0, end - 8 - len - 1);
+    ReadUInt64AsBytesLE((uint64_t)totalLen * 8, tail + end - 8);
+    return blocks;
+}
+
+//Up to 8 messages of any size. The inputs are not modified, the padded last blocks are built in a local buffer.
+//Lanes that ran out of blocks hash a zero block and keep their state
+template <typename ALGO>
+RH_TARGET_ISA("avx2") RH_FLATTEN
+inline void RandomHash_MD_X8(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    const uint32_t BlockSize = ALGO::BlockSize;
+    RH_ALIGN(64) static const uint8_t zeroBlock[ALGO::BlockSize] = { 0 };
+    RH_ALIGN(64) uint8_t tail[8][ALGO::BlockSize * 2];
+    RH_ALIGN(32) uint32_t blockCount[8];
+    RH_ALIGN(32) uint32_t result[ALGO::StateWords][8];
+    const uint8_t* dataPtr[8];
+    uint32_t fullBlocks[8];
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 8; i++)
+    {
+        if (i < count)
+        {
+            uint32_t len = RH_STRIDE_GET_SIZE(inputs[i]);
+            dataPtr[i] = RH_STRIDE_GET_DATA(inputs[i]);
+            fullBlocks[i] = len / BlockSize;
+            blockCount[i] = fullBlocks[i] + ALGO::PadTail(tail[i], dataPtr[i] + fullBlocks[i] * BlockSize, len - fullBlocks[i] * BlockSize, len);
+        }
+        else
+        {
+            fullBlocks[i] = 0;
+            blockCount[i] = 0;
+            dataPtr[i] = zeroBlock;
+        }
+        if (blockCount[i] > maxBlocks)
+            maxBlocks = blockCount[i];
+    }
+
+    RH_U32x8 state[ALGO::StateWords];
+    for (U32 k = 0; k < ALGO::StateWords; k++)
+        state[k] = RH_U32X8_FROM_M256(_mm256_set1_epi32((int)ALGO::IV()[k]));
+
+    const __m256i blocks = _mm256_load_si256((const __m256i*)blockCount);
+    for (uint32_t b = 0; b < maxBlocks; b++)
+    {
+        const uint8_t* m[8];
+        for (U32 i = 0; i < 8; i++)
+        {
+            if (b < fullBlocks[i])
+                m[i] = dataPtr[i] + b * BlockSize;
+            else if (b < blockCount[i])
+                m[i] = tail[i] + (b - fullBlocks[i]) * BlockSize;
+            else
+                m[i] = zeroBlock;
+        }
+
+        RH_U32x8 data[ALGO::BlockSize / 4];
+        for (U32 w = 0; w < BlockSize / 4; w += 8)
+            RH_U32x8_LoadTransposed(m, w * 4, data + w);
+
+        RH_U32x8 prev[ALGO::StateWords];
+        for (U32 k = 0; k < ALGO::StateWords; k++)
+            prev[k] = state[k];
+
+        ALGO::Transform(data, state);
+
+        const RH_U32x8 active = RH_U32X8_FROM_M256(_mm256_cmpgt_epi32(blocks, _mm256_set1_epi32((int)b)));
+        for (U32 k = 0; k < ALGO::StateWords; k++)
+            state[k] = (state[k] & active) | (prev[k] & ~active);
+    }
+
+    for (U32 k = 0; k < ALGO::StateWords; k++)
+        _mm256_store_si256((__m256i*)result[k], RH_U32X8_TO_M256(state[k]));
+
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(outputs[i], ALGO::StateWords * 4);
+        uint32_t* out = (uint32_t*)RH_STRIDE_GET_DATA(outputs[i]);
+        for (U32 k = 0; k < ALGO::StateWords; k++)
+            out[k] = result[k][i];
+    }
+}
+
+template <typename ALGO>
+inline void RandomHash_MD_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 8)
+            RandomHash_MD_X8<ALGO>(inputs + i, outputs + i, RH_Min(count - i, 8U));
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            ALGO::Scalar(inputs[i], outputs[i]);
+    }
+}
+
+//Round 1 header midstate of an ALGO : the state after the blocks before the nonce, then the rest of the header from it
+template <typename ALGO>
+inline void RH_MD_HeaderPrefix(const uint8_t* header, uint8_t* midstate)
+{
+    RH_ALIGN(64) uint32_t block[ALGO::BlockSize / 4];
+    uint32_t* state = (uint32_t*)midstate;
+    memcpy(state, ALGO::IV(), ALGO::StateWords * 4);
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(ALGO::BlockSize); b += ALGO::BlockSize)
+    {
+        memcpy(block, header + b, ALGO::BlockSize);
+        ALGO::Transform(block, state);
+    }
+}
+
+template <typename ALGO>
+inline void RH_MD_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output)
+{
+    const uint32_t BlockSize = ALGO::BlockSize;
+    const uint32_t prefix = PascalHeaderPrefixSize(BlockSize);
+    RH_ALIGN(64) uint32_t state[ALGO::StateWords];
+    RH_ALIGN(64) uint8_t tail[ALGO::BlockSize * 2];
+    memcpy(state, midstate, sizeof(state));
+
+    uint32_t totalLen = RH_STRIDE_GET_SIZE(roundInput);
+    uint8_t* data = RH_STRIDE_GET_DATA(roundInput) + prefix;
+    uint32_t len = totalLen - prefix;
+    uint32_t blockCount = len / BlockSize;
+    for (uint32_t b = 0; b < blockCount; b++)
+        ALGO::Transform((uint32_t*)(data + b * BlockSize), state);
+
+    uint32_t tailBlocks = ALGO::PadTail(tail, data + blockCount * BlockSize, len - blockCount * BlockSize, totalLen);
+    for (uint32_t b = 0; b < tailBlocks; b++)
+        ALGO::Transform((uint32_t*)(tail + b * BlockSize), state);
+
+    RH_STRIDE_SET_SIZE(output, ALGO::StateWords * 4);
+    memcpy(RH_STRIDE_GET_DATA(output), state, ALGO::StateWords * 4);
+}
+
+#endif //!RANDOMHASH_CUDA
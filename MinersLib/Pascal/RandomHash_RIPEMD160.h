@@ -15,12 +15,14 @@
 /// @copyright Polyminer1, QualiaLibre
 
 #include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 #define RIPEMD160_BLOCK_SIZE 64
 
-inline void CUDA_SYM_DECL(Ripemd160RoundFunction)(uint32_t* data, uint32_t* state)
+template <typename W>
+inline void CUDA_SYM_DECL(Ripemd160RoundFunction)(W* data, W* state)
 {
-	uint32_t a, b, c, d, e, aa, bb, cc, dd, ee;
+	W a, b, c, d, e, aa, bb, cc, dd, ee;
 
 	a = state[0]; 
 	b = state[1];
@@ -543,4 +545,20 @@ void CUDA_SYM_DECL(RandomHash_RIPEMD160)(RH_StridePtr roundInput, RH_StridePtr o
     memcpy(RH_STRIDE_GET_DATA(output), state, 5 * 4);
     RH_STRIDE_SET_SIZE(output, 5 * 4);
     
-} 
+}
+
+#if !defined(RANDOMHASH_CUDA)
+struct RH_RIPEMD160_X8
+{
+    enum { BlockSize = RIPEMD160_BLOCK_SIZE, StateWords = 5 };
+    static const uint32_t* IV() { static const uint32_t iv[StateWords] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 }; return iv; }
+    template <typename W> static void Transform(W* data, W* state) { Ripemd160RoundFunction(data, state); }
+    static uint32_t PadTail(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen) { return RH_MD_PadTail(tail, data, len, totalLen, BlockSize); }
+    static void Scalar(RH_StridePtr in, RH_StridePtr out) { RandomHash_RIPEMD160(in, out); }
+};
+
+inline void RandomHash_RIPEMD160_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RandomHash_MD_Batch<RH_RIPEMD160_X8>(inputs, outputs, count);
+}
+#endif //!RANDOMHASH_CUDA
@@ -16,12 +16,14 @@
 
 
 //#include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 #define RIPEMD160_BLOCK_SIZE 64
 
-inline void CUDA_SYM_DECL(Ripemd256RoundFunction)(uint32_t* data, uint32_t* state)
+template <typename W>
+inline void CUDA_SYM_DECL(Ripemd256RoundFunction)(W* data, W* state)
 {
-	uint32_t a, b, c, d, aa, bb, cc, dd;
+	W a, b, c, d, aa, bb, cc, dd;
 
 	a = state[0];
 	b = state[1];
@@ -318,3 +320,19 @@ void CUDA_SYM_DECL(RandomHash_RIPEMD256)(RH_StridePtr roundInput, RH_StridePtr o
     RH_STRIDE_SET_SIZE(output, 8 * 4);
     
 }
+
+#if !defined(RANDOMHASH_CUDA)
+struct RH_RIPEMD256_X8
+{
+    enum { BlockSize = RIPEMD160_BLOCK_SIZE, StateWords = 8 };
+    static const uint32_t* IV() { static const uint32_t iv[StateWords] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0x76543210, 0xFEDCBA98, 0x89ABCDEF, 0x01234567 }; return iv; }
+    template <typename W> static void Transform(W* data, W* state) { Ripemd256RoundFunction(data, state); }
+    static uint32_t PadTail(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen) { return RH_MD_PadTail(tail, data, len, totalLen, BlockSize); }
+    static void Scalar(RH_StridePtr in, RH_StridePtr out) { RandomHash_RIPEMD256(in, out); }
+};
+
+inline void RandomHash_RIPEMD256_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RandomHash_MD_Batch<RH_RIPEMD256_X8>(inputs, outputs, count);
+}
+#endif //!RANDOMHASH_CUDA
@@ -15,12 +15,14 @@
 /// @copyright Polyminer1, QualiaLibre
 
 #include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 #define RIPEMD320_BLOCK_SIZE 64
 
-inline void CUDA_SYM_DECL(Ripemd320RoundFunction)(uint32_t* data, uint32_t* state)
+template <typename W>
+inline void CUDA_SYM_DECL(Ripemd320RoundFunction)(W* data, W* state)
 {
-	uint32_t a, b, c, d, e, aa, bb, cc, dd, ee;
+	W a, b, c, d, e, aa, bb, cc, dd, ee;
 
 	a = (state)[0];
 	b = (state)[1];
@@ -558,3 +560,19 @@ void CUDA_SYM_DECL(RandomHash_RIPEMD320)(RH_StridePtr roundInput, RH_StridePtr o
     RH_STRIDE_SET_SIZE(output, 10 * 4);
 
 }
+
+#if !defined(RANDOMHASH_CUDA)
+struct RH_RIPEMD320_X8
+{
+    enum { BlockSize = RIPEMD320_BLOCK_SIZE, StateWords = 10 };
+    static const uint32_t* IV() { static const uint32_t iv[StateWords] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0, 0x76543210, 0xFEDCBA98, 0x89ABCDEF, 0x01234567, 0x3C2D1E0F }; return iv; }
+    template <typename W> static void Transform(W* data, W* state) { Ripemd320RoundFunction(data, state); }
+    static uint32_t PadTail(uint8_t* tail, const uint8_t* data, uint32_t len, uint32_t totalLen) { return RH_MD_PadTail(tail, data, len, totalLen, BlockSize); }
+    static void Scalar(RH_StridePtr in, RH_StridePtr out) { RandomHash_RIPEMD320(in, out); }
+};
+
+inline void RandomHash_RIPEMD320_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RandomHash_MD_Batch<RH_RIPEMD320_X8>(inputs, outputs, count);
+}
+#endif //!RANDOMHASH_CUDA
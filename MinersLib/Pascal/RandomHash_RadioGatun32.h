@@ -16,75 +16,57 @@
 
 
 #include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 
 #define RH_RADIOGATUN32_BELT_COPY(dstA, dstI, srcA, srcI) { \
-        uint32_t* dst = dstA + (3 * dstI);     \
-        uint32_t* src = srcA + (3 * srcI);     \
+        W* dst = dstA + (3 * dstI);            \
+        W* src = srcA + (3 * srcI);            \
         *dst++ = *src++;                       \
         *dst++ = *src++;                       \
         *dst++ = *src++;}                      \
 
 #define RADIOGATUN32_BLOCK_SIZE 12
 
+//the round steps are unrolled so every index and rotation is a constant
+#define RH_RADIOGATUN32_REPEAT_1_11(M) M(1) M(2) M(3) M(4) M(5) M(6) M(7) M(8) M(9) M(10) M(11)
+#define RH_RADIOGATUN32_REPEAT_1_18(M) RH_RADIOGATUN32_REPEAT_1_11(M) M(12) M(13) M(14) M(15) M(16) M(17) M(18)
+#define RH_RADIOGATUN32_REPEAT_0_18(M) M(0) RH_RADIOGATUN32_REPEAT_1_18(M)
 
-inline void CUDA_SYM_DECL(RadiogatunRoundFunction)(uint32_t* a, uint32_t* mill, uint32_t* belt)
+#define RH_RADIOGATUN32_BELT_SHIFT(i)   RH_RADIOGATUN32_BELT_COPY(belt, (13 - (i)), belt, (12 - (i)));
+#define RH_RADIOGATUN32_BELT_FEED(i)    belt[3 * (i) + ((i) - 1) % 3] ^= mill[i];
+#define RH_RADIOGATUN32_GAMMA(i)        a[i] = mill[i] ^ (mill[((i) + 1) % 19] | ~mill[((i) + 2) % 19]);
+#define RH_RADIOGATUN32_PI(i)           p[i] = ROTR32(a[(7 * (i)) % 19], (((i) * ((i) + 1)) >> 1) % 32);
+#define RH_RADIOGATUN32_THETA(i)        mill[i] = p[i] ^ p[((i) + 1) % 19] ^ p[((i) + 4) % 19];
+
+//W is uint32_t or RH_U32x8 for the multi-buffer version
+template <typename W>
+inline void CUDA_SYM_DECL(RadiogatunRoundFunction)(W* a, W* mill, W* belt)
 {
-    uint32_t q[3];
+    W q[3];
+    W p[19];
     RH_RADIOGATUN32_BELT_COPY(q, 0, belt, 12);
-		
-    uint32_t i = 12;
-	while (i > 0)
-	{
-        RH_RADIOGATUN32_BELT_COPY(belt, i, belt, (i - 1));
-		i--;
-	}
 
+    //belt[i] = belt[i-1], from 12 down to 1
+    RH_RADIOGATUN32_REPEAT_1_11(RH_RADIOGATUN32_BELT_SHIFT)
+    RH_RADIOGATUN32_BELT_COPY(belt, 1, belt, 0);
     RH_RADIOGATUN32_BELT_COPY(belt, 0, q, 0);
 
-    i = 0;
-	while (i < 12)
-	{
-        uint32_t* dst = belt + (3 * (i + 1));
-        dst[i % 3] ^= mill[i + 1];
-		i++;
-	}
-
-	i = 0;
-	while (i < 19)
-	{
-		a[i] = mill[i] ^ (mill[(i + 1) % 19] | ~mill[(i + 2) % 19]);
-		i++;
-	}
-
-    i = 0;
-	while (i < 19)
-	{
-		mill[i] = ROTR32(a[(7 * i) % 19], (i * (i + 1)) >> 1);
-		i++;
-	}
-
-	i = 0;
-	while (i < 19)
-	{
-		a[i] = mill[i] ^ mill[(i + 1) % 19] ^ mill[(i + 4) % 19];
-		i++;
-	}
-
-	a[0] = a[0] ^ 1;
-	i = 0;
-	while (i < 19)
-	{
-		mill[i] = a[i];
-		i++;
-	}
-
-	i = 0;
-	while (i < 3)
-	{
-		mill[i + 13] = mill[i + 13] ^ q[i];
-		i++;
-	}
+    RH_RADIOGATUN32_REPEAT_1_11(RH_RADIOGATUN32_BELT_FEED)
+    belt[3 * 12 + 11 % 3] ^= mill[12];
+
+    RH_RADIOGATUN32_REPEAT_0_18(RH_RADIOGATUN32_GAMMA)
+
+    //i=0 is not rotated, a shift by 32 would clear the vector lanes
+    p[0] = a[0];
+    RH_RADIOGATUN32_REPEAT_1_18(RH_RADIOGATUN32_PI)
+
+    RH_RADIOGATUN32_REPEAT_0_18(RH_RADIOGATUN32_THETA)
+
+    mill[0] = mill[0] ^ 1;
+    mill[13] = mill[13] ^ q[0];
+    mill[14] = mill[14] ^ q[1];
+    mill[15] = mill[15] ^ q[2];
 }
 
 
@@ -142,3 +124,112 @@ void CUDA_SYM_DECL(RandomHash_RadioGatun32)(RH_StridePtr roundInput, RH_StridePt
     }
 
 }
+
+
+#if !defined(RANDOMHASH_CUDA)
+//Up to 8 messages, one per 32 bit lane. Every lane runs a round per step : it absorbs its blocks then
+//runs the blank and output rounds, so lanes with fewer blocks just finish earlier. The inputs are not modified
+RH_TARGET_ISA("avx2") RH_FLATTEN
+inline void RandomHash_RadioGatun32_X8(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RH_ALIGN(64) static const uint8_t zeroBlock[RADIOGATUN32_BLOCK_SIZE] = { 0 };
+    RH_ALIGN(64) uint8_t tail[8][RADIOGATUN32_BLOCK_SIZE];
+    RH_ALIGN(32) uint32_t words[3][8];
+    RH_ALIGN(32) uint32_t result[2][8];
+    const uint8_t* dataPtr[8];
+    uint32_t fullBlocks[8];
+    uint32_t minBlocks = 0xFFFFFFFF;
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 8; i++)
+    {
+        uint32_t len = 0;
+        dataPtr[i] = zeroBlock;
+        if (i < count)
+        {
+            len = RH_STRIDE_GET_SIZE(inputs[i]);
+            dataPtr[i] = RH_STRIDE_GET_DATA(inputs[i]);
+        }
+        fullBlocks[i] = len / RADIOGATUN32_BLOCK_SIZE;
+        uint32_t pre = len % RADIOGATUN32_BLOCK_SIZE;
+        memset(tail[i], 0, RADIOGATUN32_BLOCK_SIZE);
+        memcpy(tail[i], dataPtr[i] + fullBlocks[i] * RADIOGATUN32_BLOCK_SIZE, pre);
+        tail[i][pre] = 0x01;
+        if (i < count)
+        {
+            minBlocks = RH_Min(minBlocks, fullBlocks[i] + 1);
+            maxBlocks = RH_Max(maxBlocks, fullBlocks[i] + 1);
+        }
+    }
+
+    RH_U32x8 mill[19];
+    RH_U32x8 a[19];
+    RH_U32x8 belt[13 * 3];
+    for (U32 k = 0; k < 19; k++)
+        mill[k] = RH_U32X8_FROM_M256(_mm256_setzero_si256());
+    for (U32 k = 0; k < 13 * 3; k++)
+        belt[k] = RH_U32X8_FROM_M256(_mm256_setzero_si256());
+
+    const uint32_t steps = maxBlocks + 16 + 4;
+    for (uint32_t t = 0; t < steps; t++)
+    {
+        if (t < maxBlocks)
+        {
+            for (U32 i = 0; i < 8; i++)
+            {
+                const uint32_t* src;
+                if (t < fullBlocks[i])
+                    src = (const uint32_t*)(dataPtr[i] + t * RADIOGATUN32_BLOCK_SIZE);
+                else if (t == fullBlocks[i])
+                    src = (const uint32_t*)tail[i];
+                else
+                    src = (const uint32_t*)zeroBlock;
+                words[0][i] = src[0];
+                words[1][i] = src[1];
+                words[2][i] = src[2];
+            }
+            for (U32 k = 0; k < 3; k++)
+            {
+                RH_U32x8 w = RH_U32X8_FROM_M256(_mm256_load_si256((const __m256i*)words[k]));
+                mill[k + 16] = mill[k + 16] ^ w;
+                belt[k] = belt[k] ^ w;
+            }
+        }
+
+        _CM(RadiogatunRoundFunction)(a, mill, belt);
+
+        //output rounds are the last 4 of each lane
+        if (t >= minBlocks + 16)
+        {
+            _mm256_store_si256((__m256i*)result[0], RH_U32X8_TO_M256(mill[1]));
+            _mm256_store_si256((__m256i*)result[1], RH_U32X8_TO_M256(mill[2]));
+            for (U32 i = 0; i < count; i++)
+            {
+                uint32_t outRound = t - (fullBlocks[i] + 1 + 16);
+                if (outRound < 4)
+                {
+                    uint32_t* out = (uint32_t*)RH_STRIDE_GET_DATA(outputs[i]);
+                    out[outRound * 2 + 0] = result[0][i];
+                    out[outRound * 2 + 1] = result[1][i];
+                }
+            }
+        }
+    }
+
+    for (U32 i = 0; i < count; i++)
+        RH_STRIDE_SET_SIZE(outputs[i], 8 * sizeof(uint32_t));
+}
+
+inline void RandomHash_RadioGatun32_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 8)
+            RandomHash_RadioGatun32_X8(inputs + i, outputs + i, RH_Min(count - i, 8U));
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            RandomHash_RadioGatun32(inputs[i], outputs[i]);
+    }
+}
+#endif //!RANDOMHASH_CUDA
@@ -500,6 +500,80 @@ void CUDA_SYM_DECL(SHA2_256_RoundFunction)(uint32_t* data, uint32_t* state)
     state[7] += H;
 }
 
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isAVX2Supported;
+extern bool g_isSHASupported;
+
+static const RH_ALIGN(64) uint32_t c_SHA2_256_K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2};
+
+//Single block with the SHA extensions. 4 rounds per group, the message schedule runs 3 groups ahead
+RH_TARGET_ISA("sha,sse4.1") 
+inline void SHA2_256_RoundFunction_SHANI(uint32_t* data, uint32_t* state)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i STATE0, STATE1, MSG, TMP;
+    __m128i M[4];
+
+    TMP = _mm_loadu_si128((const __m128i*)&state[0]);
+    STATE1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    TMP = _mm_shuffle_epi32(TMP, 0xB1);          // CDAB
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);    // EFGH
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);    // ABEF
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0); // CDGH
+
+    const __m128i ABEF_SAVE = STATE0;
+    const __m128i CDGH_SAVE = STATE1;
+
+    for (int g = 0; g < 16; g++)
+    {
+        if (g < 4)
+            M[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + g * 4)), MASK);
+
+        MSG = _mm_add_epi32(M[g & 3], _mm_load_si128((const __m128i*)(c_SHA2_256_K + g * 4)));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        if (g >= 3 && g < 15)
+        {
+            TMP = _mm_alignr_epi8(M[g & 3], M[(g - 1) & 3], 4);
+            M[(g + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(M[(g + 1) & 3], TMP), M[g & 3]);
+        }
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        if (g >= 1 && g < 13)
+            M[(g - 1) & 3] = _mm_sha256msg1_epu32(M[(g - 1) & 3], M[g & 3]);
+    }
+
+    STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+    STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+
+    TMP = _mm_shuffle_epi32(STATE0, 0x1B);       // FEBA
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);    // DCHG
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0); // DCBA
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);    // ABEF
+
+    _mm_storeu_si128((__m128i*)&state[0], STATE0);
+    _mm_storeu_si128((__m128i*)&state[4], STATE1);
+}
+
+#define SHA2_256_ROUND(data, state) \
+    { \
+        if (g_isSHASupported) \
+            SHA2_256_RoundFunction_SHANI(data, state); \
+        else \
+            _CM(SHA2_256_RoundFunction)(data, state); \
+    }
+
+#else
+#define SHA2_256_ROUND(data, state) { _CM(SHA2_256_RoundFunction)(data, state); }
+#endif //!RANDOMHASH_CUDA
+
 
 void CUDA_SYM_DECL(RandomHash_SHA2_256)(RH_StridePtr roundInput, RH_StridePtr output)
 {
@@ -523,7 +597,7 @@ void CUDA_SYM_DECL(RandomHash_SHA2_256)(RH_StridePtr roundInput, RH_StridePtr ou
     uint64_t bits = len * 8;                                                           
     while(blockCount > 0)                                                              
     {                                                                                  
-        _CM(SHA2_256_RoundFunction)(dataPtr, state);                                                     
+        SHA2_256_ROUND(dataPtr, state);
         len -= SHA2_256_BLOCK_SIZE;                                                        
         dataPtr += SHA2_256_BLOCK_SIZE / 4;                                                
         blockCount--;                                                                  
@@ -548,10 +622,10 @@ void CUDA_SYM_DECL(RandomHash_SHA2_256)(RH_StridePtr roundInput, RH_StridePtr ou
         RH_ASSERT(padindex <= 72);                                                   
         RH_ASSERT(((padindex + len) % SHA2_256_BLOCK_SIZE)==0);                          
                                                                                        
-		_CM(SHA2_256_RoundFunction)(dataPtr, state);                                                     
+		SHA2_256_ROUND(dataPtr, state);
         padindex -= SHA2_256_BLOCK_SIZE;                                                   
         if (padindex > 0)                                                              
-            _CM(SHA2_256_RoundFunction)(dataPtr+(SHA2_256_BLOCK_SIZE/4), state);                             
+            SHA2_256_ROUND(dataPtr+(SHA2_256_BLOCK_SIZE/4), state);
         RH_ASSERT(padindex > -SHA2_256_BLOCK_SIZE);                                      
     }}
 
@@ -562,3 +636,159 @@ void CUDA_SYM_DECL(RandomHash_SHA2_256)(RH_StridePtr roundInput, RH_StridePtr ou
     uint32_t* dataPtr = (uint32_t*)RH_STRIDE_GET_DATA(output);
     copy8_op(dataPtr, state, ReverseBytesUInt32);
 }
+
+
+#if !defined(RANDOMHASH_CUDA)
+//Pad in place like RandomHash_SHA2_256 does and return the total block count
+inline uint32_t SHA2_256_PadInPlace(RH_StridePtr roundInput)
+{
+    uint32_t len = RH_STRIDE_GET_SIZE(roundInput);
+    uint8_t* data = RH_STRIDE_GET_DATA(roundInput);
+    uint32_t blockCount = (len + 8 + SHA2_256_BLOCK_SIZE) / SHA2_256_BLOCK_SIZE;
+    uint32_t end = blockCount * SHA2_256_BLOCK_SIZE;
+    data[len] = 0x80;
+    memset(data + len + 1, 0, end - 8 - len - 1);
+    ReadUInt64AsBytesLE(ReverseBytesUInt64((uint64_t)len * 8), data + end - 8);
+    return blockCount;
+}
+
+#define SHA2_256_X8_ROTR(x, n)   _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+//One block on 8 independent messages. Lanes outside activeMask keep their state
+RH_TARGET_ISA("avx2") 
+inline void SHA2_256_RoundFunction_AVX2x8(const uint32_t* const* data, __m256i* state, __m256i activeMask)
+{
+    const __m256i BSWAP = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i W[64];
+    for (int t = 0; t < 16; t++)
+        W[t] = _mm256_shuffle_epi8(_mm256_set_epi32(data[7][t], data[6][t], data[5][t], data[4][t], data[3][t], data[2][t], data[1][t], data[0][t]), BSWAP);
+
+    for (int t = 16; t < 64; t++)
+    {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(SHA2_256_X8_ROTR(W[t - 15], 7), SHA2_256_X8_ROTR(W[t - 15], 18)), _mm256_srli_epi32(W[t - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(SHA2_256_X8_ROTR(W[t - 2], 17), SHA2_256_X8_ROTR(W[t - 2], 19)), _mm256_srli_epi32(W[t - 2], 10));
+        W[t] = _mm256_add_epi32(_mm256_add_epi32(W[t - 16], s0), _mm256_add_epi32(W[t - 7], s1));
+    }
+
+    __m256i A = state[0], B = state[1], C = state[2], D = state[3];
+    __m256i E = state[4], F = state[5], G = state[6], H = state[7];
+    for (int t = 0; t < 64; t++)
+    {
+        __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(SHA2_256_X8_ROTR(E, 6), SHA2_256_X8_ROTR(E, 11)), SHA2_256_X8_ROTR(E, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(E, F), _mm256_andnot_si256(E, G));
+        __m256i T1 = _mm256_add_epi32(_mm256_add_epi32(H, S1), _mm256_add_epi32(ch, _mm256_add_epi32(_mm256_set1_epi32(c_SHA2_256_K[t]), W[t])));
+        __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(SHA2_256_X8_ROTR(A, 2), SHA2_256_X8_ROTR(A, 13)), SHA2_256_X8_ROTR(A, 22));
+        __m256i maj = _mm256_xor_si256(_mm256_and_si256(A, _mm256_xor_si256(B, C)), _mm256_and_si256(B, C));
+        H = G;
+        G = F;
+        F = E;
+        E = _mm256_add_epi32(D, T1);
+        D = C;
+        C = B;
+        B = A;
+        A = _mm256_add_epi32(T1, _mm256_add_epi32(S0, maj));
+    }
+
+    state[0] = _mm256_blendv_epi8(state[0], _mm256_add_epi32(state[0], A), activeMask);
+    state[1] = _mm256_blendv_epi8(state[1], _mm256_add_epi32(state[1], B), activeMask);
+    state[2] = _mm256_blendv_epi8(state[2], _mm256_add_epi32(state[2], C), activeMask);
+    state[3] = _mm256_blendv_epi8(state[3], _mm256_add_epi32(state[3], D), activeMask);
+    state[4] = _mm256_blendv_epi8(state[4], _mm256_add_epi32(state[4], E), activeMask);
+    state[5] = _mm256_blendv_epi8(state[5], _mm256_add_epi32(state[5], F), activeMask);
+    state[6] = _mm256_blendv_epi8(state[6], _mm256_add_epi32(state[6], G), activeMask);
+    state[7] = _mm256_blendv_epi8(state[7], _mm256_add_epi32(state[7], H), activeMask);
+}
+
+//Up to 8 messages of any size. Like the single buffer version, the inputs are padded in place
+RH_TARGET_ISA("avx2") 
+inline void RandomHash_SHA2_256_AVX2x8(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    RH_ALIGN(64) static const uint32_t zeroBlock[SHA2_256_BLOCK_SIZE / 4] = { 0 };
+    RH_ALIGN(32) uint32_t blockCount[8];
+    RH_ALIGN(32) uint32_t result[8][8];
+    const uint32_t* dataPtr[8];
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 8; i++)
+    {
+        if (i < count)
+        {
+            blockCount[i] = SHA2_256_PadInPlace(inputs[i]);
+            dataPtr[i] = (const uint32_t*)RH_STRIDE_GET_DATA(inputs[i]);
+        }
+        else
+            blockCount[i] = 0;
+        if (blockCount[i] > maxBlocks)
+            maxBlocks = blockCount[i];
+    }
+
+    __m256i state[8] = {
+        _mm256_set1_epi32(0x6A09E667), _mm256_set1_epi32(0xBB67AE85), _mm256_set1_epi32(0x3C6EF372), _mm256_set1_epi32(0xA54FF53A),
+        _mm256_set1_epi32(0x510E527F), _mm256_set1_epi32(0x9B05688C), _mm256_set1_epi32(0x1F83D9AB), _mm256_set1_epi32(0x5BE0CD19)};
+
+    const __m256i blocks = _mm256_load_si256((const __m256i*)blockCount);
+    for (uint32_t b = 0; b < maxBlocks; b++)
+    {
+        const uint32_t* blockPtr[8];
+        for (U32 i = 0; i < 8; i++)
+            blockPtr[i] = b < blockCount[i] ? dataPtr[i] + b * (SHA2_256_BLOCK_SIZE / 4) : zeroBlock;
+
+        __m256i activeMask = _mm256_cmpgt_epi32(blocks, _mm256_set1_epi32(b));
+        SHA2_256_RoundFunction_AVX2x8(blockPtr, state, activeMask);
+    }
+
+    for (U32 w = 0; w < 8; w++)
+        _mm256_store_si256((__m256i*)result[w], state[w]);
+
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(outputs[i], 8 * 4);
+        uint32_t* outPtr = (uint32_t*)RH_STRIDE_GET_DATA(outputs[i]);
+        for (U32 w = 0; w < 8; w++)
+            outPtr[w] = ReverseBytesUInt32(result[w][i]);
+    }
+}
+
+//Batch API. SHA-NI is faster than the multi-buffer path, even on full batches
+inline void RandomHash_SHA2_256_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (!g_isSHASupported && g_isAVX2Supported && count >= 4)
+    {
+        for (U32 i = 0; i < count; i += 8)
+            RandomHash_SHA2_256_AVX2x8(inputs + i, outputs + i, RH_Min(count - i, 8U));
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            RandomHash_SHA2_256(inputs[i], outputs[i]);
+    }
+}
+
+//Round 1 header midstate : the state after the blocks before the nonce, then the rest of the header from it
+inline void RandomHash_SHA2_256_HeaderPrefix(const uint8_t* header, uint8_t* midstate)
+{
+    static const uint32_t iv[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+    RH_ALIGN(64) uint32_t block[SHA2_256_BLOCK_SIZE / 4];
+    uint32_t* state = (uint32_t*)midstate;
+    memcpy(state, iv, sizeof(iv));
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(SHA2_256_BLOCK_SIZE); b += SHA2_256_BLOCK_SIZE)
+    {
+        memcpy(block, header + b, SHA2_256_BLOCK_SIZE);
+        SHA2_256_ROUND(block, state);
+    }
+}
+
+inline void RandomHash_SHA2_256_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output)
+{
+    RH_ALIGN(64) uint32_t state[8];
+    memcpy(state, midstate, sizeof(state));
+    uint32_t blockCount = SHA2_256_PadInPlace(roundInput);
+    uint32_t* dataPtr = (uint32_t*)RH_STRIDE_GET_DATA(roundInput);
+    for (uint32_t b = PascalHeaderPrefixSize(SHA2_256_BLOCK_SIZE) / SHA2_256_BLOCK_SIZE; b < blockCount; b++)
+        SHA2_256_ROUND(dataPtr + b * (SHA2_256_BLOCK_SIZE / 4), state);
+
+    RH_STRIDE_SET_SIZE(output, 8 * 4);
+    uint32_t* outPtr = (uint32_t*)RH_STRIDE_GET_DATA(output);
+    copy8_op(outPtr, state, ReverseBytesUInt32);
+}
+#endif //!RANDOMHASH_CUDA
@@ -755,4 +755,234 @@ void CUDA_SYM_DECL(RandomHash_SHA2_512)(RH_StridePtr roundInput, RH_StridePtr ou
 void CUDA_SYM_DECL(RandomHash_SHA2_384)(RH_StridePtr roundInput, RH_StridePtr output)
 {
     _CM(_RandomHash_SHA2_512)(roundInput, output, true);
-}
\ No newline at end of file
+}
+
+
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isAVX2Supported;
+
+static const RH_ALIGN(64) uint64_t c_SHA2_512_K[80] = {
+    0x428A2F98D728AE22, 0x7137449123EF65CD, 0xB5C0FBCFEC4D3B2F, 0xE9B5DBA58189DBBC,
+    0x3956C25BF348B538, 0x59F111F1B605D019, 0x923F82A4AF194F9B, 0xAB1C5ED5DA6D8118,
+    0xD807AA98A3030242, 0x12835B0145706FBE, 0x243185BE4EE4B28C, 0x550C7DC3D5FFB4E2,
+    0x72BE5D74F27B896F, 0x80DEB1FE3B1696B1, 0x9BDC06A725C71235, 0xC19BF174CF692694,
+    0xE49B69C19EF14AD2, 0xEFBE4786384F25E3, 0x0FC19DC68B8CD5B5, 0x240CA1CC77AC9C65,
+    0x2DE92C6F592B0275, 0x4A7484AA6EA6E483, 0x5CB0A9DCBD41FBD4, 0x76F988DA831153B5,
+    0x983E5152EE66DFAB, 0xA831C66D2DB43210, 0xB00327C898FB213F, 0xBF597FC7BEEF0EE4,
+    0xC6E00BF33DA88FC2, 0xD5A79147930AA725, 0x06CA6351E003826F, 0x142929670A0E6E70,
+    0x27B70A8546D22FFC, 0x2E1B21385C26C926, 0x4D2C6DFC5AC42AED, 0x53380D139D95B3DF,
+    0x650A73548BAF63DE, 0x766A0ABB3C77B2A8, 0x81C2C92E47EDAEE6, 0x92722C851482353B,
+    0xA2BFE8A14CF10364, 0xA81A664BBC423001, 0xC24B8B70D0F89791, 0xC76C51A30654BE30,
+    0xD192E819D6EF5218, 0xD69906245565A910, 0xF40E35855771202A, 0x106AA07032BBD1B8,
+    0x19A4C116B8D2D0C8, 0x1E376C085141AB53, 0x2748774CDF8EEB99, 0x34B0BCB5E19B48A8,
+    0x391C0CB3C5C95A63, 0x4ED8AA4AE3418ACB, 0x5B9CCA4F7763E373, 0x682E6FF3D6B2B8A3,
+    0x748F82EE5DEFB2FC, 0x78A5636F43172F60, 0x84C87814A1F0AB72, 0x8CC702081A6439EC,
+    0x90BEFFFA23631E28, 0xA4506CEBDE82BDE9, 0xBEF9A3F7B2C67915, 0xC67178F2E372532B,
+    0xCA273ECEEA26619C, 0xD186B8C721C0C207, 0xEADA7DD6CDE0EB1E, 0xF57D4F7FEE6ED178,
+    0x06F067AA72176FBA, 0x0A637DC5A2C898A6, 0x113F9804BEF90DAE, 0x1B710B35131C471B,
+    0x28DB77F523047D84, 0x32CAAB7B40C72493, 0x3C9EBE0A15C9BEBC, 0x431D67C49C100D4C,
+    0x4CC5D4BECB3E42B6, 0x597F299CFC657E2A, 0x5FCB6FAB3AD6FAEC, 0x6C44198C4A475817};
+
+//Pad in place like _RandomHash_SHA2_512 does and return the total block count
+inline uint32_t SHA2_512_PadInPlace(RH_StridePtr roundInput)
+{
+    uint32_t len = RH_STRIDE_GET_SIZE(roundInput);
+    uint8_t* data = RH_STRIDE_GET_DATA(roundInput);
+    uint32_t blockCount = (len + 16 + SHA2_512_BLOCK_SIZE) / SHA2_512_BLOCK_SIZE;
+    uint32_t end = blockCount * SHA2_512_BLOCK_SIZE;
+    data[len] = 0x80;
+    memset(data + len + 1, 0, end - 8 - len - 1);
+    ReadUInt64AsBytesLE(ReverseBytesUInt64((uint64_t)len << 3), data + end - 8);
+    return blockCount;
+}
+
+#define SHA2_512_X4_ROTR(x, n)   _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+
+//One block on 4 independent messages. Lanes outside activeMask keep their state
+RH_TARGET_ISA("avx2") 
+inline void SHA2_512_RoundFunction_AVX2x4(const uint64_t* const* data, __m256i* state, __m256i activeMask)
+{
+    const __m256i BSWAP = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+                                          8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i W[80];
+    for (int t = 0; t < 16; t++)
+        W[t] = _mm256_shuffle_epi8(_mm256_set_epi64x(data[3][t], data[2][t], data[1][t], data[0][t]), BSWAP);
+
+    for (int t = 16; t < 80; t++)
+    {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(SHA2_512_X4_ROTR(W[t - 15], 1), SHA2_512_X4_ROTR(W[t - 15], 8)), _mm256_srli_epi64(W[t - 15], 7));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(SHA2_512_X4_ROTR(W[t - 2], 19), SHA2_512_X4_ROTR(W[t - 2], 61)), _mm256_srli_epi64(W[t - 2], 6));
+        W[t] = _mm256_add_epi64(_mm256_add_epi64(W[t - 16], s0), _mm256_add_epi64(W[t - 7], s1));
+    }
+
+    __m256i A = state[0], B = state[1], C = state[2], D = state[3];
+    __m256i E = state[4], F = state[5], G = state[6], H = state[7];
+    for (int t = 0; t < 80; t++)
+    {
+        __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(SHA2_512_X4_ROTR(E, 14), SHA2_512_X4_ROTR(E, 18)), SHA2_512_X4_ROTR(E, 41));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(E, F), _mm256_andnot_si256(E, G));
+        __m256i T1 = _mm256_add_epi64(_mm256_add_epi64(H, S1), _mm256_add_epi64(ch, _mm256_add_epi64(_mm256_set1_epi64x(c_SHA2_512_K[t]), W[t])));
+        __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(SHA2_512_X4_ROTR(A, 28), SHA2_512_X4_ROTR(A, 34)), SHA2_512_X4_ROTR(A, 39));
+        __m256i maj = _mm256_xor_si256(_mm256_and_si256(A, _mm256_xor_si256(B, C)), _mm256_and_si256(B, C));
+        H = G;
+        G = F;
+        F = E;
+        E = _mm256_add_epi64(D, T1);
+        D = C;
+        C = B;
+        B = A;
+        A = _mm256_add_epi64(T1, _mm256_add_epi64(S0, maj));
+    }
+
+    state[0] = _mm256_blendv_epi8(state[0], _mm256_add_epi64(state[0], A), activeMask);
+    state[1] = _mm256_blendv_epi8(state[1], _mm256_add_epi64(state[1], B), activeMask);
+    state[2] = _mm256_blendv_epi8(state[2], _mm256_add_epi64(state[2], C), activeMask);
+    state[3] = _mm256_blendv_epi8(state[3], _mm256_add_epi64(state[3], D), activeMask);
+    state[4] = _mm256_blendv_epi8(state[4], _mm256_add_epi64(state[4], E), activeMask);
+    state[5] = _mm256_blendv_epi8(state[5], _mm256_add_epi64(state[5], F), activeMask);
+    state[6] = _mm256_blendv_epi8(state[6], _mm256_add_epi64(state[6], G), activeMask);
+    state[7] = _mm256_blendv_epi8(state[7], _mm256_add_epi64(state[7], H), activeMask);
+}
+
+//Up to 4 messages of any size. Like the single buffer version, the inputs are padded in place
+RH_TARGET_ISA("avx2") 
+inline void RandomHash_SHA2_512_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count, bool is384)
+{
+    RH_ALIGN(64) static const uint64_t zeroBlock[SHA2_512_BLOCK_SIZE / 8] = { 0 };
+    RH_ALIGN(32) uint64_t blockCount[4];
+    RH_ALIGN(32) uint64_t result[8][4];
+    const uint64_t* dataPtr[4];
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 4; i++)
+    {
+        if (i < count)
+        {
+            blockCount[i] = SHA2_512_PadInPlace(inputs[i]);
+            dataPtr[i] = (const uint64_t*)RH_STRIDE_GET_DATA(inputs[i]);
+        }
+        else
+            blockCount[i] = 0;
+        if (blockCount[i] > maxBlocks)
+            maxBlocks = (uint32_t)blockCount[i];
+    }
+
+    __m256i state[8];
+    if (is384)
+    {
+        state[0] = _mm256_set1_epi64x(0xCBBB9D5DC1059ED8);
+        state[1] = _mm256_set1_epi64x(0x629A292A367CD507);
+        state[2] = _mm256_set1_epi64x(0x9159015A3070DD17);
+        state[3] = _mm256_set1_epi64x(0x152FECD8F70E5939);
+        state[4] = _mm256_set1_epi64x(0x67332667FFC00B31);
+        state[5] = _mm256_set1_epi64x(0x8EB44A8768581511);
+        state[6] = _mm256_set1_epi64x(0xDB0C2E0D64F98FA7);
+        state[7] = _mm256_set1_epi64x(0x47B5481DBEFA4FA4);
+    }
+    else
+    {
+        state[0] = _mm256_set1_epi64x(0x6A09E667F3BCC908);
+        state[1] = _mm256_set1_epi64x(0xBB67AE8584CAA73B);
+        state[2] = _mm256_set1_epi64x(0x3C6EF372FE94F82B);
+        state[3] = _mm256_set1_epi64x(0xA54FF53A5F1D36F1);
+        state[4] = _mm256_set1_epi64x(0x510E527FADE682D1);
+        state[5] = _mm256_set1_epi64x(0x9B05688C2B3E6C1F);
+        state[6] = _mm256_set1_epi64x(0x1F83D9ABFB41BD6B);
+        state[7] = _mm256_set1_epi64x(0x5BE0CD19137E2179);
+    }
+
+    const __m256i blocks = _mm256_load_si256((const __m256i*)blockCount);
+    for (uint32_t b = 0; b < maxBlocks; b++)
+    {
+        const uint64_t* blockPtr[4];
+        for (U32 i = 0; i < 4; i++)
+            blockPtr[i] = b < blockCount[i] ? dataPtr[i] + b * (SHA2_512_BLOCK_SIZE / 8) : zeroBlock;
+
+        __m256i activeMask = _mm256_cmpgt_epi64(blocks, _mm256_set1_epi64x(b));
+        SHA2_512_RoundFunction_AVX2x4(blockPtr, state, activeMask);
+    }
+
+    for (U32 w = 0; w < 8; w++)
+        _mm256_store_si256((__m256i*)result[w], state[w]);
+
+    const U32 wordCount = is384 ? 6 : 8;
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(outputs[i], wordCount * 8);
+        uint64_t* outPtr = (uint64_t*)RH_STRIDE_GET_DATA(outputs[i]);
+        for (U32 w = 0; w < wordCount; w++)
+            outPtr[w] = ReverseBytesUInt64(result[w][i]);
+    }
+}
+
+inline void RandomHash_SHA2_512_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 4)
+            RandomHash_SHA2_512_AVX2x4(inputs + i, outputs + i, RH_Min(count - i, 4U), false);
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            RandomHash_SHA2_512(inputs[i], outputs[i]);
+    }
+}
+
+inline void RandomHash_SHA2_384_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 4)
+            RandomHash_SHA2_512_AVX2x4(inputs + i, outputs + i, RH_Min(count - i, 4U), true);
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            RandomHash_SHA2_384(inputs[i], outputs[i]);
+    }
+}
+
+//Round 1 header midstate : the state after the blocks before the nonce, then the rest of the header from it
+inline void SHA2_512_HeaderPrefix(const uint8_t* header, uint8_t* midstate, bool is384)
+{
+    static const uint64_t iv384[8] = { 0xCBBB9D5DC1059ED8, 0x629A292A367CD507, 0x9159015A3070DD17, 0x152FECD8F70E5939, 
+                                       0x67332667FFC00B31, 0x8EB44A8768581511, 0xDB0C2E0D64F98FA7, 0x47B5481DBEFA4FA4 };
+    static const uint64_t iv512[8] = { 0x6A09E667F3BCC908, 0xBB67AE8584CAA73B, 0x3C6EF372FE94F82B, 0xA54FF53A5F1D36F1, 
+                                       0x510E527FADE682D1, 0x9B05688C2B3E6C1F, 0x1F83D9ABFB41BD6B, 0x5BE0CD19137E2179 };
+    RH_ALIGN(64) uint64_t block[SHA2_512_BLOCK_SIZE / 8];
+    uint64_t* state = (uint64_t*)midstate;
+    memcpy(state, is384 ? iv384 : iv512, sizeof(iv512));
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(SHA2_512_BLOCK_SIZE); b += SHA2_512_BLOCK_SIZE)
+    {
+        memcpy(block, header + b, SHA2_512_BLOCK_SIZE);
+        SHA2_512_RoundFunction(block, state);
+    }
+}
+
+inline void SHA2_512_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output, bool is384)
+{
+    RH_ALIGN(64) uint64_t state[8];
+    memcpy(state, midstate, sizeof(state));
+    uint32_t blockCount = SHA2_512_PadInPlace(roundInput);
+    uint64_t* dataPtr = (uint64_t*)RH_STRIDE_GET_DATA(roundInput);
+    for (uint32_t b = PascalHeaderPrefixSize(SHA2_512_BLOCK_SIZE) / SHA2_512_BLOCK_SIZE; b < blockCount; b++)
+        SHA2_512_RoundFunction(dataPtr + b * (SHA2_512_BLOCK_SIZE / 8), state);
+
+    dataPtr = (uint64_t*)RH_STRIDE_GET_DATA(output);
+    if (is384)
+    {
+        RH_STRIDE_SET_SIZE(output, 6 * 8);
+        copy6_op(dataPtr, state, ReverseBytesUInt64);
+    }
+    else
+    {
+        RH_STRIDE_SET_SIZE(output, 8 * 8);
+        copy8_op(dataPtr, state, ReverseBytesUInt64);
+    }
+}
+
+inline void RandomHash_SHA2_384_HeaderPrefix(const uint8_t* header, uint8_t* midstate) { SHA2_512_HeaderPrefix(header, midstate, true); }
+inline void RandomHash_SHA2_512_HeaderPrefix(const uint8_t* header, uint8_t* midstate) { SHA2_512_HeaderPrefix(header, midstate, false); }
+inline void RandomHash_SHA2_384_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output) { SHA2_512_FromMidstate(midstate, roundInput, output, true); }
+inline void RandomHash_SHA2_512_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output) { SHA2_512_FromMidstate(midstate, roundInput, output, false); }
+#endif //!RANDOMHASH_CUDA
@@ -2698,3 +2698,220 @@ void CUDA_SYM_DECL(RandomHash_SHA3_512)(RH_StridePtr roundInput, RH_StridePtr ou
 {
     _CM(_RandomHash_SHA3_512)(roundInput, output, 64);
 }
+
+
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isAVX2Supported;
+extern bool g_isAVX512Supported;
+
+static const RH_ALIGN(64) uint64_t c_SHA3_RoundConstants[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+    0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+
+//Keccak-f[1600] on 4 states, one state per 64 bit lane. Plain lanes, no complementing.
+//The rotate and chi macros are defined for each instruction set before the permutation function
+#define SHA3_X4_THETA()                                                                                         \
+    {                                                                                                           \
+        __m256i C[5], D;                                                                                        \
+        for (int x = 0; x < 5; x++)                                                                             \
+            C[x] = SHA3_X4_XOR5(S[x], S[x + 5], S[x + 10], S[x + 15], S[x + 20]);                               \
+        for (int x = 0; x < 5; x++)                                                                             \
+        {                                                                                                       \
+            D = _mm256_xor_si256(C[(x + 4) % 5], SHA3_X4_ROTL(C[(x + 1) % 5], 1));                              \
+            for (int y = 0; y < 25; y += 5)                                                                     \
+                S[y + x] = _mm256_xor_si256(S[y + x], D);                                                       \
+        }                                                                                                       \
+    }
+
+#define SHA3_X4_RHO_PI()                         \
+    {                                           \
+        __m256i t = S[1], bc;                   \
+        bc = S[10]; S[10] = SHA3_X4_ROTL(t, 1); t = bc; \
+        bc = S[7]; S[7] = SHA3_X4_ROTL(t, 3); t = bc; \
+        bc = S[11]; S[11] = SHA3_X4_ROTL(t, 6); t = bc; \
+        bc = S[17]; S[17] = SHA3_X4_ROTL(t, 10); t = bc; \
+        bc = S[18]; S[18] = SHA3_X4_ROTL(t, 15); t = bc; \
+        bc = S[3]; S[3] = SHA3_X4_ROTL(t, 21); t = bc; \
+        bc = S[5]; S[5] = SHA3_X4_ROTL(t, 28); t = bc; \
+        bc = S[16]; S[16] = SHA3_X4_ROTL(t, 36); t = bc; \
+        bc = S[8]; S[8] = SHA3_X4_ROTL(t, 45); t = bc; \
+        bc = S[21]; S[21] = SHA3_X4_ROTL(t, 55); t = bc; \
+        bc = S[24]; S[24] = SHA3_X4_ROTL(t, 2); t = bc; \
+        bc = S[4]; S[4] = SHA3_X4_ROTL(t, 14); t = bc; \
+        bc = S[15]; S[15] = SHA3_X4_ROTL(t, 27); t = bc; \
+        bc = S[23]; S[23] = SHA3_X4_ROTL(t, 41); t = bc; \
+        bc = S[19]; S[19] = SHA3_X4_ROTL(t, 56); t = bc; \
+        bc = S[13]; S[13] = SHA3_X4_ROTL(t, 8); t = bc; \
+        bc = S[12]; S[12] = SHA3_X4_ROTL(t, 25); t = bc; \
+        bc = S[2]; S[2] = SHA3_X4_ROTL(t, 43); t = bc; \
+        bc = S[20]; S[20] = SHA3_X4_ROTL(t, 62); t = bc; \
+        bc = S[14]; S[14] = SHA3_X4_ROTL(t, 18); t = bc; \
+        bc = S[22]; S[22] = SHA3_X4_ROTL(t, 39); t = bc; \
+        bc = S[9]; S[9] = SHA3_X4_ROTL(t, 61); t = bc; \
+        bc = S[6]; S[6] = SHA3_X4_ROTL(t, 20); t = bc; \
+        bc = S[1]; S[1] = SHA3_X4_ROTL(t, 44); t = bc; \
+    }
+
+#define SHA3_X4_CHI_IOTA(r)                                                                                     \
+    {                                                                                                           \
+        for (int y = 0; y < 25; y += 5)                                                                         \
+        {                                                                                                       \
+            __m256i b0 = S[y], b1 = S[y + 1], b2 = S[y + 2], b3 = S[y + 3], b4 = S[y + 4];                      \
+            S[y + 0] = SHA3_X4_CHI(b0, b1, b2);                                                                 \
+            S[y + 1] = SHA3_X4_CHI(b1, b2, b3);                                                                 \
+            S[y + 2] = SHA3_X4_CHI(b2, b3, b4);                                                                 \
+            S[y + 3] = SHA3_X4_CHI(b3, b4, b0);                                                                 \
+            S[y + 4] = SHA3_X4_CHI(b4, b0, b1);                                                                 \
+        }                                                                                                       \
+        S[0] = _mm256_xor_si256(S[0], _mm256_set1_epi64x(c_SHA3_RoundConstants[r]));                           \
+    }
+
+#define SHA3_X4_ROTL(x, n)          _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+#define SHA3_X4_XOR5(a, b, c, d, e) _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d)), e)
+#define SHA3_X4_CHI(a, b, c)        _mm256_xor_si256(a, _mm256_andnot_si256(b, c))
+
+RH_TARGET_ISA("avx2") 
+inline void SHA3_KeccakF_AVX2x4(__m256i* S)
+{
+    for (int r = 0; r < 24; r++)
+    {
+        SHA3_X4_THETA();
+        SHA3_X4_RHO_PI();
+        SHA3_X4_CHI_IOTA(r);
+    }
+}
+
+#undef SHA3_X4_ROTL
+#undef SHA3_X4_XOR5
+#undef SHA3_X4_CHI
+
+//AVX-512VL on 256 bit registers : native rotates and 3 inputs logic
+#define SHA3_X4_ROTL(x, n)          _mm256_rol_epi64(x, n)
+#define SHA3_X4_XOR5(a, b, c, d, e) _mm256_ternarylogic_epi64(_mm256_ternarylogic_epi64(a, b, c, 0x96), d, e, 0x96)
+#define SHA3_X4_CHI(a, b, c)        _mm256_ternarylogic_epi64(a, b, c, 0xD2)
+
+RH_TARGET_ISA("avx512f,avx512vl") 
+inline void SHA3_KeccakF_AVX512x4(__m256i* S)
+{
+    for (int r = 0; r < 24; r++)
+    {
+        SHA3_X4_THETA();
+        SHA3_X4_RHO_PI();
+        SHA3_X4_CHI_IOTA(r);
+    }
+}
+
+#undef SHA3_X4_ROTL
+#undef SHA3_X4_XOR5
+#undef SHA3_X4_CHI
+
+//Up to 4 messages of any size. Like the single buffer version, the inputs are padded in place
+template <bool AVX512>
+RH_TARGET_ISA("avx2") 
+inline void RandomHash_SHA3_X4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count, uint32_t hashsize)
+{
+    RH_ALIGN(64) static const uint64_t zeroBlock[SHA3_512_MAX_BLOCK_SIZE / 8 + 4] = { 0 };
+    const uint32_t BlockSize = 200 - hashsize * 2;
+    const uint32_t BlockWords = BlockSize / 8;
+    uint32_t blockCount[4];
+    const uint64_t* dataPtr[4];
+    uint32_t minBlocks = U32_Max;
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 4; i++)
+    {
+        if (i < count)
+        {
+            uint32_t len = RH_STRIDE_GET_SIZE(inputs[i]);
+            uint8_t* data = RH_STRIDE_GET_DATA(inputs[i]);
+            blockCount[i] = len / BlockSize + 1;
+            uint32_t end = blockCount[i] * BlockSize;
+            memset(data + len, 0, end - len);
+            data[len] = 0x6;
+            data[end - 1] ^= 0x80;
+            dataPtr[i] = (const uint64_t*)data;
+        }
+        else
+        {
+            blockCount[i] = 0;
+            dataPtr[i] = zeroBlock;
+        }
+        minBlocks = RH_Min(minBlocks, blockCount[i]);
+        maxBlocks = RH_Max(maxBlocks, blockCount[i]);
+    }
+
+    __m256i S[25];
+    for (U32 w = 0; w < 25; w++)
+        S[w] = _mm256_setzero_si256();
+
+    for (uint32_t b = 0; b < maxBlocks; b++)
+    {
+        const uint64_t* m[4];
+        for (U32 i = 0; i < 4; i++)
+            m[i] = b < blockCount[i] ? dataPtr[i] + b * BlockWords : zeroBlock;
+
+        for (U32 w = 0; w < BlockWords; w++)
+            S[w] = _mm256_xor_si256(S[w], _mm256_set_epi64x(m[3][w], m[2][w], m[1][w], m[0][w]));
+
+        if (b < minBlocks)
+        {
+            if (AVX512)
+                SHA3_KeccakF_AVX512x4(S);
+            else
+                SHA3_KeccakF_AVX2x4(S);
+        }
+        else
+        {
+            //some lanes are done, keep their state
+            __m256i activeMask = _mm256_cmpgt_epi64(_mm256_set_epi64x(blockCount[3], blockCount[2], blockCount[1], blockCount[0]), _mm256_set1_epi64x(b));
+            __m256i prev[25];
+            memcpy(prev, S, sizeof(prev));
+            if (AVX512)
+                SHA3_KeccakF_AVX512x4(S);
+            else
+                SHA3_KeccakF_AVX2x4(S);
+            for (U32 w = 0; w < 25; w++)
+                S[w] = _mm256_blendv_epi8(prev[w], S[w], activeMask);
+        }
+    }
+
+    RH_ALIGN(32) uint64_t result[8][4];
+    const U32 wordCount = hashsize / 8;
+    for (U32 w = 0; w < wordCount; w++)
+        _mm256_store_si256((__m256i*)result[w], S[w]);
+
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(outputs[i], hashsize);
+        uint64_t* out = (uint64_t*)RH_STRIDE_GET_DATA(outputs[i]);
+        for (U32 w = 0; w < wordCount; w++)
+            out[w] = result[w][i];
+    }
+}
+
+inline void RandomHash_SHA3_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count, uint32_t hashsize)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 4)
+        {
+            if (g_isAVX512Supported)
+                RandomHash_SHA3_X4<true>(inputs + i, outputs + i, RH_Min(count - i, 4U), hashsize);
+            else
+                RandomHash_SHA3_X4<false>(inputs + i, outputs + i, RH_Min(count - i, 4U), hashsize);
+        }
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            _RandomHash_SHA3_512(inputs[i], outputs[i], hashsize);
+    }
+}
+
+inline void RandomHash_SHA3_256_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_Batch(inputs, outputs, count, 32); }
+inline void RandomHash_SHA3_384_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_Batch(inputs, outputs, count, 48); }
+inline void RandomHash_SHA3_512_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count) { RandomHash_SHA3_Batch(inputs, outputs, count, 64); }
+#endif //!RANDOMHASH_CUDA
@@ -14,6 +14,7 @@
 /// @file
 /// @copyright Polyminer1, QualiaLibre
 #include "RandomHash_core.h"
+#include "RandomHash_MultiBuffer.h"
 
 
 PLATFORM_CONST uint32_t Tiger2_rounds = 5;
@@ -834,3 +835,210 @@ void CUDA_SYM_DECL(RandomHash_Tiger2_5_192)(RH_StridePtr roundInput, RH_StridePt
     dataPtr[2] = state[2];
 
 }
+
+
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isAVX2Supported;
+
+//Same passes as Tiger2_5_192_Transform on 4 independent messages. The sbox lookups become 64 bit gathers
+#define TIGER2_X4_BYTE(x, s)  _mm256_and_si256(_mm256_srli_epi64(x, s), byteMask)
+#define TIGER2_X4_LOOKUP(T, x, s)  _mm256_i64gather_epi64((const long long*)T, TIGER2_X4_BYTE(x, s), 8)
+
+#define TIGER2_X4_ROUND(a, b, c, x, mul)                                                         \
+    {                                                                                            \
+        c = _mm256_xor_si256(c, x);                                                              \
+        a = _mm256_sub_epi64(a, _mm256_xor_si256(                                                \
+                _mm256_xor_si256(TIGER2_X4_LOOKUP(Tiger2_T1, c, 0), TIGER2_X4_LOOKUP(Tiger2_T2, c, 16)),  \
+                _mm256_xor_si256(TIGER2_X4_LOOKUP(Tiger2_T3, c, 32), TIGER2_X4_LOOKUP(Tiger2_T4, c, 48)))); \
+        b = _mm256_add_epi64(b, _mm256_xor_si256(                                                \
+                _mm256_xor_si256(TIGER2_X4_LOOKUP(Tiger2_T4, c, 8), TIGER2_X4_LOOKUP(Tiger2_T3, c, 24)),  \
+                _mm256_xor_si256(TIGER2_X4_LOOKUP(Tiger2_T2, c, 40), TIGER2_X4_LOOKUP(Tiger2_T1, c, 56)))); \
+        b = mul(b);                                                                              \
+    }
+
+#define TIGER2_X4_MUL5(x)  _mm256_add_epi64(_mm256_slli_epi64(x, 2), x)
+#define TIGER2_X4_MUL7(x)  _mm256_sub_epi64(_mm256_slli_epi64(x, 3), x)
+#define TIGER2_X4_MUL9(x)  _mm256_add_epi64(_mm256_slli_epi64(x, 3), x)
+
+#define TIGER2_X4_PASS(a, b, c, mul)              \
+    TIGER2_X4_ROUND(a, b, c, data[0], mul)        \
+    TIGER2_X4_ROUND(b, c, a, data[1], mul)        \
+    TIGER2_X4_ROUND(c, a, b, data[2], mul)        \
+    TIGER2_X4_ROUND(a, b, c, data[3], mul)        \
+    TIGER2_X4_ROUND(b, c, a, data[4], mul)        \
+    TIGER2_X4_ROUND(c, a, b, data[5], mul)        \
+    TIGER2_X4_ROUND(a, b, c, data[6], mul)        \
+    TIGER2_X4_ROUND(b, c, a, data[7], mul)
+
+RH_TARGET_ISA("avx2") 
+inline void Tiger2_5_192_Transform_AVX2x4(__m256i* data, __m256i* state, __m256i activeMask)
+{
+    const __m256i byteMask = _mm256_set1_epi64x(0xFF);
+    const __m256i C1 = _mm256_set1_epi64x(Tiger2_C1);
+    const __m256i C2 = _mm256_set1_epi64x(Tiger2_C2);
+    const __m256i allOnes = _mm256_set1_epi64x(-1);
+    __m256i a = state[0];
+    __m256i b = state[1];
+    __m256i c = state[2];
+    __m256i temp_a;
+
+    for (uint32_t pass = 0; pass < Tiger2_rounds; pass++)
+    {
+        if (pass)
+        {
+            data[0] = _mm256_sub_epi64(data[0], _mm256_xor_si256(data[7], C1));
+            data[1] = _mm256_xor_si256(data[1], data[0]);
+            data[2] = _mm256_add_epi64(data[2], data[1]);
+            data[3] = _mm256_sub_epi64(data[3], _mm256_xor_si256(data[2], _mm256_slli_epi64(_mm256_xor_si256(data[1], allOnes), 19)));
+            data[4] = _mm256_xor_si256(data[4], data[3]);
+            data[5] = _mm256_add_epi64(data[5], data[4]);
+            data[6] = _mm256_sub_epi64(data[6], _mm256_xor_si256(data[5], _mm256_srli_epi64(_mm256_xor_si256(data[4], allOnes), 23)));
+            data[7] = _mm256_xor_si256(data[7], data[6]);
+            data[0] = _mm256_add_epi64(data[0], data[7]);
+            data[1] = _mm256_sub_epi64(data[1], _mm256_xor_si256(data[0], _mm256_slli_epi64(_mm256_xor_si256(data[7], allOnes), 19)));
+            data[2] = _mm256_xor_si256(data[2], data[1]);
+            data[3] = _mm256_add_epi64(data[3], data[2]);
+            data[4] = _mm256_sub_epi64(data[4], _mm256_xor_si256(data[3], _mm256_srli_epi64(_mm256_xor_si256(data[2], allOnes), 23)));
+            data[5] = _mm256_xor_si256(data[5], data[4]);
+            data[6] = _mm256_add_epi64(data[6], data[5]);
+            data[7] = _mm256_sub_epi64(data[7], _mm256_xor_si256(data[6], C2));
+        }
+
+        switch (pass)
+        {
+            case 0: TIGER2_X4_PASS(a, b, c, TIGER2_X4_MUL5); break;
+            case 1: TIGER2_X4_PASS(c, a, b, TIGER2_X4_MUL7); break;
+            case 2: TIGER2_X4_PASS(b, c, a, TIGER2_X4_MUL9); break;
+            default:
+                TIGER2_X4_PASS(a, b, c, TIGER2_X4_MUL9);
+                temp_a = a;
+                a = c;
+                c = b;
+                b = temp_a;
+                break;
+        }
+    }
+
+    state[0] = _mm256_blendv_epi8(state[0], _mm256_xor_si256(state[0], a), activeMask);
+    state[1] = _mm256_blendv_epi8(state[1], _mm256_sub_epi64(b, state[1]), activeMask);
+    state[2] = _mm256_blendv_epi8(state[2], _mm256_add_epi64(state[2], c), activeMask);
+}
+
+//Up to 4 messages. Like the single buffer version, the inputs are padded in place
+RH_TARGET_ISA("avx2") 
+inline void RandomHash_Tiger2_5_192_AVX2x4(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    const uint32_t Tiger2_BlockSize = 64;
+    const uint32_t Tiger2_HashSize = 24;
+    RH_ALIGN(64) static const uint64_t zeroBlock[8] = { 0 };
+    RH_ALIGN(32) uint64_t blockCount[4];
+    RH_ALIGN(32) uint64_t result[3][4];
+    const uint64_t* dataPtr[4];
+    uint32_t maxBlocks = 0;
+    for (U32 i = 0; i < 4; i++)
+    {
+        if (i < count)
+        {
+            uint32_t len = RH_STRIDE_GET_SIZE(inputs[i]);
+            uint8_t* data = RH_STRIDE_GET_DATA(inputs[i]);
+            blockCount[i] = (len + 8 + Tiger2_BlockSize) / Tiger2_BlockSize;
+            uint32_t end = (uint32_t)blockCount[i] * Tiger2_BlockSize;
+            data[len] = 0x80;
+            memset(data + len + 1, 0, end - 8 - len - 1);
+            ReadUInt64AsBytesLE((uint64_t)len * 8, data + end - 8);
+            dataPtr[i] = (const uint64_t*)data;
+        }
+        else
+        {
+            blockCount[i] = 0;
+            dataPtr[i] = zeroBlock;
+        }
+        if (blockCount[i] > maxBlocks)
+            maxBlocks = (uint32_t)blockCount[i];
+    }
+
+    __m256i state[3];
+    state[0] = _mm256_set1_epi64x(0x0123456789ABCDEF);
+    state[1] = _mm256_set1_epi64x(0xFEDCBA9876543210);
+    state[2] = _mm256_set1_epi64x(0xF096A5B4C3B2E187);
+
+    const __m256i blocks = _mm256_load_si256((const __m256i*)blockCount);
+    for (uint32_t b = 0; b < maxBlocks; b++)
+    {
+        const uint64_t* m[4];
+        for (U32 i = 0; i < 4; i++)
+            m[i] = b < blockCount[i] ? dataPtr[i] + b * (Tiger2_BlockSize / 8) : zeroBlock;
+
+        __m256i data[8];
+        for (U32 w = 0; w < 8; w++)
+            data[w] = _mm256_set_epi64x(m[3][w], m[2][w], m[1][w], m[0][w]);
+
+        Tiger2_5_192_Transform_AVX2x4(data, state, _mm256_cmpgt_epi64(blocks, _mm256_set1_epi64x(b)));
+    }
+
+    for (U32 w = 0; w < 3; w++)
+        _mm256_store_si256((__m256i*)result[w], state[w]);
+
+    for (U32 i = 0; i < count; i++)
+    {
+        RH_STRIDE_SET_SIZE(outputs[i], Tiger2_HashSize);
+        uint64_t* out = (uint64_t*)RH_STRIDE_GET_DATA(outputs[i]);
+        out[0] = result[0][i];
+        out[1] = result[1][i];
+        out[2] = result[2][i];
+    }
+}
+
+inline void RandomHash_Tiger2_5_192_Batch(RH_StridePtr* inputs, RH_StridePtr* outputs, U32 count)
+{
+    if (g_isAVX2Supported && count >= 2)
+    {
+        for (U32 i = 0; i < count; i += 4)
+            RandomHash_Tiger2_5_192_AVX2x4(inputs + i, outputs + i, RH_Min(count - i, 4U));
+    }
+    else
+    {
+        for (U32 i = 0; i < count; i++)
+            RandomHash_Tiger2_5_192(inputs[i], outputs[i]);
+    }
+}
+//Round 1 header midstate : the state after the blocks before the nonce, then the rest of the header from it
+inline void RandomHash_Tiger2_5_192_HeaderPrefix(const uint8_t* header, uint8_t* midstate)
+{
+    const uint32_t Tiger2_BlockSize = 64;
+    RH_ALIGN(64) uint64_t block[Tiger2_BlockSize / 8];
+    uint64_t* state = (uint64_t*)midstate;
+    state[0] = 0x0123456789ABCDEF;
+    state[1] = 0xFEDCBA9876543210;
+    state[2] = 0xF096A5B4C3B2E187;
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(Tiger2_BlockSize); b += Tiger2_BlockSize)
+    {
+        memcpy(block, header + b, Tiger2_BlockSize);
+        Tiger2_5_192_Transform(block, state);
+    }
+}
+
+inline void RandomHash_Tiger2_5_192_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output)
+{
+    const uint32_t Tiger2_BlockSize = 64;
+    const uint32_t prefix = PascalHeaderPrefixSize(Tiger2_BlockSize);
+    RH_ALIGN(64) uint64_t state[3];
+    RH_ALIGN(64) uint64_t tail[Tiger2_BlockSize * 2 / 8];
+    memcpy(state, midstate, sizeof(state));
+
+    uint32_t totalLen = RH_STRIDE_GET_SIZE(roundInput);
+    uint8_t* data = RH_STRIDE_GET_DATA(roundInput) + prefix;
+    uint32_t len = totalLen - prefix;
+    uint32_t blockCount = len / Tiger2_BlockSize;
+    for (uint32_t b = 0; b < blockCount; b++)
+        Tiger2_5_192_Transform((uint64_t*)(data + b * Tiger2_BlockSize), state);
+
+    //same padding as the MD family : 0x80, zeros and the LE bit length
+    uint32_t tailBlocks = RH_MD_PadTail((uint8_t*)tail, data + blockCount * Tiger2_BlockSize, len - blockCount * Tiger2_BlockSize, totalLen, Tiger2_BlockSize);
+    for (uint32_t b = 0; b < tailBlocks; b++)
+        Tiger2_5_192_Transform(tail + b * (Tiger2_BlockSize / 8), state);
+
+    RH_STRIDE_SET_SIZE(output, 24);
+    memcpy(RH_STRIDE_GET_DATA(output), state, 24);
+}
+#endif //!RANDOMHASH_CUDA
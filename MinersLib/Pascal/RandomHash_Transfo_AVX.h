@@ -0,0 +1,794 @@
+/**
+ *
+ * Copyright 2018 Polyminer1 <https://github.com/polyminer1>
+ *
+ * To the extent possible under law, the author(s) have dedicated all copyright
+ * and related and neighboring rights to this software to the public domain
+ * worldwide. This software is distributed without any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+///
+/// @file
+/// @copyright Polyminer1, QualiaLibre
+
+//NOTE: This file is included in RandomHash_Cpu.cpp, after RandomHash_inl.h
+
+#pragma once
+
+#if !defined(RANDOMHASH_CUDA)
+
+//AVX2 and AVX-512 versions of the 8 Expand transforms and of the stride accumulator updates.
+//Except for Transfo0, every chunk byte only depends on the source, so the AVX2 loops end with one overlapping
+//vector and the AVX-512 ones with masked loads and stores. The chunk is written right after its source, they never overlap.
+#define RH_AVX512_ISA   "avx512f,avx512bw,avx512vl"
+
+//gcc 12 warns on the _mm512_undefined_* used inside its own intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+RH_TARGET_ISA("avx2")
+inline __m256i RH_Reverse_AVX2(__m256i x)
+{
+    const __m256i rev = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                         15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(x, rev), 0x4E);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline __m512i RH_Reverse_AVX512(__m512i x)
+{
+    const __m512i rev = _mm512_broadcast_i32x4(_mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    x = _mm512_shuffle_epi8(x, rev);
+    return _mm512_shuffle_i64x2(x, x, 0x1B);
+}
+
+//the n first bytes of a zmm
+inline __mmask64 RH_ByteMask64(U32 n)
+{
+    return n >= 64 ? ~0ULL : ((1ULL << n) - 1);
+}
+
+//-------------------------------------------------------------------------------------------------
+//Transfo0 : chunk[i] = source[xorshift32 % size]
+//The xorshift32 step is linear over GF(2), so 8 or 16 steps at once are a 32x32 bit matrix applied as the xor of
+//4 lookups, one per byte of the state. Each lane holds one state of the sequence and jumps 8 or 16 steps per loop.
+//The modulo is done in double precision, exact for 32 bit values, and the source bytes are gathered.
+RH_ALIGN(64) static U32 g_RH_XorShiftJump8[4 * 256];
+RH_ALIGN(64) static U32 g_RH_XorShiftJump16[4 * 256];
+
+inline U32 RH_XorShift32(U32 x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static void RH_InitXorShiftJumpTables()
+{
+    for (U32 p = 0; p < 4; p++)
+    {
+        for (U32 b = 0; b < 256; b++)
+        {
+            U32 x = b << (8 * p);
+            for (U32 s = 0; s < 8; s++)
+                x = RH_XorShift32(x);
+            g_RH_XorShiftJump8[p * 256 + b] = x;
+            for (U32 s = 0; s < 8; s++)
+                x = RH_XorShift32(x);
+            g_RH_XorShiftJump16[p * 256 + b] = x;
+        }
+    }
+}
+
+inline void RH_Transfo0_Tail(U8* head, U8* end, U8* source, U32 size, U32 rndState)
+{
+    while (head < end)
+    {
+        rndState = RH_XorShift32(rndState);
+        *head = source[rndState % size];
+        head++;
+    }
+}
+
+//x % size of 4 lanes. x is converted with its sign bit flipped then 2^31 is added back, the quotient can be one off
+RH_TARGET_ISA("avx2")
+inline __m128i RH_Mod4_AVX2(__m128i x, __m256d invSize, __m256d sizeD)
+{
+    __m256d xd = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(x, _mm_set1_epi32((int)0x80000000))), _mm256_set1_pd(2147483648.0));
+    __m256d q = _mm256_floor_pd(_mm256_mul_pd(xd, invSize));
+    __m256d r = _mm256_sub_pd(xd, _mm256_mul_pd(q, sizeD));
+    r = _mm256_add_pd(r, _mm256_and_pd(_mm256_cmp_pd(r, _mm256_setzero_pd(), _CMP_LT_OQ), sizeD));
+    r = _mm256_sub_pd(r, _mm256_and_pd(_mm256_cmp_pd(r, sizeD, _CMP_GE_OQ), sizeD));
+    return _mm256_cvttpd_epi32(r);
+}
+
+RH_TARGET_ISA("avx2")
+inline __m256i RH_XorShiftJump_AVX2(__m256i x, const U32* table)
+{
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    __m256i r = _mm256_i32gather_epi32((const int*)table, _mm256_and_si256(x, byteMask), 4);
+    r = _mm256_xor_si256(r, _mm256_i32gather_epi32((const int*)table + 256, _mm256_and_si256(_mm256_srli_epi32(x, 8), byteMask), 4));
+    r = _mm256_xor_si256(r, _mm256_i32gather_epi32((const int*)table + 512, _mm256_and_si256(_mm256_srli_epi32(x, 16), byteMask), 4));
+    return _mm256_xor_si256(r, _mm256_i32gather_epi32((const int*)table + 768, _mm256_srli_epi32(x, 24), 4));
+}
+
+RH_TARGET_ISA("avx2")
+void Transfo0_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    U32 rndState = _CM(MurmurHash3_x86_32_Fast)(source, size);
+    if (!rndState)
+        rndState = 1;
+
+    U32 i = 0;
+    if (size >= 16)
+    {
+        RH_ALIGN(32) U32 lanes[8];
+        for (U32 l = 0; l < 8; l++)
+        {
+            rndState = RH_XorShift32(rndState);
+            lanes[l] = rndState;
+        }
+
+        const __m256d sizeD = _mm256_set1_pd((double)size);
+        const __m256d invSize = _mm256_set1_pd(1.0 / size);
+        const __m256i lowBytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                  0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m256i packLanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+        __m256i x = _mm256_load_si256((const __m256i*)lanes);
+        while (true)
+        {
+            __m256i idx = _mm256_setr_m128i(RH_Mod4_AVX2(_mm256_castsi256_si128(x), invSize, sizeD),
+                                            RH_Mod4_AVX2(_mm256_extracti128_si256(x, 1), invSize, sizeD));
+            //the 3 bytes read after the last source byte are in the chunk
+            __m256i b = _mm256_i32gather_epi32((const int*)source, idx, 1);
+            b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(b, lowBytes), packLanes);
+            _mm_storel_epi64((__m128i*)(nextChunk + i), _mm256_castsi256_si128(b));
+            i += 8;
+            if (i + 8 > size)
+                break;
+            x = RH_XorShiftJump_AVX2(x, g_RH_XorShiftJump8);
+        }
+        rndState = (U32)_mm256_extract_epi32(x, 7);
+    }
+    RH_Transfo0_Tail(nextChunk + i, nextChunk + size, source, size, rndState);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline __m512i RH_XorShiftJump_AVX512(__m512i x, const U32* table)
+{
+    const __m512i byteMask = _mm512_set1_epi32(0xFF);
+    __m512i r = _mm512_i32gather_epi32(_mm512_and_si512(x, byteMask), table, 4);
+    r = _mm512_xor_si512(r, _mm512_i32gather_epi32(_mm512_and_si512(_mm512_srli_epi32(x, 8), byteMask), table + 256, 4));
+    r = _mm512_xor_si512(r, _mm512_i32gather_epi32(_mm512_and_si512(_mm512_srli_epi32(x, 16), byteMask), table + 512, 4));
+    return _mm512_xor_si512(r, _mm512_i32gather_epi32(_mm512_srli_epi32(x, 24), table + 768, 4));
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline __m256i RH_Mod8_AVX512(__m256i x, __m512d invSize, __m512d sizeD)
+{
+    __m512d xd = _mm512_cvtepu32_pd(x);
+    __m512d q = _mm512_roundscale_pd(_mm512_mul_pd(xd, invSize), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_sub_pd(xd, _mm512_mul_pd(q, sizeD));
+    r = _mm512_mask_add_pd(r, _mm512_cmp_pd_mask(r, _mm512_setzero_pd(), _CMP_LT_OQ), r, sizeD);
+    r = _mm512_mask_sub_pd(r, _mm512_cmp_pd_mask(r, sizeD, _CMP_GE_OQ), r, sizeD);
+    return _mm512_cvttpd_epu32(r);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo0_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    U32 rndState = _CM(MurmurHash3_x86_32_Fast)(source, size);
+    if (!rndState)
+        rndState = 1;
+
+    U32 i = 0;
+    if (size >= 64)
+    {
+        RH_ALIGN(64) U32 lanes[16];
+        for (U32 l = 0; l < 16; l++)
+        {
+            rndState = RH_XorShift32(rndState);
+            lanes[l] = rndState;
+        }
+
+        const __m512d sizeD = _mm512_set1_pd((double)size);
+        const __m512d invSize = _mm512_set1_pd(1.0 / size);
+        __m512i x = _mm512_load_si512((const __m512i*)lanes);
+        while (true)
+        {
+            __m512i idx = _mm512_inserti64x4(_mm512_castsi256_si512(RH_Mod8_AVX512(_mm512_castsi512_si256(x), invSize, sizeD)),
+                                             RH_Mod8_AVX512(_mm512_extracti64x4_epi64(x, 1), invSize, sizeD), 1);
+            __m512i b = _mm512_i32gather_epi32(idx, source, 1);
+            _mm_storeu_si128((__m128i*)(nextChunk + i), _mm512_cvtepi32_epi8(b));
+            i += 16;
+            if (i + 16 > size)
+                break;
+            x = RH_XorShiftJump_AVX512(x, g_RH_XorShiftJump16);
+        }
+        rndState = (U32)_mm_extract_epi32(_mm512_extracti32x4_epi32(x, 3), 3);
+    }
+    RH_Transfo0_Tail(nextChunk + i, nextChunk + size, source, size, rndState);
+}
+
+//-------------------------------------------------------------------------------------------------
+//Transfo1 : swap the two halves
+RH_TARGET_ISA("avx2")
+inline void RH_Copy_AVX2(U8* dst, const U8* src, U32 n)
+{
+    if (n < 32)
+    {
+        memcpy(dst, src, n);
+        return;
+    }
+    U32 i = 0;
+    for (; i + 32 <= n; i += 32)
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+    if (i < n)
+        _mm256_storeu_si256((__m256i*)(dst + n - 32), _mm256_loadu_si256((const __m256i*)(src + n - 32)));
+}
+
+RH_TARGET_ISA("avx2")
+void Transfo1_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    U32 halfSize = size >> 1;
+    RH_Copy_AVX2(nextChunk, source + halfSize, halfSize);
+    RH_Copy_AVX2(nextChunk + halfSize, source, halfSize);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline void RH_Copy_AVX512(U8* dst, const U8* src, U32 n)
+{
+    U32 i = 0;
+    for (; i + 64 <= n; i += 64)
+        _mm512_storeu_si512((__m512i*)(dst + i), _mm512_loadu_si512((const __m512i*)(src + i)));
+    if (i < n)
+    {
+        __mmask64 m = RH_ByteMask64(n - i);
+        _mm512_mask_storeu_epi8(dst + i, m, _mm512_maskz_loadu_epi8(m, src + i));
+    }
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo1_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    U32 halfSize = size >> 1;
+    RH_Copy_AVX512(nextChunk, source + halfSize, halfSize);
+    RH_Copy_AVX512(nextChunk + halfSize, source, halfSize);
+}
+
+//-------------------------------------------------------------------------------------------------
+//Transfo2 : reverse. The sizes are even so the whole chunk is the reversed source
+RH_TARGET_ISA("avx2")
+void Transfo2_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    if (size < 32)
+    {
+        for (U32 i = 0; i < size; i++)
+            nextChunk[i] = source[size - 1 - i];
+        return;
+    }
+    U32 i = 0;
+    for (; i + 32 <= size; i += 32)
+        _mm256_storeu_si256((__m256i*)(nextChunk + i), RH_Reverse_AVX2(_mm256_loadu_si256((const __m256i*)(source + size - i - 32))));
+    if (i < size)
+        _mm256_storeu_si256((__m256i*)(nextChunk + size - 32), RH_Reverse_AVX2(_mm256_loadu_si256((const __m256i*)source)));
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo2_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    U32 i = 0;
+    for (; i + 64 <= size; i += 64)
+        _mm512_storeu_si512((__m512i*)(nextChunk + i), RH_Reverse_AVX512(_mm512_loadu_si512((const __m512i*)(source + size - i - 64))));
+    if (i < size)
+    {
+        //the t first source bytes end up at the top of a vector loaded 64 - t bytes before the source, masked
+        U32 t = size - i;
+        __m512i v = _mm512_maskz_loadu_epi8(~0ULL << (64 - t), source - (64 - t));
+        _mm512_mask_storeu_epi8(nextChunk + i, RH_ByteMask64(t), RH_Reverse_AVX512(v));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//Transfo3 and Transfo4 : interleave the two halves. dst[2k] = a[k], dst[2k + 1] = b[k]
+RH_TARGET_ISA("avx2")
+inline void RH_Interleave_AVX2(U8* dst, const U8* a, const U8* b, U32 n)
+{
+    if (n < 32)
+    {
+        for (U32 k = 0; k < n; k++)
+        {
+            dst[2 * k] = a[k];
+            dst[2 * k + 1] = b[k];
+        }
+        return;
+    }
+    U32 k = 0;
+    while (true)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + k));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + k));
+        __m256i lo = _mm256_unpacklo_epi8(va, vb);
+        __m256i hi = _mm256_unpackhi_epi8(va, vb);
+        _mm256_storeu_si256((__m256i*)(dst + 2 * k), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(dst + 2 * k + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+        if (k + 32 == n)
+            break;
+        k += 32;
+        if (k + 32 > n)
+            k = n - 32;
+    }
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline void RH_Interleave_AVX512(U8* dst, const U8* a, const U8* b, U32 n)
+{
+    const __m512i idx0 = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+    const __m512i idx1 = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+    for (U32 k = 0; k < n; k += 64)
+    {
+        U32 t = RH_Min(n - k, 64U);
+        __mmask64 m = RH_ByteMask64(t);
+        __m512i va = _mm512_maskz_loadu_epi8(m, a + k);
+        __m512i vb = _mm512_maskz_loadu_epi8(m, b + k);
+        __m512i lo = _mm512_unpacklo_epi8(va, vb);
+        __m512i hi = _mm512_unpackhi_epi8(va, vb);
+        _mm512_mask_storeu_epi8(dst + 2 * k, RH_ByteMask64(2 * t), _mm512_permutex2var_epi64(lo, idx0, hi));
+        if (t > 32)
+            _mm512_mask_storeu_epi8(dst + 2 * k + 64, RH_ByteMask64(2 * t - 64), _mm512_permutex2var_epi64(lo, idx1, hi));
+    }
+}
+
+RH_TARGET_ISA("avx2")
+void Transfo3_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    U32 halfSize = size >> 1;
+    RH_Interleave_AVX2(nextChunk, source, source + halfSize, halfSize);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo3_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    U32 halfSize = size >> 1;
+    RH_Interleave_AVX512(nextChunk, source, source + halfSize, halfSize);
+}
+
+RH_TARGET_ISA("avx2")
+void Transfo4_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    U32 halfSize = size >> 1;
+    RH_Interleave_AVX2(nextChunk, source + halfSize, source, halfSize);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo4_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    U32 halfSize = size >> 1;
+    RH_Interleave_AVX512(nextChunk, source + halfSize, source, halfSize);
+}
+
+//-------------------------------------------------------------------------------------------------
+//Transfo5 : the first half is the xor of the byte pairs, the second half the xor of the source with its reverse
+RH_TARGET_ISA("avx2")
+inline __m256i RH_XorPairs_AVX2(const U8* src)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00FF);
+    __m256i a = _mm256_loadu_si256((const __m256i*)src);
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + 32));
+    a = _mm256_and_si256(_mm256_xor_si256(a, _mm256_srli_epi16(a, 8)), lowBytes);
+    b = _mm256_and_si256(_mm256_xor_si256(b, _mm256_srli_epi16(b, 8)), lowBytes);
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+RH_TARGET_ISA("avx2")
+void Transfo5_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    const U32 halfSize = size >> 1;
+    if (halfSize < 32)
+    {
+        for (U32 k = 0; k < halfSize; k++)
+        {
+            nextChunk[k] = source[2 * k] ^ source[2 * k + 1];
+            nextChunk[k + halfSize] = source[k] ^ source[size - 1 - k];
+        }
+        return;
+    }
+
+    U32 k = 0;
+    while (true)
+    {
+        _mm256_storeu_si256((__m256i*)(nextChunk + k), RH_XorPairs_AVX2(source + 2 * k));
+        __m256i r = RH_Reverse_AVX2(_mm256_loadu_si256((const __m256i*)(source + size - k - 32)));
+        _mm256_storeu_si256((__m256i*)(nextChunk + halfSize + k), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(source + k)), r));
+        if (k + 32 == halfSize)
+            break;
+        k += 32;
+        if (k + 32 > halfSize)
+            k = halfSize - 32;
+    }
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo5_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    RH_ASSERT((size % 2) == 0);
+    const U32 halfSize = size >> 1;
+    const __m512i lowBytes = _mm512_set1_epi16(0x00FF);
+    const __m512i packIdx = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    for (U32 k = 0; k < halfSize; k += 64)
+    {
+        U32 t = RH_Min(halfSize - k, 64U);
+        __mmask64 m = RH_ByteMask64(t);
+        __m512i a = _mm512_maskz_loadu_epi8(RH_ByteMask64(2 * t), source + 2 * k);
+        __m512i b = _mm512_maskz_loadu_epi8(t > 32 ? RH_ByteMask64(2 * t - 64) : 0, source + 2 * k + 64);
+        a = _mm512_and_si512(_mm512_xor_si512(a, _mm512_srli_epi16(a, 8)), lowBytes);
+        b = _mm512_and_si512(_mm512_xor_si512(b, _mm512_srli_epi16(b, 8)), lowBytes);
+        _mm512_mask_storeu_epi8(nextChunk + k, m, _mm512_permutexvar_epi64(packIdx, _mm512_packus_epi16(a, b)));
+
+        __m512i r = RH_Reverse_AVX512(_mm512_maskz_loadu_epi8(~0ULL << (64 - t), source + size - k - 64));
+        _mm512_mask_storeu_epi8(nextChunk + halfSize + k, m, _mm512_xor_si512(_mm512_maskz_loadu_epi8(m, source + k), r));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//Transfo6 and Transfo7 : rotate each byte by its distance to the end of the chunk.
+//The rotation has a period of 8 bytes so it is a 16 bit multiply per byte, with the same 64 bit pattern of multipliers
+//for every vector that starts at a multiple of 8. The byte at 'i' is rotated left by (a0 + dir * i) % 8.
+inline void RH_Rot8Multipliers(S32 a0, S32 dir, U64& even, U64& odd)
+{
+    even = 0;
+    odd = 0;
+    for (S32 w = 0; w < 4; w++)
+    {
+        even |= (U64)(1 << ((a0 + dir * 2 * w) & 7)) << (16 * w);
+        odd |= (U64)(1 << ((a0 + dir * (2 * w + 1)) & 7)) << (16 * w);
+    }
+}
+
+RH_TARGET_ISA("avx2")
+inline __m256i RH_Rotl8_AVX2(__m256i x, __m256i mulEven, __m256i mulOdd)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00FF);
+    __m256i e = _mm256_mullo_epi16(_mm256_and_si256(x, lowBytes), mulEven);
+    __m256i o = _mm256_mullo_epi16(_mm256_srli_epi16(x, 8), mulOdd);
+    e = _mm256_and_si256(_mm256_or_si256(e, _mm256_srli_epi16(e, 8)), lowBytes);
+    o = _mm256_slli_epi16(_mm256_or_si256(o, _mm256_srli_epi16(o, 8)), 8);
+    return _mm256_or_si256(e, o);
+}
+
+RH_TARGET_ISA("avx2")
+inline void RH_Rotate8_AVX2(U8* nextChunk, U32 size, U8* source, S32 a0, S32 dir)
+{
+    if (size < 32)
+    {
+        for (U32 i = 0; i < size; i++)
+        {
+            U32 r = (a0 + dir * (S32)i) & 7;
+            nextChunk[i] = (U8)((source[i] << r) | (source[i] >> ((8 - r) & 7)));
+        }
+        return;
+    }
+    U64 even, odd;
+    RH_Rot8Multipliers(a0, dir, even, odd);
+    __m256i mulEven = _mm256_set1_epi64x((S64)even);
+    __m256i mulOdd = _mm256_set1_epi64x((S64)odd);
+    U32 i = 0;
+    for (; i + 32 <= size; i += 32)
+        _mm256_storeu_si256((__m256i*)(nextChunk + i), RH_Rotl8_AVX2(_mm256_loadu_si256((const __m256i*)(source + i)), mulEven, mulOdd));
+    if (i < size)
+    {
+        i = size - 32;
+        RH_Rot8Multipliers(a0 + dir * (S32)i, dir, even, odd);
+        mulEven = _mm256_set1_epi64x((S64)even);
+        mulOdd = _mm256_set1_epi64x((S64)odd);
+        _mm256_storeu_si256((__m256i*)(nextChunk + i), RH_Rotl8_AVX2(_mm256_loadu_si256((const __m256i*)(source + i)), mulEven, mulOdd));
+    }
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline __m512i RH_Rotl8_AVX512(__m512i x, __m512i mulEven, __m512i mulOdd)
+{
+    const __m512i lowBytes = _mm512_set1_epi16(0x00FF);
+    __m512i e = _mm512_mullo_epi16(_mm512_and_si512(x, lowBytes), mulEven);
+    __m512i o = _mm512_mullo_epi16(_mm512_srli_epi16(x, 8), mulOdd);
+    e = _mm512_and_si512(_mm512_or_si512(e, _mm512_srli_epi16(e, 8)), lowBytes);
+    o = _mm512_slli_epi16(_mm512_or_si512(o, _mm512_srli_epi16(o, 8)), 8);
+    return _mm512_or_si512(e, o);
+}
+
+//under 256 bytes the split 64 byte stores cost more than they save
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline void RH_Rotate8_AVX512(U8* nextChunk, U32 size, U8* source, S32 a0, S32 dir)
+{
+    if (size < 256)
+    {
+        RH_Rotate8_AVX2(nextChunk, size, source, a0, dir);
+        return;
+    }
+    U64 even, odd;
+    RH_Rot8Multipliers(a0, dir, even, odd);
+    const __m512i mulEven = _mm512_set1_epi64((S64)even);
+    const __m512i mulOdd = _mm512_set1_epi64((S64)odd);
+    for (U32 i = 0; i < size; i += 64)
+    {
+        __mmask64 m = RH_ByteMask64(size - i);
+        _mm512_mask_storeu_epi8(nextChunk + i, m, RH_Rotl8_AVX512(_mm512_maskz_loadu_epi8(m, source + i), mulEven, mulOdd));
+    }
+}
+
+//ROTL8(source[i], size - i)
+RH_TARGET_ISA("avx2")
+void Transfo6_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    RH_Rotate8_AVX2(nextChunk, size, source, (S32)size, -1);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo6_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    RH_Rotate8_AVX512(nextChunk, size, source, (S32)size, -1);
+}
+
+//ROTR8(source[i], size - i), a left rotation by i - size
+RH_TARGET_ISA("avx2")
+void Transfo7_2_AVX2(U8* nextChunk, U32 size, U8* source)
+{
+    RH_Rotate8_AVX2(nextChunk, size, source, -(S32)size, 1);
+}
+
+RH_TARGET_ISA(RH_AVX512_ISA)
+void Transfo7_2_AVX512(U8* nextChunk, U32 size, U8* source)
+{
+    RH_Rotate8_AVX512(nextChunk, size, source, -(S32)size, 1);
+}
+
+//-------------------------------------------------------------------------------------------------
+//Stride accumulator updates. The k1 mix of 8 or 16 words is done at once, h1 (and h2) stay serial chains.
+//Like the 64 bit versions, the last bytes that do not fill a word go in the pending buffer of the accumulator.
+#define RH_MURMUR3_MIX_CHAIN(k, count)                  \
+    for (U32 w = 0; w < (count); w++)                   \
+    {                                                   \
+        RH_MURMUR3_BODY_2(k[w], h1);                    \
+        if (DUO)                                        \
+        {                                               \
+            RH_MURMUR3_BODY_2(k[w], h2);                \
+        }                                               \
+    }
+
+template <bool DUO>
+RH_TARGET_ISA("avx2")
+inline void RH_Murmur3Update_AVX2(U8* strideArray, U32 elementIdx, U8* strideArray2)
+{
+    RH_StridePtr lstride = RH_STRIDEARRAY_GET(strideArray, elementIdx);
+    U32 size = RH_STRIDE_GET_SIZE(lstride);
+    lstride = RH_STRIDE_GET_DATA(lstride);
+
+    MurmurHash3_x86_32_State* mm3_array1 = RH_StrideArrayStruct_GetAccum(strideArray);
+    MurmurHash3_x86_32_State* mm3_array2 = DUO ? RH_StrideArrayStruct_GetAccum(strideArray2) : 0;
+    RH_ASSERT(mm3_array1->idx == 0);
+    U32 h1 = mm3_array1->h1;
+    U32 h2 = DUO ? mm3_array2->h1 : 0;
+
+    const __m256i c1 = _mm256_set1_epi32((int)MurmurHash3_x86_32_c1);
+    const __m256i c2 = _mm256_set1_epi32((int)MurmurHash3_x86_32_c2);
+    RH_ALIGN(32) U32 k[8];
+    U32 i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i r = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(lstride + i)), c1);
+        r = _mm256_or_si256(_mm256_slli_epi32(r, 15), _mm256_srli_epi32(r, 17));
+        _mm256_store_si256((__m256i*)k, _mm256_mullo_epi32(r, c2));
+        RH_MURMUR3_MIX_CHAIN(k, 8);
+    }
+    for (; i + 4 <= size; i += 4)
+    {
+        U32 k1 = *(U32*)(lstride + i);
+        k1 *= MurmurHash3_x86_32_c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= MurmurHash3_x86_32_c2;
+        RH_MURMUR3_MIX_CHAIN((&k1), 1);
+    }
+
+    mm3_array1->h1 = h1;
+    mm3_array1->totalLen += i;
+    if (DUO)
+    {
+        mm3_array2->h1 = h2;
+        mm3_array2->totalLen += i;
+    }
+    if (i < size)
+    {
+        U64 r0 = *((U64 *)(lstride + i));
+        _CM(MurmurHash3_x86_32_Update_8)(r0, size - i, mm3_array1);
+        if (DUO)
+            _CM(MurmurHash3_x86_32_Update_8)(r0, size - i, mm3_array2);
+    }
+}
+
+template <bool DUO>
+RH_TARGET_ISA(RH_AVX512_ISA)
+inline void RH_Murmur3Update_AVX512(U8* strideArray, U32 elementIdx, U8* strideArray2)
+{
+    RH_StridePtr lstride = RH_STRIDEARRAY_GET(strideArray, elementIdx);
+    U32 size = RH_STRIDE_GET_SIZE(lstride);
+    lstride = RH_STRIDE_GET_DATA(lstride);
+
+    MurmurHash3_x86_32_State* mm3_array1 = RH_StrideArrayStruct_GetAccum(strideArray);
+    MurmurHash3_x86_32_State* mm3_array2 = DUO ? RH_StrideArrayStruct_GetAccum(strideArray2) : 0;
+    RH_ASSERT(mm3_array1->idx == 0);
+    U32 h1 = mm3_array1->h1;
+    U32 h2 = DUO ? mm3_array2->h1 : 0;
+
+    const __m512i c1 = _mm512_set1_epi32((int)MurmurHash3_x86_32_c1);
+    const __m512i c2 = _mm512_set1_epi32((int)MurmurHash3_x86_32_c2);
+    const U32 words = size / 4;
+    RH_ALIGN(64) U32 k[16];
+    for (U32 w = 0; w < words; w += 16)
+    {
+        U32 count = RH_Min(words - w, 16U);
+        __m512i r = _mm512_maskz_loadu_epi32((__mmask16)((1U << count) - 1), lstride + w * 4);
+        r = _mm512_mullo_epi32(r, c1);
+        r = _mm512_rol_epi32(r, 15);
+        _mm512_store_si512((__m512i*)k, _mm512_mullo_epi32(r, c2));
+        RH_MURMUR3_MIX_CHAIN(k, count);
+    }
+
+    U32 i = words * 4;
+    mm3_array1->h1 = h1;
+    mm3_array1->totalLen += i;
+    if (DUO)
+    {
+        mm3_array2->h1 = h2;
+        mm3_array2->totalLen += i;
+    }
+    if (i < size)
+    {
+        U64 r0 = *((U64 *)(lstride + i));
+        _CM(MurmurHash3_x86_32_Update_8)(r0, size - i, mm3_array1);
+        if (DUO)
+            _CM(MurmurHash3_x86_32_Update_8)(r0, size - i, mm3_array2);
+    }
+}
+#undef RH_MURMUR3_MIX_CHAIN
+
+void RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX2_ANY(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray)
+{
+    if (r5p2AccumArray)
+    {
+        RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
+        RH_Murmur3Update_AVX2<true>(strideArray, elementIdx, r5p2AccumArray);
+    }
+    else
+        RH_Murmur3Update_AVX2<false>(strideArray, elementIdx, 0);
+}
+
+void RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX512_ANY(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray)
+{
+    if (r5p2AccumArray)
+    {
+        RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
+        RH_Murmur3Update_AVX512<true>(strideArray, elementIdx, r5p2AccumArray);
+    }
+    else
+        RH_Murmur3Update_AVX512<false>(strideArray, elementIdx, 0);
+}
+
+//Up to 8 independent accumulator streams, one per 32 bit lane. The lanes advance by blocks of 32 bytes, loaded
+//transposed like the multi-buffer hashes, so the 8 h1 chains run side by side instead of one after the other.
+//The pending bytes of an accumulator, the stride tails under a block and the stride changes are done with the
+//scalar update, then the lane joins the next blocks. Lanes without a full block read a zero block and are not stored.
+RH_TARGET_ISA("avx2")
+void RH_Murmur3UpdateStreams_AVX2(RH_MurmurStream* streams, U32 count)
+{
+    RH_ASSERT(count <= 8);
+    RH_ALIGN(32) static const U8 zeroBlock[32] = { 0 };
+    RH_ALIGN(32) U32 h[8];
+    const U8* ptr[8];
+    U32 left[8];
+    U32 next[8];
+    for (U32 i = 0; i < 8; i++)
+    {
+        ptr[i] = zeroBlock;
+        left[i] = 0;
+        next[i] = 0;
+    }
+
+    const __m256i c1 = _mm256_set1_epi32((int)MurmurHash3_x86_32_c1);
+    const __m256i c2 = _mm256_set1_epi32((int)MurmurHash3_x86_32_c2);
+    const __m256i c3 = _mm256_set1_epi32((int)MurmurHash3_x86_32_c3);
+    while (true)
+    {
+        U32 activeMask = 0;
+        U32 blocks = U32_Max;
+        for (U32 i = 0; i < count; i++)
+        {
+            RH_MurmurStream& stream = streams[i];
+            while (left[i] < 32 || stream.accum->idx)
+            {
+                if (left[i])
+                {
+                    U32 n = stream.accum->idx ? RH_Min(4 - stream.accum->idx, left[i]) : left[i];
+                    _CM(MurmurHash3_x86_32_Update)(ptr[i], n, stream.accum);
+                    ptr[i] += n;
+                    left[i] -= n;
+                }
+                else if (next[i] < stream.count)
+                {
+                    RH_StridePtr stride = stream.strides[next[i]++];
+                    ptr[i] = RH_STRIDE_GET_DATA(stride);
+                    left[i] = RH_STRIDE_GET_SIZE(stride);
+                }
+                else
+                    break;
+            }
+
+            if (left[i])
+            {
+                activeMask |= 1 << i;
+                blocks = RH_Min(blocks, left[i] / 32);
+                h[i] = stream.accum->h1;
+            }
+            else
+                ptr[i] = zeroBlock;
+        }
+        if (!activeMask)
+            break;
+
+        const U8* m[8];
+        U32 step[8];
+        for (U32 i = 0; i < 8; i++)
+        {
+            m[i] = ptr[i];
+            step[i] = (activeMask & (1 << i)) ? 32 : 0;
+        }
+
+        __m256i h1 = _mm256_load_si256((const __m256i*)h);
+        for (U32 b = 0; b < blocks; b++)
+        {
+            RH_U32x8 w[8];
+            RH_U32x8_LoadTransposed(m, 0, w);
+            for (U32 k = 0; k < 8; k++)
+            {
+                __m256i k1 = _mm256_mullo_epi32(RH_U32X8_TO_M256(w[k]), c1);
+                k1 = _mm256_or_si256(_mm256_slli_epi32(k1, 15), _mm256_srli_epi32(k1, 17));
+                k1 = _mm256_mullo_epi32(k1, c2);
+                h1 = _mm256_xor_si256(h1, k1);
+                h1 = _mm256_or_si256(_mm256_slli_epi32(h1, 13), _mm256_srli_epi32(h1, 19));
+                h1 = _mm256_add_epi32(_mm256_slli_epi32(h1, 2), _mm256_add_epi32(h1, c3));
+            }
+            for (U32 i = 0; i < 8; i++)
+                m[i] += step[i];
+        }
+        _mm256_store_si256((__m256i*)h, h1);
+
+        for (U32 i = 0; i < count; i++)
+        {
+            if (activeMask & (1 << i))
+            {
+                streams[i].accum->h1 = h[i];
+                streams[i].accum->totalLen += blocks * 32;
+                ptr[i] += blocks * 32;
+                left[i] -= blocks * 32;
+            }
+        }
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif //!RANDOMHASH_CUDA
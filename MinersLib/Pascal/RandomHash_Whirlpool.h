@@ -333,6 +333,48 @@ inline static uint32_t CUDA_SYM_DECL(maskWithReductionPolynomial)(const uint32_t
 	return result;
 }
 
+#if !defined(RANDOMHASH_CUDA)
+extern int g_smallHashTables;
+#define WHIRLPOOL_SMALL_TABLES (g_smallHashTables != 0)
+#else
+#define WHIRLPOOL_SMALL_TABLES false
+#endif
+
+//one row of the round function. WhirlPool_C1..C7 are WhirlPool_C0 rotated by 8..56 bits,
+//so the small table version only touches the 2 KB of WhirlPool_C0 instead of 16 KB
+#define WHIRLPOOL_ROW_8T(src, i) \
+    (WhirlPool_C0[uint8_t(src[(i - 0) & 7] >> 56)] ^ \
+     WhirlPool_C1[uint8_t(src[(i - 1) & 7] >> 48)] ^ \
+     WhirlPool_C2[uint8_t(src[(i - 2) & 7] >> 40)] ^ \
+     WhirlPool_C3[uint8_t(src[(i - 3) & 7] >> 32)] ^ \
+     WhirlPool_C4[uint8_t(src[(i - 4) & 7] >> 24)] ^ \
+     WhirlPool_C5[uint8_t(src[(i - 5) & 7] >> 16)] ^ \
+     WhirlPool_C6[uint8_t(src[(i - 6) & 7] >> 8)] ^ \
+     WhirlPool_C7[uint8_t(src[(i - 7) & 7])])
+
+#define WHIRLPOOL_ROW_1T(src, i) \
+    (WhirlPool_C0[uint8_t(src[(i - 0) & 7] >> 56)] ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 1) & 7] >> 48)], 8) ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 2) & 7] >> 40)], 16) ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 3) & 7] >> 32)], 24) ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 4) & 7] >> 24)], 32) ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 5) & 7] >> 16)], 40) ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 6) & 7] >> 8)], 48) ^ \
+     ROTR64(WhirlPool_C0[uint8_t(src[(i - 7) & 7])], 56))
+
+#define WHIRLPOOL_ROW(src, i) (SmallTable ? WHIRLPOOL_ROW_1T(src, i) : WHIRLPOOL_ROW_8T(src, i))
+
+#define WHIRLPOOL_ROWS(dst, src) \
+    dst[0] = WHIRLPOOL_ROW(src, 0); \
+    dst[1] = WHIRLPOOL_ROW(src, 1); \
+    dst[2] = WHIRLPOOL_ROW(src, 2); \
+    dst[3] = WHIRLPOOL_ROW(src, 3); \
+    dst[4] = WHIRLPOOL_ROW(src, 4); \
+    dst[5] = WHIRLPOOL_ROW(src, 5); \
+    dst[6] = WHIRLPOOL_ROW(src, 6); \
+    dst[7] = WHIRLPOOL_ROW(src, 7);
+
+template <bool SmallTable>
 void CUDA_SYM_DECL(WhirlPool_Transform)(uint64_t* inData, uint64_t* hash)
 {
     RH_ALIGN(64) uint64_t data[8]; //BE
@@ -353,37 +395,15 @@ void CUDA_SYM_DECL(WhirlPool_Transform)(uint64_t* inData, uint64_t* hash)
 		
 	for (register uint32_t round = 1; round < 10 + 1; round++)
 	{
-		for (uint32_t i = 0; i < 8; i++)
-		{
-			m[i] = 0;
-			m[i] = m[i] ^ (WhirlPool_C0[uint8_t(k[(i - 0) & 7] >> 56)]);
-			m[i] = m[i] ^ (WhirlPool_C1[uint8_t(k[(i - 1) & 7] >> 48)]);
-			m[i] = m[i] ^ (WhirlPool_C2[uint8_t(k[(i - 2) & 7] >> 40)]);
-			m[i] = m[i] ^ (WhirlPool_C3[uint8_t(k[(i - 3) & 7] >> 32)]);
-			m[i] = m[i] ^ (WhirlPool_C4[uint8_t(k[(i - 4) & 7] >> 24)]);
-			m[i] = m[i] ^ (WhirlPool_C5[uint8_t(k[(i - 5) & 7] >> 16)]);
-			m[i] = m[i] ^ (WhirlPool_C6[uint8_t(k[(i - 6) & 7] >> 8)]);
-			m[i] = m[i] ^ (WhirlPool_C7[uint8_t(k[(i - 7) & 7])]);
-
-		}
+		WHIRLPOOL_ROWS(m, k);
 		
 		memcpy(k, m, 8 * sizeof(uint64_t));
 
 		k[0] = k[0] ^ WhirlPool_rc[round];
 
+		WHIRLPOOL_ROWS(m, temp);
 		for (uint32_t i = 0; i < 8; i++)
-		{
-			m[i] = k[i];
-			m[i] = m[i] ^ (WhirlPool_C0[uint8_t(temp[(i - 0) & 7] >> 56)]);
-			m[i] = m[i] ^ (WhirlPool_C1[uint8_t(temp[(i - 1) & 7] >> 48)]);
-			m[i] = m[i] ^ (WhirlPool_C2[uint8_t(temp[(i - 2) & 7] >> 40)]);
-			m[i] = m[i] ^ (WhirlPool_C3[uint8_t(temp[(i - 3) & 7] >> 32)]);
-			m[i] = m[i] ^ (WhirlPool_C4[uint8_t(temp[(i - 4) & 7] >> 24)]);
-			m[i] = m[i] ^ (WhirlPool_C5[uint8_t(temp[(i - 5) & 7] >> 16)]);
-			m[i] = m[i] ^ (WhirlPool_C6[uint8_t(temp[(i - 6) & 7] >> 8)]);
-			m[i] = m[i] ^ (WhirlPool_C7[uint8_t(temp[(i - 7) & 7])]);
-
-		}
+			m[i] ^= k[i];
 
 		memcpy(temp, m, 8 * sizeof(uint64_t));
 	}
@@ -395,6 +415,13 @@ void CUDA_SYM_DECL(WhirlPool_Transform)(uint64_t* inData, uint64_t* hash)
 	}
 }
 
+#define WHIRLPOOL_TRANSFORM(ptr, state) \
+    { \
+        if (smallTable) \
+            _CM(WhirlPool_Transform)<true>(ptr, state); \
+        else \
+            _CM(WhirlPool_Transform)<false>(ptr, state); \
+    }
 
 void CUDA_SYM_DECL(RandomHash_WhirlPool)(RH_StridePtr roundInput, RH_StridePtr output)
 {
@@ -404,6 +431,7 @@ void CUDA_SYM_DECL(RandomHash_WhirlPool)(RH_StridePtr roundInput, RH_StridePtr o
     const uint32_t Whirlpool_HashSize = 64;
     RH_ALIGN(64) uint64_t state[8];
     RH_memzero_64(state, sizeof(state));
+    const bool smallTable = WHIRLPOOL_SMALL_TABLES;
 
     //body
     int32_t len = (int32_t)RH_STRIDE_GET_SIZE(roundInput);
@@ -412,7 +440,7 @@ void CUDA_SYM_DECL(RandomHash_WhirlPool)(RH_StridePtr roundInput, RH_StridePtr o
     uint64_t bits = len * 8;
     while (blockCount > 0)
     {
-        _CM(WhirlPool_Transform)(dataPtr, state);
+        WHIRLPOOL_TRANSFORM(dataPtr, state);
         len -= Whirlpool_BlockSize;
         dataPtr += Whirlpool_BlockSize / 8;
         blockCount--;
@@ -439,10 +467,10 @@ void CUDA_SYM_DECL(RandomHash_WhirlPool)(RH_StridePtr roundInput, RH_StridePtr o
         RH_ASSERT(padindex <= sizeof(pad));
         RH_ASSERT(((padindex + len) % Whirlpool_BlockSize) == 0);
 
-        _CM(WhirlPool_Transform)(dataPtr, state);
+        WHIRLPOOL_TRANSFORM(dataPtr, state);
         padindex -= Whirlpool_BlockSize;
         if (padindex > 0)
-            _CM(WhirlPool_Transform)(dataPtr + (Whirlpool_BlockSize / 8), state);
+            WHIRLPOOL_TRANSFORM(dataPtr + (Whirlpool_BlockSize / 8), state);
     }
 
     dataPtr = (uint64_t*)RH_STRIDE_GET_DATA(output);
@@ -450,3 +478,53 @@ void CUDA_SYM_DECL(RandomHash_WhirlPool)(RH_StridePtr roundInput, RH_StridePtr o
     copy8_op(dataPtr, state, ReverseBytesUInt64);
 
 }
+
+
+#if !defined(RANDOMHASH_CUDA)
+//Round 1 header midstate : the state after the blocks before the nonce, then the rest of the header from it
+inline void RandomHash_WhirlPool_HeaderPrefix(const uint8_t* header, uint8_t* midstate)
+{
+    const uint32_t Whirlpool_BlockSize = 64;
+    const bool smallTable = WHIRLPOOL_SMALL_TABLES;
+    RH_ALIGN(64) uint64_t block[Whirlpool_BlockSize / 8];
+    uint64_t* state = (uint64_t*)midstate;
+    RH_memzero_64(state, 8 * sizeof(uint64_t));
+    for (uint32_t b = 0; b < PascalHeaderPrefixSize(Whirlpool_BlockSize); b += Whirlpool_BlockSize)
+    {
+        memcpy(block, header + b, Whirlpool_BlockSize);
+        WHIRLPOOL_TRANSFORM(block, state);
+    }
+}
+
+inline void RandomHash_WhirlPool_FromMidstate(const uint8_t* midstate, RH_StridePtr roundInput, RH_StridePtr output)
+{
+    const uint32_t Whirlpool_BlockSize = 64;
+    const uint32_t prefix = PascalHeaderPrefixSize(Whirlpool_BlockSize);
+    const bool smallTable = WHIRLPOOL_SMALL_TABLES;
+    RH_ALIGN(64) uint64_t state[8];
+    RH_ALIGN(64) uint64_t tail[Whirlpool_BlockSize * 2 / 8];
+    memcpy(state, midstate, sizeof(state));
+
+    uint32_t totalLen = RH_STRIDE_GET_SIZE(roundInput);
+    uint8_t* data = RH_STRIDE_GET_DATA(roundInput) + prefix;
+    uint32_t len = totalLen - prefix;
+    uint32_t blockCount = len / Whirlpool_BlockSize;
+    for (uint32_t b = 0; b < blockCount; b++)
+        WHIRLPOOL_TRANSFORM((uint64_t*)(data + b * Whirlpool_BlockSize), state);
+
+    //0x80, zeros and the BE bit length at the end of a 32 bytes length field
+    len -= blockCount * Whirlpool_BlockSize;
+    uint32_t tailBlocks = len > 31 ? 2 : 1;
+    uint8_t* tailBytes = (uint8_t*)tail;
+    RH_memzero_of16(tailBytes, sizeof(tail));
+    memcpy(tailBytes, data + blockCount * Whirlpool_BlockSize, len);
+    tailBytes[len] = 0x80;
+    ReadUInt64AsBytesLE(ReverseBytesUInt64((uint64_t)totalLen * 8), tailBytes + tailBlocks * Whirlpool_BlockSize - 8);
+    for (uint32_t b = 0; b < tailBlocks; b++)
+        WHIRLPOOL_TRANSFORM(tail + b * (Whirlpool_BlockSize / 8), state);
+
+    uint64_t* dataPtr = (uint64_t*)RH_STRIDE_GET_DATA(output);
+    RH_STRIDE_SET_SIZE(output, 64);
+    copy8_op(dataPtr, state, ReverseBytesUInt64);
+}
+#endif //!RANDOMHASH_CUDA
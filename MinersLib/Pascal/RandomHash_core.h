@@ -46,6 +46,7 @@ enum RandomHashAlgos
     RH_RadioGatun32    = 16,
     RH_Whirlpool       = 17
 };
+#define RH_ALGO_COUNT 18
 
 //------------------------------------------------------------------------------------
 typedef U8* RH_StridePtr;
@@ -45,6 +45,9 @@
     #define RH_TOTAL_STRIDES_INSTANCES ((RH_StrideArrayCount+1))
 #else
     #define RH_TOTAL_STRIDES_INSTANCES (RH_StrideArrayCount+1)
+
+    //Seed and twist the mersenne twister on demand. Most reseeds only draw a few values.
+    #define RH_ENABLE_MT_LAZY_SEED
  #endif
 
 #define RH_STRIDE_BANK_SIZE 5033984
@@ -19,7 +19,6 @@
 
 #ifdef RHMINER_PLATFORM_CPU
 extern int  g_memoryBoostLevel;
-extern int  g_sseOptimization;
 
 #define _RH_LD_LINE_128(i) r##i = RH_MM_LOAD128((__m128i *)(source)); 
 #define RH_LD_LINE_128(i) r##i = RH_MM_LOAD128((__m128i *)(source)); source += sizeof(__m128i);
@@ -269,6 +268,49 @@ CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_2_boo
 }
 
 
+//Two accumulators over a raw block, the pending bytes are carried from block to block.
+//RandomHash_Expand folds its chunks with it while they are still in the cache.
+CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(RH_Murmur3Update_2)(const U8* data, U32 size, MurmurHash3_x86_32_State* mm3_array1, MurmurHash3_x86_32_State* mm3_array2)
+{
+    if (mm3_array1->idx || mm3_array2->idx)
+    {
+        _CM(MurmurHash3_x86_32_Update)(data, size, mm3_array1);
+        _CM(MurmurHash3_x86_32_Update)(data, size, mm3_array2);
+        return;
+    }
+
+    register U32 h1 = mm3_array1->h1;
+    register U32 h2 = mm3_array2->h1;
+    U32 n = (size / sizeof(U64)) * sizeof(U64);
+    const U8* end = data + n;
+    U64 r0;
+    U32 k1;
+    mm3_array1->totalLen += n;
+    mm3_array2->totalLen += n;
+    while (data != end)
+    {
+        r0 = *(U64*)(data);
+        data += sizeof(U64);
+
+        k1 = (U32)r0 * MurmurHash3_x86_32_c1;
+        k1 = ROTL32(k1, 15) * MurmurHash3_x86_32_c2;
+        RH_MURMUR3_BODY_2(k1, h1);
+        RH_MURMUR3_BODY_2(k1, h2);
+        k1 = (U32)(r0 >> 32) * MurmurHash3_x86_32_c1;
+        k1 = ROTL32(k1, 15) * MurmurHash3_x86_32_c2;
+        RH_MURMUR3_BODY_2(k1, h1);
+        RH_MURMUR3_BODY_2(k1, h2);
+    }
+    mm3_array1->h1 = h1;
+    mm3_array2->h1 = h2;
+    if (size - n)
+    {
+        _CM(MurmurHash3_x86_32_Update)(data, size - n, mm3_array1);
+        _CM(MurmurHash3_x86_32_Update)(data, size - n, mm3_array2);
+    }
+}
+
+
 #if defined(RHMINER_ENABLE_SSE4) /*&& defined(RH_COMPILE_CPU_ONLY)*/ && !defined(__CUDA_ARCH__)
 
 #if defined(RANDOMHASH_CUDA) || defined(RHMINER_NO_SSE4)
@@ -284,6 +326,7 @@ static inline __m128i _mm_mullo_epi32_EMU(const __m128i &a, const __m128i &b)
 #define _mm_mullo_epi32_M _mm_mullo_epi32
 #endif //#if defined(RANDOMHASH_CUDA) || defined(RHMINER_NO_SSE4)
 
+RH_TARGET_ISA("sse4.1")
 void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41)(U8* strideArray, U32 elementIdx)
 {    
     RH_StridePtr lstride = RH_STRIDEARRAY_GET(strideArray, elementIdx);
@@ -334,15 +377,20 @@ void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41)(U8* strideArray, U32 element
     back_h1 = h1;
     if (m)
     {
-        RH_ASSERT(m <= sizeof(U64));
-
         U64 r0 = *((U64 *)(lstride));
+        if (m > sizeof(U64))
+        {
+            INPLACE_M_MurmurHash3_x86_32_Update_8(r0, sizeof(U64)); 
+            r0 = *((U64 *)(lstride + sizeof(U64)));
+            m -= sizeof(U64);
+        }
         INPLACE_M_MurmurHash3_x86_32_Update_8(r0, m); 
     }
     
     RH_MUR3_RESTORE_STATE(RH_StrideArrayStruct_GetAccum(strideArray));
 }
 
+RH_TARGET_ISA("sse4.1")
 void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41_2)(U8* strideArray, U32 elementIdx, U8* strideArray2)
 {    
     RH_StridePtr lstride = RH_STRIDEARRAY_GET(strideArray, elementIdx);
@@ -402,9 +450,14 @@ void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41_2)(U8* strideArray, U32 eleme
     mm3_array2->h1 = h2;
     if (m)
     {
-        RH_ASSERT(m <= sizeof(U64));
         U64 r0 = *((U64 *)(lstride));
-
+        if (m > sizeof(U64))
+        {
+            _CM(MurmurHash3_x86_32_Update_8)(r0, sizeof(U64), mm3_array1);
+            _CM(MurmurHash3_x86_32_Update_8)(r0, sizeof(U64), mm3_array2);
+            r0 = *((U64 *)(lstride + sizeof(U64)));
+            m -= sizeof(U64);
+        }
         _CM(MurmurHash3_x86_32_Update_8)(r0, m, mm3_array1);
         _CM(MurmurHash3_x86_32_Update_8)(r0, m, mm3_array2);
     }
@@ -436,62 +489,43 @@ void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3)(U8* strideArray, U32 elementIdx)
 
 #else  //RANDOMHASH_CUDA
 
-void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3)(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray = 0)
+//Stride array accumulator updates. One of them is picked at startup in g_RH_Kernels.murmurUpdate
+void RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray)
 {
-    U32 sseoOtimization = g_sseOptimization;
-    if (!sseoOtimization)
-    {
-        if (r5p2AccumArray)
-        {   
-            RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
-            
-            if (RH_STRIDEARRAY_GET_EXTRA(strideArray, memoryboost))
-                _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_2_boost)(strideArray, elementIdx, r5p2AccumArray);
-            else
-                _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_2)(strideArray, elementIdx, r5p2AccumArray);
-        }
+    if (r5p2AccumArray)
+    {   
+        RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
+        
+        if (RH_STRIDEARRAY_GET_EXTRA(strideArray, memoryboost))
+            _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_2_boost)(strideArray, elementIdx, r5p2AccumArray);
         else
-        {
-            if (RH_STRIDEARRAY_GET_EXTRA(strideArray, memoryboost))
-                return _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_1_boost)(strideArray, elementIdx);
-            else
-                return _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_1)(strideArray, elementIdx);
-        }
+            _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_2)(strideArray, elementIdx, r5p2AccumArray);
     }
-    else if (sseoOtimization == 1)
+    else
     {
-#if defined(RHMINER_ENABLE_SSE4)
-        if (r5p2AccumArray)
-        {
-            RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
-            return _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41_2)(strideArray, elementIdx, r5p2AccumArray);
-        }
+        if (RH_STRIDEARRAY_GET_EXTRA(strideArray, memoryboost))
+            _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_1_boost)(strideArray, elementIdx);
         else
-            return _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41)(strideArray, elementIdx);
-#else
-        RHMINER_ASSERT(sseoOtimization == 0); 
-#endif  
+            _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_64b_1)(strideArray, elementIdx);
     }
-	else if (sseoOtimization == 2)
+}
+
+#if defined(RHMINER_ENABLE_SSE4)
+void RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41_ANY(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray)
+{
+    if (r5p2AccumArray)
     {
-#if defined(RH_ENABLE_AVX) 
-        if (r5p2AccumArray)
-        {
-            RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
-            extern void RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX2_2(U8* strideArray, U32 elementIdx, U8* strideArray2);
-            return RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX2_2(strideArray, elementIdx, r5p2AccumArray);
-        }
-        else
-        {
-            extern void RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX2(U8* strideArray, U32 elementIdx);
-            return _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_AVX2)(strideArray, elementIdx);
-        }
-#else
-        RHMINER_ASSERT(false);
-#endif
+        RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArray, elementIdx));
+        _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41_2)(strideArray, elementIdx, r5p2AccumArray);
     }
+    else
+        _CM(RH_STRIDE_ARRAY_UPDATE_MURMUR3_SSE41)(strideArray, elementIdx);
+}
+#endif
 
-
+inline void CUDA_SYM(RH_STRIDE_ARRAY_UPDATE_MURMUR3)(U8* strideArray, U32 elementIdx, U8* r5p2AccumArray = 0)
+{
+    g_RH_Kernels.murmurUpdate(strideArray, elementIdx, r5p2AccumArray);
 }
 
 
@@ -521,8 +555,25 @@ void CUDA_SYM(RH_STRIDEARRAY_PUSHBACK_MANY_ALL)(U8* strideArrayVar, U8* strideAr
 }
 
 
+//An accumulator and the strides to fold in it, in order. The streams of different accumulators are independent
+//and g_RH_Kernels.murmurStreams advances many of them at once
+#define RH_MURMUR_STREAMS_MAX   8
+struct RH_MurmurStream
+{
+    MurmurHash3_x86_32_State*   accum;
+    U8**                        strides;
+    U32                         count;
+};
+
+struct RH_MurmurStreamQueue
+{
+    U32             count;
+    RH_MurmurStream streams[RH_MURMUR_STREAMS_MAX];
+};
+
+//With a queue, the accumulator updates are only queued and the accumulators stay unchanged until the queue is run
 CUDA_DECL_DEVICE
-void CUDA_SYM(RH_STRIDEARRAY_PUSHBACK_MANY_UPDATE)(U8* strideArrayVar, U8* strideArrayVarSrc, U8* r5p2AccumArray)
+void CUDA_SYM(RH_STRIDEARRAY_PUSHBACK_MANY_UPDATE)(U8* strideArrayVar, U8* strideArrayVarSrc, U8* r5p2AccumArray, RH_MurmurStreamQueue* queue = 0)
 {
     U32 i = RH_STRIDEARRAY_GET_SIZE(strideArrayVar);
     RH_ASSERT(RH_STRIDEARRAY_GET_SIZE(strideArrayVarSrc) + i);
@@ -531,6 +582,24 @@ void CUDA_SYM(RH_STRIDEARRAY_PUSHBACK_MANY_UPDATE)(U8* strideArrayVar, U8* strid
     RH_STRIDEARRAY_SET_SIZE(strideArrayVar, cnt);
     cnt--;
     
+    if (queue)
+    {
+        RH_ASSERT(queue->count + 2 <= RH_MURMUR_STREAMS_MAX);
+        RH_MurmurStream* streams = queue->streams + queue->count;
+        streams[0].accum = RH_StrideArrayStruct_GetAccum(strideArrayVar);
+        streams[0].strides = ((RH_StrideArrayStruct*)(strideArrayVar))->strides + i;
+        streams[0].count = cnt + 1 - i;
+        while(i <= cnt)
+            ((RH_StrideArrayStruct*)(strideArrayVar))->strides[i++] = ((RH_StrideArrayStruct*)(strideArrayVarSrc))->strides[j++];
+
+        RH_STRIDEARRAY_PUSHBACK(r5p2AccumArray, RH_STRIDEARRAY_GET(strideArrayVar, cnt));
+        streams[1].accum = RH_StrideArrayStruct_GetAccum(r5p2AccumArray);
+        streams[1].strides = ((RH_StrideArrayStruct*)(r5p2AccumArray))->strides + RH_STRIDEARRAY_GET_SIZE(r5p2AccumArray) - 1;
+        streams[1].count = 1;
+        queue->count += 2;
+        return;
+    }
+
     while(i < cnt)
     {
         ((RH_StrideArrayStruct*)(strideArrayVar))->strides[i] = ((RH_StrideArrayStruct*)(strideArrayVarSrc))->strides[j++];
@@ -616,6 +685,7 @@ inline void CUDA_SYM_DECL(Transfo0_2)(U8* nextChunk, U32 size, U8* source)
 
 #if defined(RHMINER_ENABLE_SSE4)
 
+RH_TARGET_ISA("sse4.1")
 inline void CUDA_SYM_DECL(Transfo0_2_128_SSE4)(U8* nextChunk, U32 size, U8* source)
 {
     RH_ASSERT(size <= 128);
@@ -624,6 +694,7 @@ inline void CUDA_SYM_DECL(Transfo0_2_128_SSE4)(U8* nextChunk, U32 size, U8* sour
         rndState = 1;
 
     __m128i r0,r1,r2,r3,r4,r5,r6,r7;
+    r1 = r2 = r3 = r4 = r5 = r6 = r7 = _mm_setzero_si128(); //only the registers under size are read
     switch(size/16)
     {
         case 8:
@@ -721,6 +792,7 @@ inline void CUDA_SYM_DECL(Transfo0_2_128_SSE4)(U8* nextChunk, U32 size, U8* sour
 }
 
 
+RH_TARGET_ISA("sse4.1")
 inline void CUDA_SYM_DECL(Transfo0_2_256_SSE4)(U8* nextChunk, U32 size, U8* source)
 {
     RH_ASSERT(size <= 256);
@@ -848,6 +920,7 @@ inline void CUDA_SYM_DECL(Transfo0_2_128_SSE3)(U8* nextChunk, U32 size, U8* sour
         rndState = 1;
 
     __m128i r0,r1,r2,r3,r4,r5,r6,r7;
+    r1 = r2 = r3 = r4 = r5 = r6 = r7 = _mm_setzero_si128(); //only the registers under size are read
     switch(size/16)
     {
         case 8:
@@ -998,6 +1071,7 @@ void CUDA_SYM_DECL(Transfo3_2)(U8* nextChunk, U32 size, U8* outputPtr)
 
 
 #if defined(RHMINER_ENABLE_SSE4) && !defined(RANDOMHASH_CUDA)
+RH_TARGET_ISA("sse4.1")
 inline void CUDA_SYM_DECL(Transfo4_2_128_SSE4)(U8* nextChunk, U32 size, U8* source)
 {
     RH_ASSERT(size <= 128);
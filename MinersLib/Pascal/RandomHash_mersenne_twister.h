@@ -37,6 +37,8 @@ struct mersenne_twister_state
   RH_ALIGN(RH_IDEAL_ALIGNMENT) uint32_t MT[MERSENNE_TWISTER_SIZE];
   RH_ALIGN(RH_IDEAL_ALIGNMENT) uint32_t MT_TEMPERED[MERSENNE_TWISTER_SIZE];
   RH_ALIGN(RH_IDEAL_ALIGNMENT) size_t index = MERSENNE_TWISTER_SIZE;
+  uint32_t seeded = 0;    //lazy mode : count of MT words initialized by the LCG
+  uint32_t twisted = 0;   //lazy mode : count of MT words of the current generation already twisted
 };
 
 
@@ -53,6 +55,109 @@ struct mersenne_twister_state
   ++i;
 
 
+#if !defined(RANDOMHASH_CUDA)
+extern bool g_isSSE4Supported;
+extern bool g_isAVX2Supported;
+
+/*
+ * SIMD twist and tempering.
+ * Word i only reads the old words i+1 and i+397 (i < 227) or the already twisted word i-227,
+ * so 4 or 8 consecutive words can be twisted at once as long as a block does not cross 227.
+ * The twist functions process the whole blocks of [i .. end) and return where the scalar tail starts.
+ */
+RH_TARGET_ISA("sse4.1")
+inline size_t merssen_twister_twist_SSE4(uint32_t* mt, size_t i, size_t end, ptrdiff_t offset)
+{
+    const __m128i upper = _mm_set1_epi32((int)0x80000000);
+    const __m128i lower = _mm_set1_epi32(0x7FFFFFFF);
+    const __m128i magic = _mm_set1_epi32((int)MERSENNE_TWISTER_MAGIC);
+    while (i + 4 <= end)
+    {
+        __m128i cur = _mm_loadu_si128((const __m128i*)(mt + i));
+        __m128i next = _mm_loadu_si128((const __m128i*)(mt + i + 1));
+        __m128i far = _mm_loadu_si128((const __m128i*)(mt + i + offset));
+        __m128i y = _mm_or_si128(_mm_and_si128(cur, upper), _mm_and_si128(next, lower));
+        __m128i odd = _mm_and_si128(_mm_srai_epi32(_mm_slli_epi32(y, 31), 31), magic);
+        _mm_storeu_si128((__m128i*)(mt + i), _mm_xor_si128(_mm_xor_si128(far, _mm_srli_epi32(y, 1)), odd));
+        i += 4;
+    }
+    return i;
+}
+
+RH_TARGET_ISA("avx2")
+inline size_t merssen_twister_twist_AVX2(uint32_t* mt, size_t i, size_t end, ptrdiff_t offset)
+{
+    const __m256i upper = _mm256_set1_epi32((int)0x80000000);
+    const __m256i lower = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i magic = _mm256_set1_epi32((int)MERSENNE_TWISTER_MAGIC);
+    while (i + 8 <= end)
+    {
+        __m256i cur = _mm256_loadu_si256((const __m256i*)(mt + i));
+        __m256i next = _mm256_loadu_si256((const __m256i*)(mt + i + 1));
+        __m256i far = _mm256_loadu_si256((const __m256i*)(mt + i + offset));
+        __m256i y = _mm256_or_si256(_mm256_and_si256(cur, upper), _mm256_and_si256(next, lower));
+        __m256i odd = _mm256_and_si256(_mm256_srai_epi32(_mm256_slli_epi32(y, 31), 31), magic);
+        _mm256_storeu_si256((__m256i*)(mt + i), _mm256_xor_si256(_mm256_xor_si256(far, _mm256_srli_epi32(y, 1)), odd));
+        i += 8;
+    }
+    return i;
+}
+
+RH_TARGET_ISA("sse4.1")
+inline uint32_t merssen_twister_temper_SSE4(const uint32_t* mt, uint32_t* out, uint32_t count)
+{
+    const __m128i c1 = _mm_set1_epi32((int)0x9d2c5680);
+    const __m128i c2 = _mm_set1_epi32((int)0xefc60000);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i y = _mm_loadu_si128((const __m128i*)(mt + i));
+        y = _mm_xor_si128(y, _mm_srli_epi32(y, 11));
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi32(y, 7), c1));
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi32(y, 15), c2));
+        y = _mm_xor_si128(y, _mm_srli_epi32(y, 18));
+        _mm_storeu_si128((__m128i*)(out + i), y);
+    }
+    return i;
+}
+
+RH_TARGET_ISA("avx2")
+inline uint32_t merssen_twister_temper_AVX2(const uint32_t* mt, uint32_t* out, uint32_t count)
+{
+    const __m256i c1 = _mm256_set1_epi32((int)0x9d2c5680);
+    const __m256i c2 = _mm256_set1_epi32((int)0xefc60000);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i y = _mm256_loadu_si256((const __m256i*)(mt + i));
+        y = _mm256_xor_si256(y, _mm256_srli_epi32(y, 11));
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi32(y, 7), c1));
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi32(y, 15), c2));
+        y = _mm256_xor_si256(y, _mm256_srli_epi32(y, 18));
+        _mm256_storeu_si256((__m256i*)(out + i), y);
+    }
+    return i;
+}
+
+inline size_t merssen_twister_twist_SIMD(uint32_t* mt, size_t i, size_t end, ptrdiff_t offset)
+{
+    if (g_isAVX2Supported)
+        return merssen_twister_twist_AVX2(mt, i, end, offset);
+    if (g_isSSE4Supported)
+        return merssen_twister_twist_SSE4(mt, i, end, offset);
+    return i;
+}
+
+inline uint32_t merssen_twister_temper_SIMD(const uint32_t* mt, uint32_t* out, uint32_t count)
+{
+    if (g_isAVX2Supported)
+        return merssen_twister_temper_AVX2(mt, out, count);
+    if (g_isSSE4Supported)
+        return merssen_twister_temper_SSE4(mt, out, count);
+    return 0;
+}
+#endif //!RANDOMHASH_CUDA
+
 //#define TEST_BOOST
 //mt19937         m_gen;
 inline CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(merssen_twister_seed)(uint32_t value, mersenne_twister_state* state)
@@ -108,6 +213,9 @@ inline CUDA_DECL_HOST_AND_DEVICE uint32_t CUDA_SYM(merssen_twister_rand)(mersenn
       size_t i = 0;
       uint32_t y;
 
+#if !defined(RANDOMHASH_CUDA)
+      i = merssen_twister_twist_SIMD(state->MT, i, MERSENNE_TWISTER_DIFF, MERSENNE_TWISTER_PERIOD);
+#endif
       // i = [0 ... 226]
       while ( i < MERSENNE_TWISTER_DIFF ) {
         /*
@@ -121,6 +229,9 @@ inline CUDA_DECL_HOST_AND_DEVICE uint32_t CUDA_SYM(merssen_twister_rand)(mersenn
     #endif
       }
 
+#if !defined(RANDOMHASH_CUDA)
+      i = merssen_twister_twist_SIMD(state->MT, i, MERSENNE_TWISTER_SIZE - 1, -(ptrdiff_t)MERSENNE_TWISTER_DIFF);
+#endif
       // i = [227 ... 622]
       while ( i < MERSENNE_TWISTER_SIZE -1 ) {
         /*
@@ -151,7 +262,11 @@ inline CUDA_DECL_HOST_AND_DEVICE uint32_t CUDA_SYM(merssen_twister_rand)(mersenn
       }
 
       // Temper all numbers in a batch
-      for (size_t i = 0; i < MERSENNE_TWISTER_SIZE; ++i) {
+      i = 0;
+#if !defined(RANDOMHASH_CUDA)
+      i = merssen_twister_temper_SIMD(state->MT, state->MT_TEMPERED, MERSENNE_TWISTER_SIZE);
+#endif
+      for (; i < MERSENNE_TWISTER_SIZE; ++i) {
         y = state->MT[i];
         y ^= y >> 11;
         y ^= y << 7  & 0x9d2c5680;
@@ -166,4 +281,139 @@ inline CUDA_DECL_HOST_AND_DEVICE uint32_t CUDA_SYM(merssen_twister_rand)(mersenn
     return state->MT_TEMPERED[state->index++];
 }
 
+
+/*
+ * Lazy mode.
+ * RandomHash reseeds its generators many times per nonce but most of them only draw a
+ * handful of values (Compress draws 200). Here the LCG init and the twist are done on demand,
+ * by blocks of MERSENNE_TWISTER_LAZY_BLOCK words, and the tempering is done on each draw.
+ * The first k < 227 draws of a new seed only need the words [0 .. k+397] to be initialized.
+ * The output stream is identical to merssen_twister_rand.
+ */
+#define MERSENNE_TWISTER_LAZY_BLOCK 16
+
+inline CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(merssen_twister_seed_lazy)(uint32_t value, mersenne_twister_state* state)
+{
+    state->MT[0] = value;
+    state->seeded = 1;
+    state->twisted = 0;
+    state->index = 0;
+}
+
+inline CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(merssen_twister_init_lazy)(mersenne_twister_state* state, uint32_t count)
+{
+    uint32_t i = state->seeded;
+    uint32_t v = state->MT[i - 1];
+    while (i < count)
+    {
+        v = 0x6c078965 * (v ^ v >> 30) + i;
+        state->MT[i] = v;
+        ++i;
+    }
+    state->seeded = i;
+}
+
+inline CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(merssen_twister_twist_lazy)(mersenne_twister_state* state, uint32_t count)
+{
+    size_t i = state->twisted;
+    uint32_t y;
+
+    // twisting word i needs the old words i+1 and i+397 (i < 227), the last one needs all of them
+    if (state->seeded < MERSENNE_TWISTER_SIZE)
+    {
+        uint32_t needed = count < MERSENNE_TWISTER_DIFF ? count + MERSENNE_TWISTER_PERIOD : MERSENNE_TWISTER_SIZE;
+        if (state->seeded < needed)
+            _CM(merssen_twister_init_lazy)(state, needed);
+    }
+
+    // i = [0 ... 226]
+    uint32_t end = count < MERSENNE_TWISTER_DIFF ? count : MERSENNE_TWISTER_DIFF;
+#if !defined(RANDOMHASH_CUDA)
+    i = merssen_twister_twist_SIMD(state->MT, i, end, MERSENNE_TWISTER_PERIOD);
+#endif
+    while (i < end)
+    {
+        UNROLL(i+MERSENNE_TWISTER_PERIOD);
+    }
+
+    // i = [227 ... 622]
+    end = count < MERSENNE_TWISTER_SIZE - 1 ? count : MERSENNE_TWISTER_SIZE - 1;
+#if !defined(RANDOMHASH_CUDA)
+    i = merssen_twister_twist_SIMD(state->MT, i, end, -(ptrdiff_t)MERSENNE_TWISTER_DIFF);
+#endif
+    while (i < end)
+    {
+        UNROLL(i-MERSENNE_TWISTER_DIFF);
+    }
+
+    // i = 623, last step rolls over
+    if (count == MERSENNE_TWISTER_SIZE)
+    {
+        y = M32(state->MT[MERSENNE_TWISTER_SIZE-1]) | L31(state->MT[0]);
+        state->MT[MERSENNE_TWISTER_SIZE-1] = state->MT[MERSENNE_TWISTER_PERIOD-1] ^ (y >> 1) ^ (((int32_t(y) << 31) >>
+              31) & MERSENNE_TWISTER_MAGIC);
+    }
+
+    state->twisted = count;
+}
+
+inline CUDA_DECL_HOST_AND_DEVICE uint32_t CUDA_SYM(merssen_twister_rand_lazy)(mersenne_twister_state* state)
+{
+    if (state->index == state->twisted)
+    {
+        if (state->index == MERSENNE_TWISTER_SIZE)
+        {
+            state->index = 0;
+            state->twisted = 0;
+        }
+        uint32_t count = (uint32_t)state->index + MERSENNE_TWISTER_LAZY_BLOCK;
+        if (count > MERSENNE_TWISTER_SIZE)
+            count = MERSENNE_TWISTER_SIZE;
+        _CM(merssen_twister_twist_lazy)(state, count);
+    }
+
+    uint32_t y = state->MT[state->index++];
+    y ^= y >> 11;
+    y ^= y << 7  & 0x9d2c5680;
+    y ^= y << 15 & 0xefc60000;
+    y ^= y >> 18;
+    return y;
+}
+
+//count draws at once. The twist of all the words they need is done in one go and the tempering loop has no branch
+inline CUDA_DECL_HOST_AND_DEVICE void CUDA_SYM(merssen_twister_rand_many_lazy)(mersenne_twister_state* state, uint32_t* out, uint32_t count)
+{
+    while (count)
+    {
+        if (state->index == MERSENNE_TWISTER_SIZE)
+        {
+            state->index = 0;
+            state->twisted = 0;
+        }
+        uint32_t n = MERSENNE_TWISTER_SIZE - (uint32_t)state->index;
+        if (n > count)
+            n = count;
+        if (state->twisted < state->index + n)
+            _CM(merssen_twister_twist_lazy)(state, (uint32_t)state->index + n);
+
+        const uint32_t* mt = state->MT + state->index;
+        uint32_t i = 0;
+#if !defined(RANDOMHASH_CUDA)
+        i = merssen_twister_temper_SIMD(mt, out, n);
+#endif
+        for (; i < n; i++)
+        {
+            uint32_t y = mt[i];
+            y ^= y >> 11;
+            y ^= y << 7  & 0x9d2c5680;
+            y ^= y << 15 & 0xefc60000;
+            y ^= y >> 18;
+            out[i] = y;
+        }
+        state->index += n;
+        out += n;
+        count -= n;
+    }
+}
+
 #endif //#define RANDOM_HASH_mersenne_twister_H
\ No newline at end of file
@@ -92,7 +92,7 @@
 #endif
 
 
-#if !defined(RHMINER_NO_SSE4) || defined(RHMINER_COND_SSE4)
+#if !defined(RHMINER_NO_SSE4)
     #define RHMINER_ENABLE_SSE4
 #endif
 
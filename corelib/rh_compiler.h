@@ -28,6 +28,19 @@
 #define restrict __restrict__
 #endif
 
+// enable an instruction set on a single function, the rest of the binary keeps the base target
+#if defined(_MSC_VER)
+#define RH_TARGET_ISA(isa)
+#else
+#define RH_TARGET_ISA(isa) __attribute__((target(isa)))
+#endif
+
+// inline every call made by a function, so generic code called from a RH_TARGET_ISA function is compiled with that isa
+#if defined(_MSC_VER)
+#define RH_FLATTEN
+#else
+#define RH_FLATTEN __attribute__((flatten))
+#endif
 
 //----------------------------------------------------------------------------
 #include <exception>
@@ -32,6 +32,8 @@
 #include <sys/resource.h>
 #include <stdarg.h>
 #include <mm_malloc.h>
+#include <sys/mman.h>
+#include <sched.h>
 
 #if !defined(_WIN32_WINNT)
 #define OutputDebugStringA(...) 
@@ -439,6 +441,45 @@ void RH_SetThreadPriority(RH_ThreadPrio prio)
 #endif
 }
 
+std::vector<U32> RH_ParseCpuList(const string& list)
+{
+    std::vector<U32> cpus;
+    for (auto& range : GetTokens(list, ","))
+    {
+        U32 first = 0, last = 0;
+        int n = sscanf(range.c_str(), "%u-%u", &first, &last);
+        if (n < 1)
+            continue;
+        if (n == 1)
+            last = first;
+        for (U32 c = first; c <= last; c++)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+bool RH_SetThreadAffinity(const std::vector<U32>& cpus)
+{
+    if (cpus.empty())
+        return false;
+#if defined(_WIN32_WINNT)
+    DWORD_PTR mask = 0;
+    for (U32 c : cpus)
+        if (c < sizeof(DWORD_PTR) * 8)
+            mask |= (DWORD_PTR)1 << c;
+    return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (U32 c : cpus)
+        if (c < CPU_SETSIZE)
+            CPU_SET(c, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
 void SetThreadPriority_EXT(void* threadNativeHandle)
 {
 #if 0 && defined(__linux__)
@@ -521,6 +562,48 @@ U64 TimeGetMicroSec()
 }
 #endif
 
+#ifdef _WIN32_WINNT
+U64 TimeGetThreadCpuTime()
+{
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    return cycles;
+}
+
+bool RH_GetCpuEnergy(U64& microJoules)
+{
+    return false;
+}
+#else
+U64 TimeGetThreadCpuTime()
+{
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return (U64)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+//RAPL package domains, intel-rapl:0, intel-rapl:1, ... The sub domains are in intel-rapl:0:0 ...
+bool RH_GetCpuEnergy(U64& microJoules)
+{
+    microJoules = 0;
+    bool found = false;
+    for (U32 p = 0; p < 64; p++)
+    {
+        FILE* f = fopen(FormatString("/sys/class/powercap/intel-rapl:%u/energy_uj", p), "r");
+        if (!f)
+            break;
+        unsigned long long uj = 0;
+        if (fscanf(f, "%llu", &uj) == 1)
+        {
+            microJoules += uj;
+            found = true;
+        }
+        fclose(f);
+    }
+    return found;
+}
+#endif
+
 void GetSysTimeStr(char* buf, size_t buffSize)
 {
     bool addMili = false;
@@ -850,4 +933,99 @@ void RH_SysFree(void* ptr)
 #endif    
 }
 
+#ifndef _WIN32_WINNT
+static bool RH_IsTHPEnabled()
+{
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!f)
+        return false;
+    char line[128] = { 0 };
+    bool enabled = fgets(line, sizeof(line), f) && !strstr(line, "[never]");
+    fclose(f);
+    return enabled;
+}
+#endif
+
+void* RH_SysAllocLarge(size_t s, bool hugePages, bool lockPages, U32& outPages, bool& outLocked)
+{
+    outPages = RH_PAGES_NORMAL;
+    outLocked = false;
+#ifdef _WIN32_WINNT
+    //large pages need the 'Lock pages in memory' privilege, without it VirtualAlloc fails and normal pages are used
+    U8* ptr = 0;
+    size_t largePage = GetLargePageMinimum();
+    if (hugePages && largePage)
+    {
+        ptr = (U8*)VirtualAlloc(NULL, (s + largePage - 1) & ~(largePage - 1), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (ptr)
+            outPages = RH_PAGES_HUGE;
+    }
+    if (!ptr)
+    {
+        ptr = (U8*)VirtualAlloc(NULL, s, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!ptr)
+            return 0;
+        for (size_t i = 0; i < s; i += 4096)
+            ptr[i] = 0;
+        if (lockPages)
+            outLocked = VirtualLock(ptr, s) != 0;
+    }
+    else
+        outLocked = true;
+    return ptr;
+#else
+    //one page in front of the block keeps the size of the mapping
+    const size_t HeaderSize = 4096;
+    const size_t HugePageSize = 2 * 1024 * 1024;
+    size_t mapSize = (s + HeaderSize + 4095) & ~(size_t)4095;
+    U8* base = (U8*)MAP_FAILED;
+    if (hugePages)
+    {
+        mapSize = (mapSize + HugePageSize - 1) & ~(HugePageSize - 1);
+        base = (U8*)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (base != MAP_FAILED)
+            outPages = RH_PAGES_HUGE;
+    }
+
+    if (base == MAP_FAILED)
+    {
+        //the transparent huge pages only cover the 2 MB aligned parts of the mapping, so it is aligned on a huge page
+        size_t slack = hugePages ? HugePageSize : 0;
+        U8* raw = (U8*)mmap(NULL, mapSize + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            return 0;
+        base = raw;
+        if (hugePages)
+        {
+            base = (U8*)(((size_t)raw + HugePageSize - 1) & ~(HugePageSize - 1));
+            if (base != raw)
+                munmap(raw, base - raw);
+            if (raw + mapSize + slack != base + mapSize)
+                munmap(base + mapSize, (raw + mapSize + slack) - (base + mapSize));
+            if (madvise(base, mapSize, MADV_HUGEPAGE) == 0 && RH_IsTHPEnabled())
+                outPages = RH_PAGES_THP;
+        }
+
+        for (size_t i = 0; i < mapSize; i += 4096)
+            base[i] = 0;
+    }
+
+    if (lockPages)
+        outLocked = mlock(base, mapSize) == 0;
+
+    *(size_t*)base = mapSize;
+    return base + HeaderSize;
+#endif
+}
+
+void RH_SysFreeLarge(void* ptr)
+{
+#ifdef _WIN32_WINNT
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    U8* base = ((U8*)ptr) - 4096;
+    munmap(base, *(size_t*)base);
+#endif
+}
+
 
@@ -78,11 +78,15 @@ extern U64 AtomicGet(U64& x);
 enum RH_ThreadPrio {RH_ThreadPrio_Normal = 0, RH_ThreadPrio_Low, RH_ThreadPrio_High, RH_ThreadPrio_RT};
 extern void RH_SetThreadPriority(RH_ThreadPrio);
 extern void RH_SetThreadPriority_EXT(void* threadNativeHandle);
+extern std::vector<U32> RH_ParseCpuList(const string& list);    //sysfs cpu list format. Ex: "0-3,8,10-11"
+extern bool RH_SetThreadAffinity(const std::vector<U32>& cpus); //pin the calling thread on a set of logical processors
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Time
 extern U64 TimeGetMicroSec();
 inline U64 TimeGetMilliSec() { return TimeGetMicroSec()/1000; }
+extern U64 TimeGetThreadCpuTime();              //cpu time used by the calling thread, in a platform unit. Only good for comparisons
+extern bool RH_GetCpuEnergy(U64& microJoules);  //energy used by the cpu packages since boot. False when the counters are not available
 extern void GetSysTimeStr(char* buf, size_t buffSize); 
 extern void GetSysTimeStrF(char* buf, size_t buffSize, const char* frmt, bool addMillisec = false);
 
@@ -352,3 +356,11 @@ private:
 
 extern void* RH_SysAlloc(size_t s);
 extern void RH_SysFree(void* ptr);
+
+//Large, long lived blocks. Committed and touched at allocation so they never page fault later.
+//With hugePages, 2 MB pages are tried first, then transparent huge pages, then normal pages. outPages receives the kind obtained
+#define RH_PAGES_NORMAL     0
+#define RH_PAGES_THP        1
+#define RH_PAGES_HUGE       2
+extern void* RH_SysAllocLarge(size_t s, bool hugePages, bool lockPages, U32& outPages, bool& outLocked);
+extern void RH_SysFreeLarge(void* ptr);
@@ -168,6 +168,12 @@ void ClientManager::Initialize()
         }
     }
 
+    if (g_testKernels)
+        GlobalMiningPreset::I().DoKernelTest();
+
+    if (g_testLatency)
+        GlobalMiningPreset::I().DoLatencyTest();
+
     ActiveClients.client = std::shared_ptr<GenericMinerClient>(new GenericMinerClient());
     ActiveClients.client->SetStratumClient<StratumClient>(ActiveClients.stratum);
     ActiveClients.client->InitGpu<RandomHashCLMiner>();